@@ -28,6 +28,7 @@
 #include <ctype.h>
 #include <wctype.h>
 #include <unistd.h>
+#include <errno.h>
 
 #ifdef HAVE_CONFIG_H
 	#include "config.h"
@@ -50,6 +51,13 @@ extern GeanyData		*geany_data;
 /* GDB prompt */
 #define GDB_PROMPT "(gdb) \n"
 
+/* maximum number of pipelined commands written ahead of their results,
+so neither GDB nor we block on a full pipe */
+#define GDB_PIPELINE_WINDOW 16
+
+/* time to wait for a command result before giving up, in milliseconds */
+#define GDB_COMMAND_TIMEOUT 30000
+
 /* enumeration for GDB command execution status */
 typedef enum _result_class {
 	RC_DONE,
@@ -65,6 +73,52 @@ typedef struct _queue_item {
 	gboolean format_error_message;
 } queue_item;
 
+/* called once a command result is read, with a NULL record if the command
+timed out or was cancelled. the callback owns the record */
+typedef void (*command_callback)(struct gdb_mi_record *record, gpointer data);
+
+/* structure to keep a command waiting for its result */
+typedef struct _pending_command {
+	guint token;
+	command_callback callback;
+	gpointer data;
+	guint timeout_id;
+} pending_command;
+
+/* called once all commands of a batch got their results, with a record
+(or NULL) for each command. the callback owns the records array, to be
+freed with free_command_records() */
+typedef void (*batch_callback)(struct gdb_mi_record **records, guint count, gpointer data);
+
+/* called once an asynchronous update of autos, watches or files is done */
+typedef void (*update_callback)(gpointer data);
+
+/* structure to keep a batch of commands pipelined to GDB */
+typedef struct _command_batch command_batch;
+
+/* structure to keep a command of a batch, the data of its completion callback */
+typedef struct _batch_command {
+	command_batch *batch;
+	guint index;
+} batch_command;
+
+struct _command_batch {
+	GPtrArray *commands;
+	batch_command *slots;
+	struct gdb_mi_record **records;
+	guint written;
+	guint received;
+	gboolean writing;
+	batch_callback callback;
+	gpointer data;
+};
+
+/* structure to keep the results of commands executed synchronously */
+typedef struct _sync_result {
+	struct gdb_mi_record **records;
+	gboolean completed;
+} sync_result;
+
 /* enumeration for stop reason */
 enum sr {
 	SR_BREAKPOINT_HIT,
@@ -99,6 +153,12 @@ static GIOChannel *gdb_ch_out;
 /* GDB output event source id */
 static guint gdb_id_out;
 
+/* token for the next command */
+static guint gdb_token = 1;
+
+/* commands waiting for their results, by token */
+static GHashTable *pending_commands = NULL;
+
 /* buffer for the error message */
 char err_message[1000];
 
@@ -121,12 +181,22 @@ static gboolean file_refresh_needed = FALSE;
 /* current frame number */
 static int active_frame = 0;
 
+/* set while autos, watches and files are refreshed after the target
+stopped, the stop is only reported to the plugin once they are done */
+static gboolean stop_refresh_pending = FALSE;
+
+/* thread to report as stopped after the refresh */
+static int stopped_thread_id = 0;
+
 /* forward declarations */
 static void stop(void);
+static void cancel_all_commands(void);
 static variable* add_watch(gchar* expression);
 static void update_watches(void);
 static void update_autos(void);
-static void update_files(void);
+static void update_watches_async(update_callback callback, gpointer data);
+static void update_autos_async(update_callback callback, gpointer data);
+static void update_files_async(update_callback callback, gpointer data);
 
 /*
  * print message using color, based on message type
@@ -167,14 +237,13 @@ static void shutdown_channel(GIOChannel ** ch)
 }
 
 /*
- * called on GDB exit
+ * frees debug session data after GDB exit
  */
-static void on_gdb_exit(GPid pid, gint status, gpointer data)
+static gboolean on_gdb_exit_idle(gpointer data)
 {
-	gdb_pid = target_pid = 0;
-	g_spawn_close_pid(pid);
-	shutdown_channel(&gdb_ch_in);
-	shutdown_channel(&gdb_ch_out);
+	/* the lists may still be used by the refresh after a stop */
+	if (stop_refresh_pending)
+		return TRUE;
 
 	/* delete autos */
 	g_list_foreach(autos, (GFunc)g_free, NULL);
@@ -191,10 +260,39 @@ static void on_gdb_exit(GPid pid, gint status, gpointer data)
 	g_list_free(files);
 	files = NULL;
 
+	dbg_cbs->set_exited(0);
+
+	return FALSE;
+}
+
+/*
+ * called on GDB exit
+ */
+static void on_gdb_exit(GPid pid, gint status, gpointer data)
+{
+	gdb_pid = target_pid = 0;
+	g_spawn_close_pid(pid);
+
+	/* removing read callback */
+	if (gdb_id_out)
+	{
+		g_source_remove(gdb_id_out);
+		gdb_id_out = 0;
+	}
+
+	shutdown_channel(&gdb_ch_in);
+	shutdown_channel(&gdb_ch_out);
+
+	/* results won't come anymore */
+	cancel_all_commands();
+
 	g_source_remove(gdb_src_id);
 	gdb_src_id = 0;
 
-	dbg_cbs->set_exited(0);
+	if (stop_refresh_pending)
+		g_idle_add(on_gdb_exit_idle, NULL);
+	else
+		on_gdb_exit_idle(NULL);
 }
 
 /*
@@ -228,6 +326,11 @@ static void gdb_input_write_line(const gchar *line)
 	gsize count;
 	const char *p;
 	char command[1000];
+
+	/* GDB has exited */
+	if (!gdb_ch_in)
+		return;
+
 	g_snprintf(command, sizeof command, "%s\n", line);
 
 	for (p = command; *p; p += count)
@@ -299,109 +402,218 @@ static GList* add_to_queue(GList* queue, const gchar *message, const gchar *comm
 }
 
 /*
- * asynchronous output reader
- * reads from startup async commands.
- * looks for a command completion (normal or abnormal), if normal - executes next command
+ * hands the result of a pending command to its callback
  */
-static void exec_async_command(const gchar* command);
-static gboolean on_read_async_output(GIOChannel * src, GIOCondition cond, gpointer data)
+static void complete_command(guint token, struct gdb_mi_record *record)
 {
-	gchar *line;
-	gsize length;
-	struct gdb_mi_record *record;
+	pending_command *cmd = NULL;
 
-	if (G_IO_STATUS_NORMAL != g_io_channel_read_line(src, &line, NULL, &length, NULL))
-		return TRUE;
+	if (pending_commands)
+		cmd = g_hash_table_lookup(pending_commands, GUINT_TO_POINTER(token));
+	if (!cmd)
+	{
+		/* result of a command that timed out or was cancelled */
+		gdb_mi_record_free(record);
+		return;
+	}
 
-	record = gdb_mi_record_parse(line);
+	g_hash_table_remove(pending_commands, GUINT_TO_POINTER(token));
+	if (cmd->timeout_id)
+		g_source_remove(cmd->timeout_id);
 
-	if (record && record->type == '^')
-	{
-		/* got some result */
+	cmd->callback(record, cmd->data);
+	g_free(cmd);
+}
 
-		GList *lines;
-		GList *commands = (GList*)data;
+/*
+ * cancels a pending command, its result will be ignored
+ */
+static void cancel_command(guint token)
+{
+	complete_command(token, NULL);
+}
 
-		if (gdb_id_out)
-		{
-			g_source_remove(gdb_id_out);
-			gdb_id_out = 0;
-		}
+/*
+ * cancels all pending commands
+ */
+static void cancel_all_commands(void)
+{
+	GList *tokens, *iter;
 
-		lines = read_until_prompt();
-		g_list_foreach(lines, (GFunc)g_free, NULL);
-		g_list_free (lines);
+	if (!pending_commands)
+		return;
 
-		if (!strcmp(record->klass, "done"))
-		{
-			/* command completed successfully - run next command if exists */
-			if (commands->next)
-			{
-				/* if there are commands left */
-				queue_item *item;
+	tokens = g_hash_table_get_keys(pending_commands);
+	for (iter = tokens; iter; iter = iter->next)
+		cancel_command(GPOINTER_TO_UINT(iter->data));
+	g_list_free(tokens);
+}
 
-				commands = commands->next;
-				item = (queue_item*)commands->data;
+/*
+ * called when a command didn't get its result in time
+ */
+static gboolean on_command_timeout(gpointer data)
+{
+	pending_command *cmd = (pending_command*)data;
 
-				/* send message to debugger messages window */
-				if (item->message)
-				{
-					dbg_cbs->send_message(item->message, "grey");
-				}
+	cmd->timeout_id = 0;
+	cancel_command(cmd->token);
 
-				gdb_input_write_line(item->command);
+	return FALSE;
+}
 
-				gdb_id_out = g_io_add_watch(gdb_ch_out, G_IO_IN, on_read_async_output, commands);
-			}
-			else
-			{
-				/* all commands completed */
-				free_commands_queue(commands);
+/*
+ * execute "command" asynchronously, calling "callback" when its
+ * result is read from the output channel or after "timeout"
+ * milliseconds (0 to wait forever). returns the command token
+ */
+static guint exec_command(const gchar *command, command_callback callback, gpointer data, guint timeout)
+{
+	pending_command *cmd;
+	gchar *line;
 
-				/* removing read callback */
-				if (gdb_id_out)
-				{
-					g_source_remove(gdb_id_out);
-					gdb_id_out = 0;
-				}
+	/* GDB has exited */
+	if (!gdb_ch_in)
+	{
+		callback(NULL, data);
+		return 0;
+	}
 
-				/* update source files list */
-				update_files();
+	if (!pending_commands)
+		pending_commands = g_hash_table_new(g_direct_hash, g_direct_equal);
 
-				/* -exec-run */
-				exec_async_command("-exec-run");
-			}
+	cmd = g_new0(pending_command, 1);
+	cmd->token = gdb_token++;
+	cmd->callback = callback;
+	cmd->data = data;
+	if (timeout)
+		cmd->timeout_id = g_timeout_add(timeout, on_command_timeout, cmd);
+	g_hash_table_insert(pending_commands, GUINT_TO_POINTER(cmd->token), cmd);
+
+	line = g_strdup_printf("%u%s", cmd->token, command);
+#ifdef DEBUG_OUTPUT
+	dbg_cbs->send_message(line, "red");
+#endif
+	gdb_input_write_line(line);
+	g_free(line);
+
+	return cmd->token;
+}
+
+/*
+ * sends the first command of startup commands queue
+ */
+static void exec_async_command(const gchar* command);
+static void on_startup_command_done(struct gdb_mi_record *record, gpointer data);
+static void exec_startup_command(GList *commands)
+{
+	queue_item *item = (queue_item*)commands->data;
+
+	/* send message to debugger messages window */
+	if (item->message)
+	{
+		dbg_cbs->send_message(item->message, "grey");
+	}
+
+	/* loading symbols can take any time, so no timeout here */
+	exec_command(item->command, on_startup_command_done, commands, 0);
+}
+
+/*
+ * runs the target once the source files are known
+ */
+static void on_startup_files_updated(gpointer data)
+{
+	/* -exec-run */
+	exec_async_command("-exec-run");
+}
+
+/*
+ * startup command completion callback.
+ * if command completed normally - executes next command
+ */
+static void on_startup_command_done(struct gdb_mi_record *record, gpointer data)
+{
+	GList *commands = (GList*)data;
+
+	if (record && gdb_mi_record_matches(record, '^', "done", NULL))
+	{
+		/* command completed successfully - run next command if exists */
+		if (commands->next)
+		{
+			exec_startup_command(commands->next);
 		}
 		else
 		{
-			queue_item *item = (queue_item*)commands->data;
-			if(item->error_message)
-			{
-				if (item->format_error_message)
-				{
-					const gchar* gdb_msg = gdb_mi_result_var(record->first, "msg", GDB_MI_VAL_STRING);
-					gchar *msg = g_strdup_printf(item->error_message, gdb_msg);
+			/* all commands completed */
+			free_commands_queue(commands);
 
-					dbg_cbs->report_error(msg);
-					g_free(msg);
-				}
-				else
-				{
-					dbg_cbs->report_error(item->error_message);
-				}
-			}
+			/* update source files list, then run */
+			update_files_async(on_startup_files_updated, NULL);
+		}
+	}
+	else
+	{
+		queue_item *item = (queue_item*)commands->data;
 
-			/* free commands queue */
+		/* no record means the startup was cancelled by stopping */
+		if (!record)
+		{
 			free_commands_queue(commands);
+			return;
+		}
 
-			stop();
+		if (item->error_message)
+		{
+			if (item->format_error_message)
+			{
+				const gchar* gdb_msg = gdb_mi_result_var(record->first, "msg", GDB_MI_VAL_STRING);
+				gchar *msg = g_strdup_printf(item->error_message, gdb_msg);
+
+				dbg_cbs->report_error(msg);
+				g_free(msg);
+			}
+			else
+			{
+				dbg_cbs->report_error(item->error_message);
+			}
 		}
+
+		/* free commands queue */
+		free_commands_queue(commands);
+
+		stop();
 	}
 
 	gdb_mi_record_free(record);
-	g_free(line);
+}
 
-	return TRUE;
+/*
+ * the refresh after a stop is done, report the stop
+ */
+static void on_stop_refresh_done(gpointer data)
+{
+	stop_refresh_pending = FALSE;
+
+	/* GDB may have exited meanwhile */
+	if (gdb_pid)
+		dbg_cbs->set_stopped(stopped_thread_id);
+}
+
+static void on_stop_watches_updated(gpointer data)
+{
+	if (file_refresh_needed)
+	{
+		file_refresh_needed = FALSE;
+		update_files_async(on_stop_refresh_done, NULL);
+	}
+	else
+		on_stop_refresh_done(NULL);
+}
+
+static void on_stop_autos_updated(gpointer data)
+{
+	update_watches_async(on_stop_watches_updated, NULL);
 }
 
 /*
@@ -419,7 +631,15 @@ static gboolean on_read_from_gdb(GIOChannel * src, GIOCondition cond, gpointer d
 	if (G_IO_STATUS_NORMAL != g_io_channel_read_line(src, &line, NULL, &length, NULL))
 		return TRUE;
 
-	record = gdb_mi_record_parse(line);
+	record = gdb_mi_record_parse_full(line, GDB_MI_PARSE_ARENA | GDB_MI_PARSE_INDEX);
+
+	/* result of a command waiting for it */
+	if (record && '^' == record->type && record->token)
+	{
+		complete_command((guint)strtoul(record->token, NULL, 10), record);
+		g_free(line);
+		return TRUE;
+	}
 
 	if (! record || record->type != GDB_MI_TYPE_PROMPT)
 	{
@@ -468,13 +688,6 @@ static gboolean on_read_from_gdb(GIOChannel * src, GIOCondition cond, gpointer d
 	{
 		const gchar *reason;
 
-		/* removing read callback (will be pulling all output left manually) */
-		if (gdb_id_out)
-		{
-			g_source_remove(gdb_id_out);
-			gdb_id_out = 0;
-		}
-
 		/* looking for a reason to stop */
 		if ((reason = gdb_mi_result_var(record->first, "reason", GDB_MI_VAL_STRING)) != NULL)
 		{
@@ -506,18 +719,10 @@ static gboolean on_read_from_gdb(GIOChannel * src, GIOCondition cond, gpointer d
 
 			if (SR_BREAKPOINT_HIT == stop_reason || SR_END_STEPPING_RANGE == stop_reason)
 			{
-				/* update autos */
-				update_autos();
-
-				/* update watches */
-				update_watches();
-
-				/* update files */
-				if (file_refresh_needed)
-				{
-					update_files();
-					file_refresh_needed = FALSE;
-				}
+				/* update autos, watches and files, the stop is reported when done */
+				stopped_thread_id = thread_id ? atoi(thread_id) : 0;
+				stop_refresh_pending = TRUE;
+				update_autos_async(on_stop_autos_updated, NULL);
 			}
 			else
 			{
@@ -532,9 +737,9 @@ static gboolean on_read_from_gdb(GIOChannel * src, GIOCondition cond, gpointer d
 				}
 				else
 					requested_interrupt = FALSE;
-			}
 
-			dbg_cbs->set_stopped(thread_id ? atoi(thread_id) : 0);
+				dbg_cbs->set_stopped(thread_id ? atoi(thread_id) : 0);
+			}
 		}
 		else if (stop_reason == SR_EXITED_NORMALLY || stop_reason == SR_EXITED_SIGNALLED || stop_reason == SR_EXITED_WITH_CODE)
 		{
@@ -555,16 +760,8 @@ static gboolean on_read_from_gdb(GIOChannel * src, GIOCondition cond, gpointer d
 	}
 	else if (gdb_mi_record_matches(record, '^', "error", NULL))
 	{
-		GList *lines, *iter;
 		const gchar *msg = gdb_mi_result_var(record->first, "msg", GDB_MI_VAL_STRING);
 
-		/* removing read callback (will pulling all output left manually) */
-		if (gdb_id_out)
-		{
-			g_source_remove(gdb_id_out);
-			gdb_id_out = 0;
-		}
-
 		/* set debugger stopped if is running */
 		if (DBS_STOPPED != debug_get_state())
 		{
@@ -574,17 +771,6 @@ static gboolean on_read_from_gdb(GIOChannel * src, GIOCondition cond, gpointer d
 			dbg_cbs->set_stopped(thread_id ? atoi(thread_id) : 0);
 		}
 
-		/* reading until prompt */
-		lines = read_until_prompt();
-		for (iter = lines; iter; iter = iter->next)
-		{
-			gchar *l = (gchar*)iter->data;
-			if (strcmp(l, GDB_PROMPT))
-				colorize_message(l);
-			g_free(l);
-		}
-		g_list_free (lines);
-
 		/* send error message */
 		dbg_cbs->report_error(msg);
 	}
@@ -597,9 +783,8 @@ static gboolean on_read_from_gdb(GIOChannel * src, GIOCondition cond, gpointer d
 
 /*
  * execute "command" asynchronously
- * after writing command to an input channel
- * connects reader to output channel and exits
- * after execution
+ * after writing command to an input channel,
+ * its output is handled by the output channel reader
  */
 static void exec_async_command(const gchar* command)
 {
@@ -608,80 +793,228 @@ static void exec_async_command(const gchar* command)
 #endif
 
 	gdb_input_write_line(command);
+}
 
-	/* connect read callback to the output channel */
-	gdb_id_out = g_io_add_watch(gdb_ch_out, G_IO_IN, on_read_from_gdb, NULL);
+/*
+ * batch command completion callback
+ */
+static void batch_continue(command_batch *batch);
+static void on_batch_command_done(struct gdb_mi_record *record, gpointer data)
+{
+	batch_command *slot = (batch_command*)data;
+	command_batch *batch = slot->batch;
+
+	batch->records[slot->index] = record;
+	batch->received++;
+
+	/* results of commands written right now are handled by the writer */
+	if (!batch->writing)
+		batch_continue(batch);
 }
 
 /*
- * execute "command" synchronously
- * i.e. reading output right
- * after execution
+ * writes the commands of a batch while there is room in the pipeline,
+ * calls the batch callback once all results are there
  */
-static result_class exec_sync_command(const gchar* command, gboolean wait4prompt, struct gdb_mi_record ** command_record)
+static void batch_continue(command_batch *batch)
 {
-	GList *lines, *iter;
-	result_class rc;
+	batch->writing = TRUE;
+	while (batch->written < batch->commands->len &&
+		batch->written - batch->received < GDB_PIPELINE_WINDOW)
+	{
+		batch_command *slot = &batch->slots[batch->written++];
 
-#ifdef DEBUG_OUTPUT
-	dbg_cbs->send_message(command, "red");
-#endif
+		exec_command((gchar*)batch->commands->pdata[slot->index], on_batch_command_done, slot, GDB_COMMAND_TIMEOUT);
+	}
+	batch->writing = FALSE;
 
-	/* write command to gdb input channel */
-	gdb_input_write_line(command);
+	if (batch->received == batch->commands->len)
+	{
+		batch_callback callback = batch->callback;
+		struct gdb_mi_record **records = batch->records;
+		guint count = batch->commands->len;
+		gpointer data = batch->data;
 
-	if (!wait4prompt)
-		return RC_DONE;
+		g_ptr_array_unref(batch->commands);
+		g_free(batch->slots);
+		g_free(batch);
 
-	if (command_record)
-		*command_record = NULL;
+		callback(records, count, data);
+	}
+}
 
-	lines = read_until_prompt();
+/*
+ * execute "commands" asynchronously, writing them ahead of reading
+ * their results, which are matched back by token. "callback" is called
+ * once all of them are done. takes ownership of "commands"
+ */
+static void exec_command_batch(GPtrArray *commands, batch_callback callback, gpointer data)
+{
+	command_batch *batch = g_new0(command_batch, 1);
+	guint i;
 
-#ifdef DEBUG_OUTPUT
-	for (iter = lines; iter; iter = iter->next)
+	batch->commands = commands;
+	batch->slots = g_new0(batch_command, commands->len);
+	batch->records = g_new0(struct gdb_mi_record*, commands->len);
+	batch->callback = callback;
+	batch->data = data;
+
+	for (i = 0; i < commands->len; i++)
 	{
-		dbg_cbs->send_message((gchar*)iter->data, "red");
+		batch->slots[i].batch = batch;
+		batch->slots[i].index = i;
 	}
-#endif
 
-	rc = RC_ERROR;
+	batch_continue(batch);
+}
 
-	for (iter = lines; iter; iter = iter->next)
+/*
+ * reads and handles one line of GDB output right away, waiting
+ * for it GDB_COMMAND_TIMEOUT milliseconds at most.
+ * returns FALSE if GDB has exited or didn't answer in time
+ */
+static gboolean read_from_gdb_sync(void)
+{
+	GPollFD fd;
+	gint ready;
+
+	/* GDB has exited */
+	if (!gdb_ch_out)
+		return FALSE;
+
+	/* lines already buffered by the channel don't show up on the pipe */
+	if (!(g_io_channel_get_buffer_condition(gdb_ch_out) & G_IO_IN))
 	{
-		gchar *line = (gchar*)iter->data;
-		struct gdb_mi_record *record = gdb_mi_record_parse(line);
+		fd.fd = g_io_channel_unix_get_fd(gdb_ch_out);
+		fd.events = G_IO_IN | G_IO_HUP | G_IO_ERR;
+		fd.revents = 0;
 
-		if (record && '^' == record->type)
-		{
-			if (gdb_mi_record_matches(record, '^', "done", NULL))
-				rc = RC_DONE;
-			else if (gdb_mi_record_matches(record, '^', "error", NULL))
-			{
-				/* save error message */
-				const gchar *msg = gdb_mi_result_var(record->first, "msg", GDB_MI_VAL_STRING);
-				strncpy(err_message, msg ? msg : "", G_N_ELEMENTS(err_message) - 1);
+		do
+			ready = g_poll(&fd, 1, GDB_COMMAND_TIMEOUT);
+		while (ready < 0 && EINTR == errno);
 
-				rc = RC_ERROR;
-			}
-			else if (gdb_mi_record_matches(record, '^', "exit", NULL))
-				rc = RC_EXIT;
+		if (ready <= 0)
+			return FALSE;
 
-			if (command_record)
-			{
-				*command_record = record;
-				record = NULL;
-			}
-		}
-		else if (! record || '&' != record->type)
+		if (!(fd.revents & G_IO_IN))
 		{
-			colorize_message (line);
+			/* GDB has exited, the commands sent from now on fail right away */
+			shutdown_channel(&gdb_ch_in);
+			return FALSE;
 		}
-		gdb_mi_record_free(record);
 	}
 
-	g_list_foreach(lines, (GFunc)g_free, NULL);
-	g_list_free(lines);
+	on_read_from_gdb(gdb_ch_out, G_IO_IN, NULL);
+
+	return TRUE;
+}
+
+/*
+ * waits until a command callback sets "done".
+ * GDB output is read here instead of running the main loop, so that no UI
+ * action can call into the module while one of its functions waits for a
+ * result. if GDB exits or stops answering, all pending commands are cancelled
+ */
+static void wait_for_gdb(gboolean *done)
+{
+	while (!*done)
+	{
+		if (!read_from_gdb_sync())
+			cancel_all_commands();
+	}
+}
+
+/*
+ * synchronous commands completion callback
+ */
+static void on_sync_commands_done(struct gdb_mi_record **records, guint count, gpointer data)
+{
+	sync_result *result = (sync_result*)data;
+
+	result->records = records;
+	result->completed = TRUE;
+}
+
+/*
+ * execute "commands" synchronously, for the debug module functions that
+ * have to return a result. returns an array with a result record (or NULL) for each command,
+ * to be freed with free_command_records()
+ */
+static struct gdb_mi_record** exec_sync_commands(GPtrArray *commands)
+{
+	sync_result result = { NULL, FALSE };
+
+	exec_command_batch(g_ptr_array_ref(commands), on_sync_commands_done, &result);
+	wait_for_gdb(&result.completed);
+
+	return result.records;
+}
+
+/*
+ * free the records array returned by exec_sync_commands()
+ */
+static void free_command_records(struct gdb_mi_record **records, guint count)
+{
+	guint i;
+
+	for (i = 0; i < count; i++)
+		gdb_mi_record_free(records[i]);
+	g_free(records);
+}
+
+/*
+ * execute "command" synchronously
+ * i.e. waiting for its result right
+ * after execution
+ */
+static result_class exec_sync_command(const gchar* command, gboolean wait4prompt, struct gdb_mi_record ** command_record)
+{
+	GPtrArray *commands;
+	struct gdb_mi_record **records;
+	struct gdb_mi_record *record;
+	result_class rc;
+
+	if (!wait4prompt)
+	{
+		exec_async_command(command);
+		return RC_DONE;
+	}
+
+	if (command_record)
+		*command_record = NULL;
+
+	commands = g_ptr_array_new();
+	g_ptr_array_add(commands, (gpointer)command);
+	records = exec_sync_commands(commands);
+	record = records[0];
+	g_free(records);
+	g_ptr_array_free(commands, TRUE);
+
+	rc = RC_ERROR;
+
+	if (!record)
+	{
+		strncpy(err_message, _("GDB didn't answer in time"), G_N_ELEMENTS(err_message) - 1);
+		return rc;
+	}
+
+	if (gdb_mi_record_matches(record, '^', "done", NULL))
+		rc = RC_DONE;
+	else if (gdb_mi_record_matches(record, '^', "error", NULL))
+	{
+		/* save error message */
+		const gchar *msg = gdb_mi_result_var(record->first, "msg", GDB_MI_VAL_STRING);
+		strncpy(err_message, msg ? msg : "", G_N_ELEMENTS(err_message) - 1);
+
+		rc = RC_ERROR;
+	}
+	else if (gdb_mi_record_matches(record, '^', "exit", NULL))
+		rc = RC_EXIT;
+
+	if (command_record)
+		*command_record = record;
+	else
+		gdb_mi_record_free(record);
 
 	return rc;
 }
@@ -725,7 +1058,6 @@ static gboolean run(const gchar* file, const gchar* commandline, GList* env, GLi
 	gchar *command;
 	gchar *escaped;
 	int bp_index;
-	queue_item *item;
 
 	dbg_cbs = callbacks;
 
@@ -870,18 +1202,10 @@ static gboolean run(const gchar* file, const gchar* commandline, GList* env, GLi
 	g_free(command);
 
 	/* connect read callback to the output channel */
-	gdb_id_out = g_io_add_watch(gdb_ch_out, G_IO_IN, on_read_async_output, commands);
-
-	item = (queue_item*)commands->data;
-
-	/* send message to debugger messages window */
-	if (item->message)
-	{
-		dbg_cbs->send_message(item->message, "grey");
-	}
+	gdb_id_out = g_io_add_watch(gdb_ch_out, G_IO_IN, on_read_from_gdb, NULL);
 
 	/* send first command */
-	gdb_input_write_line(item->command);
+	exec_startup_command(commands);
 
 	return TRUE;
 }
@@ -900,6 +1224,9 @@ static void restart(void)
  */
 static void stop(void)
 {
+	/* don't wait for results anymore */
+	cancel_all_commands();
+
 	exec_sync_command("-gdb-exit", FALSE, NULL);
 }
 
@@ -1197,202 +1524,383 @@ static GList* get_stack(void)
 }
 
 /*
- * updates variables from vars list
+ * fills variable type, children flag and value from a variable object
+ * description as returned by -var-create or -var-list-children --all-values
  */
-static void get_variables (GList *vars)
+static void set_variable_info(variable *var, const struct gdb_mi_result *info)
 {
-	while (vars)
-	{
-		gchar command[1000];
+	const gchar *numchild = gdb_mi_result_var(info, "numchild", GDB_MI_VAL_STRING);
+	const gchar *value = gdb_mi_result_var(info, "value", GDB_MI_VAL_STRING);
+	const gchar *type = gdb_mi_result_var(info, "type", GDB_MI_VAL_STRING);
 
-		variable *var = (variable*)vars->data;
+	var->has_children = numchild && atoi(numchild) > 0;
+	g_string_assign(var->value, value ? value : "");
+	g_string_assign(var->type, type ? type : "");
+}
 
-		gchar *varname = var->internal->str;
-		struct gdb_mi_record *record = NULL;
-		const gchar *expression = NULL;
-		const gchar *numchild = NULL;
-		const gchar *value = NULL;
-		const gchar *type = NULL;
+/*
+ * structure to keep the state of an asynchronous variables update
+ */
+typedef struct _variables_update {
+	GList *vars;
+	GList *unevaluated;
+	update_callback callback;
+	gpointer data;
+} variables_update;
+
+static variables_update* variables_update_new(update_callback callback, gpointer data)
+{
+	variables_update *update = g_new0(variables_update, 1);
 
-		/* path expression */
-		g_snprintf(command, sizeof command, "-var-info-path-expression \"%s\"", varname);
-		exec_sync_command(command, TRUE, &record);
-		if (record)
-			expression = gdb_mi_result_var(record->first, "path_expr", GDB_MI_VAL_STRING);
-		g_string_assign(var->expression, expression ? expression : "");
-		gdb_mi_record_free(record);
+	update->callback = callback;
+	update->data = data;
 
-		/* children number */
-		g_snprintf(command, sizeof command, "-var-info-num-children \"%s\"", varname);
-		exec_sync_command(command, TRUE, &record);
-		if (record)
-			numchild = gdb_mi_result_var(record->first, "numchild", GDB_MI_VAL_STRING);
-		var->has_children = numchild && atoi(numchild) > 0;
-		gdb_mi_record_free(record);
+	return update;
+}
 
-		/* value */
-		g_snprintf(command, sizeof command, "-data-evaluate-expression \"%s\"", var->expression->str);
-		exec_sync_command(command, TRUE, &record);
-		if (record)
-			value = gdb_mi_result_var(record->first, "value", GDB_MI_VAL_STRING);
-		if (!value)
-		{
-			gdb_mi_record_free(record);
-			g_snprintf(command, sizeof command, "-var-evaluate-expression \"%s\"", varname);
-			exec_sync_command(command, TRUE, &record);
-			if (record)
-				value = gdb_mi_result_var(record->first, "value", GDB_MI_VAL_STRING);
-		}
-		g_string_assign(var->value, value ? value : "");
-		gdb_mi_record_free(record);
+/*
+ * calls the update callback and frees the update
+ */
+static void variables_update_done(variables_update *update)
+{
+	update_callback callback = update->callback;
+	gpointer data = update->data;
 
-		/* type */
-		g_snprintf(command, sizeof command, "-var-info-type \"%s\"", varname);
-		exec_sync_command(command, TRUE, &record);
-		if (record)
-			type = gdb_mi_result_var(record->first, "type", GDB_MI_VAL_STRING);
-		g_string_assign(var->type, type ? type : "");
-		gdb_mi_record_free(record);
+	g_list_free(update->vars);
+	g_list_free(update->unevaluated);
+	g_free(update);
 
-		vars = vars->next;
-	}
+	callback(data);
 }
 
 /*
- * updates files list
+ * synchronous update completion callback
  */
-static void update_files(void)
+static void on_sync_update_done(gpointer data)
 {
-	GHashTable *ht;
-	struct gdb_mi_record *record = NULL;
-	const struct gdb_mi_result *files_node;
+	*(gboolean*)data = TRUE;
+}
 
-	if (files)
+/*
+ * waits for an update started with on_sync_update_done() as callback
+ */
+static void wait_for_update(gboolean *done)
+{
+	wait_for_gdb(done);
+}
+
+static void on_variables_fallback_values(struct gdb_mi_record **records, guint count, gpointer data)
+{
+	variables_update *update = (variables_update*)data;
+	GList *iter;
+	guint i;
+
+	for (iter = update->unevaluated, i = 0; iter; iter = iter->next, i++)
 	{
-		/* free previous list */
-		g_list_foreach(files, (GFunc)g_free, NULL);
-		g_list_free(files);
-		files = NULL;
+		variable *var = (variable*)iter->data;
+		const gchar *value = NULL;
+
+		if (records[i])
+			value = gdb_mi_result_var(records[i]->first, "value", GDB_MI_VAL_STRING);
+		g_string_assign(var->value, value ? value : "");
 	}
+	free_command_records(records, count);
 
-	exec_sync_command("-file-list-exec-source-files", TRUE, &record);
-	if (! record)
-		return;
+	variables_update_done(update);
+}
+
+static void on_variables_values(struct gdb_mi_record **records, guint count, gpointer data)
+{
+	variables_update *update = (variables_update*)data;
+	GPtrArray *commands = g_ptr_array_new_with_free_func(g_free);
+	GList *iter;
+	guint i;
+
+	for (iter = update->vars, i = 0; iter; iter = iter->next, i++)
+	{
+		variable *var = (variable*)iter->data;
+		const gchar *value = NULL;
 
-	ht = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, NULL);
+		if (records[i])
+			value = gdb_mi_result_var(records[i]->first, "value", GDB_MI_VAL_STRING);
+		if (value)
+			g_string_assign(var->value, value);
+		else if (! var->value->len)
+			update->unevaluated = g_list_prepend(update->unevaluated, var);
+	}
+	free_command_records(records, count);
 
-	files_node = gdb_mi_result_var(record->first, "files", GDB_MI_VAL_LIST);
-	gdb_mi_result_foreach_matched (files_node, files_node, NULL, GDB_MI_VAL_LIST)
+	/* fall back to the variable object value if the expression
+	can't be evaluated and the value isn't known yet */
+	update->unevaluated = g_list_reverse(update->unevaluated);
+	for (iter = update->unevaluated; iter; iter = iter->next)
 	{
-		const gchar *fullname = gdb_mi_result_var(files_node->val->v.list, "fullname", GDB_MI_VAL_STRING);
+		variable *var = (variable*)iter->data;
+		g_ptr_array_add(commands, g_strdup_printf("-var-evaluate-expression \"%s\"", var->internal->str));
+	}
+	exec_command_batch(commands, on_variables_fallback_values, update);
+}
 
-		if (fullname && !g_hash_table_lookup(ht, fullname))
-		{
-			g_hash_table_insert(ht, (gpointer)fullname, (gpointer)1);
-			files = g_list_append(files, g_strdup(fullname));
-		}
+static void on_variables_paths(struct gdb_mi_record **records, guint count, gpointer data)
+{
+	variables_update *update = (variables_update*)data;
+	GPtrArray *commands = g_ptr_array_new_with_free_func(g_free);
+	GList *iter;
+	guint i;
+
+	for (iter = update->vars, i = 0; iter; iter = iter->next, i++)
+	{
+		variable *var = (variable*)iter->data;
+		const gchar *expression = NULL;
+
+		if (records[i])
+			expression = gdb_mi_result_var(records[i]->first, "path_expr", GDB_MI_VAL_STRING);
+		g_string_assign(var->expression, expression ? expression : "");
 	}
+	free_command_records(records, count);
 
-	g_hash_table_destroy(ht);
-	gdb_mi_record_free(record);
+	/* values */
+	for (iter = update->vars; iter; iter = iter->next)
+	{
+		variable *var = (variable*)iter->data;
+		g_ptr_array_add(commands, g_strdup_printf("-data-evaluate-expression \"%s\"", var->expression->str));
+	}
+	exec_command_batch(commands, on_variables_values, update);
 }
 
 /*
- * updates watches list
+ * updates expressions and values of variables from vars list,
+ * their type and children flag are expected to be set already.
+ * calls "callback" when done
  */
-static void update_watches(void)
+static void get_variables_async(GList *vars, update_callback callback, gpointer data)
 {
-	gchar command[1000];
-	GList *updating = NULL;
+	variables_update *update = variables_update_new(callback, data);
+	GPtrArray *commands = g_ptr_array_new_with_free_func(g_free);
 	GList *iter;
 
-	/* delete all GDB variables */
-	for (iter = watches; iter; iter = iter->next)
+	update->vars = g_list_copy(vars);
+
+	/* path expressions */
+	for (iter = vars; iter; iter = iter->next)
 	{
 		variable *var = (variable*)iter->data;
+		g_ptr_array_add(commands, g_strdup_printf("-var-info-path-expression \"%s\"", var->internal->str));
+	}
+	exec_command_batch(commands, on_variables_paths, update);
+}
 
-		if (var->internal->len)
+/*
+ * updates expressions and values of variables from vars list, waiting for the results
+ */
+static void get_variables (GList *vars)
+{
+	gboolean done = FALSE;
+
+	get_variables_async(vars, on_sync_update_done, &done);
+	wait_for_update(&done);
+}
+
+static void on_files_listed(struct gdb_mi_record **records, guint count, gpointer data)
+{
+	variables_update *update = (variables_update*)data;
+	struct gdb_mi_record *record = records[0];
+	GHashTable *ht;
+	const struct gdb_mi_result *files_node;
+
+	if (record)
+	{
+		ht = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, NULL);
+
+		files_node = gdb_mi_result_var(record->first, "files", GDB_MI_VAL_LIST);
+		gdb_mi_result_foreach_matched (files_node, files_node, NULL, GDB_MI_VAL_LIST)
 		{
-			g_snprintf(command, sizeof command, "-var-delete %s", var->internal->str);
-			exec_sync_command(command, TRUE, NULL);
+			const gchar *fullname = gdb_mi_result_var(files_node->val->v.list, "fullname", GDB_MI_VAL_STRING);
+
+			if (fullname && !g_hash_table_lookup(ht, fullname))
+			{
+				g_hash_table_insert(ht, (gpointer)fullname, (gpointer)1);
+				files = g_list_append(files, g_strdup(fullname));
+			}
 		}
 
-		/* reset all variables fields */
-		variable_reset(var);
+		g_hash_table_destroy(ht);
 	}
+	free_command_records(records, count);
 
-	/* create GDB variables, adding successfully created
-	variables to the list then passed for updating */
-	for (iter = watches; iter; iter = iter->next)
+	variables_update_done(update);
+}
+
+/*
+ * updates files list, calls "callback" when done
+ */
+static void update_files_async(update_callback callback, gpointer data)
+{
+	GPtrArray *commands = g_ptr_array_new_with_free_func(g_free);
+
+	if (files)
+	{
+		/* free previous list */
+		g_list_foreach(files, (GFunc)g_free, NULL);
+		g_list_free(files);
+		files = NULL;
+	}
+
+	g_ptr_array_add(commands, g_strdup("-file-list-exec-source-files"));
+	exec_command_batch(commands, on_files_listed, variables_update_new(callback, data));
+}
+
+static void on_watches_evaluated(gpointer data)
+{
+	variables_update_done((variables_update*)data);
+}
+
+static void on_watches_created(struct gdb_mi_record **records, guint count, gpointer data)
+{
+	variables_update *update = (variables_update*)data;
+	GList *iter;
+	guint i;
+
+	/* add successfully created variables to the list then passed for updating */
+	for (iter = watches, i = 0; iter; iter = iter->next, i++)
 	{
 		variable *var = (variable*)iter->data;
-		struct gdb_mi_record *record = NULL;
 		const gchar *name;
-		gchar *escaped;
-
-		/* try to create variable */
-		escaped = escape_string(var->name->str);
-		g_snprintf(command, sizeof command, "-var-create - * \"%s\"", escaped);
-		g_free(escaped);
 
-		if (RC_DONE != exec_sync_command(command, TRUE, &record) || !record)
+		if (! records[i] || ! gdb_mi_record_matches(records[i], '^', "done", NULL))
 		{
 			/* do not include to updating list, move to next watch */
 			var->evaluated = FALSE;
 			g_string_assign(var->internal, "");
-			gdb_mi_record_free(record);
 
 			continue;
 		}
 
 		/* find and assign internal name */
-		name = gdb_mi_result_var(record->first, "name", GDB_MI_VAL_STRING);
+		name = gdb_mi_result_var(records[i]->first, "name", GDB_MI_VAL_STRING);
 		g_string_assign(var->internal, name ? name : "");
-		gdb_mi_record_free(record);
+		set_variable_info(var, records[i]->first);
 
 		var->evaluated = name != NULL;
 
 		/* add to updating list */
-		updating = g_list_prepend(updating, var);
+		update->vars = g_list_prepend(update->vars, var);
 	}
-	updating = g_list_reverse(updating);
+	free_command_records(records, count);
+	update->vars = g_list_reverse(update->vars);
 
 	/* update watches */
-	get_variables(updating);
+	get_variables_async(update->vars, on_watches_evaluated, update);
+}
+
+static void on_watches_deleted(struct gdb_mi_record **records, guint count, gpointer data)
+{
+	GPtrArray *commands = g_ptr_array_new_with_free_func(g_free);
+	GList *iter;
+
+	free_command_records(records, count);
+
+	/* create GDB variables */
+	for (iter = watches; iter; iter = iter->next)
+	{
+		variable *var = (variable*)iter->data;
+		gchar *escaped = escape_string(var->name->str);
 
-	/* free updating list */
-	g_list_free(updating);
+		g_ptr_array_add(commands, g_strdup_printf("-var-create - * \"%s\"", escaped));
+		g_free(escaped);
+	}
+	exec_command_batch(commands, on_watches_created, data);
 }
 
 /*
- * updates autos list
+ * updates watches list, calls "callback" when done
  */
-static void update_autos(void)
+static void update_watches_async(update_callback callback, gpointer data)
 {
-	gchar command[1000];
-	GList *unevaluated = NULL, *vars = NULL, *iter;
+	GPtrArray *commands = g_ptr_array_new_with_free_func(g_free);
+	GList *iter;
 
-	/* remove all previous GDB variables for autos */
-	for (iter = autos; iter; iter = iter->next)
+	/* delete all GDB variables */
+	for (iter = watches; iter; iter = iter->next)
 	{
 		variable *var = (variable*)iter->data;
 
-		g_snprintf(command, sizeof command, "-var-delete %s", var->internal->str);
-		exec_sync_command(command, TRUE, NULL);
+		if (var->internal->len)
+			g_ptr_array_add(commands, g_strdup_printf("-var-delete %s", var->internal->str));
+
+		/* reset all variables fields */
+		variable_reset(var);
 	}
+	exec_command_batch(commands, on_watches_deleted, variables_update_new(callback, data));
+}
 
-	g_list_foreach(autos, (GFunc)variable_free, NULL);
-	g_list_free(autos);
-	autos = NULL;
+/*
+ * updates watches list, waiting for the results
+ */
+static void update_watches(void)
+{
+	gboolean done = FALSE;
 
-	/* add current autos to the list */
+	update_watches_async(on_sync_update_done, &done);
+	wait_for_update(&done);
+}
 
-	struct gdb_mi_record *record = NULL;
+static void on_autos_evaluated(gpointer data)
+{
+	variables_update *update = (variables_update*)data;
+
+	/* add incorrect variables */
+	autos = g_list_concat(autos, update->unevaluated);
+	update->unevaluated = NULL;
+
+	variables_update_done(update);
+}
+
+static void on_autos_created(struct gdb_mi_record **records, guint count, gpointer data)
+{
+	variables_update *update = (variables_update*)data;
+	GList *iter;
+	guint i;
+
+	for (iter = update->vars, i = 0; iter; iter = iter->next, i++)
+	{
+		variable *var = iter->data;
+		const gchar *intname;
+
+		/* form new variable */
+		if (records[i] && gdb_mi_record_matches(records[i], '^', "done", NULL) &&
+			(intname = gdb_mi_result_var(records[i]->first, "name", GDB_MI_VAL_STRING)))
+		{
+			var->evaluated = TRUE;
+			g_string_assign(var->internal, intname);
+			set_variable_info(var, records[i]->first);
+			autos = g_list_append(autos, var);
+		}
+		else
+		{
+			var->evaluated = FALSE;
+			g_string_assign(var->internal, "");
+			update->unevaluated = g_list_append(update->unevaluated, var);
+		}
+	}
+	free_command_records(records, count);
+	g_list_free(update->vars);
+	update->vars = NULL;
+
+	/* get values for the autos (without incorrect variables) */
+	get_variables_async(autos, on_autos_evaluated, update);
+}
+
+static void on_autos_listed(struct gdb_mi_record **records, guint count, gpointer data)
+{
+	variables_update *update = (variables_update*)data;
+	GPtrArray *commands = g_ptr_array_new_with_free_func(g_free);
+	GList *iter;
 
-	g_snprintf(command, sizeof command, "-stack-list-arguments 0 %i %i", active_frame, active_frame);
-	if (RC_DONE == exec_sync_command(command, TRUE, &record) && record)
+	/* arguments */
+	if (records[0] && gdb_mi_record_matches(records[0], '^', "done", NULL))
 	{
-		const struct gdb_mi_result *stack_args = gdb_mi_result_var(record->first, "stack-args", GDB_MI_VAL_LIST);
+		const struct gdb_mi_result *stack_args = gdb_mi_result_var(records[0]->first, "stack-args", GDB_MI_VAL_LIST);
 
 		gdb_mi_result_foreach_matched (stack_args, stack_args, "frame", GDB_MI_VAL_LIST)
 		{
@@ -1401,59 +1909,79 @@ static void update_autos(void)
 			gdb_mi_result_foreach_matched (args, args, "name", GDB_MI_VAL_STRING)
 			{
 				variable *var = variable_new(args->val->v.string, VT_ARGUMENT);
-				vars = g_list_append(vars, var);
+				update->vars = g_list_append(update->vars, var);
 			}
 		}
 	}
-	gdb_mi_record_free(record);
 
-	if (RC_DONE == exec_sync_command("-stack-list-locals 0", TRUE, &record) && record)
+	/* locals */
+	if (records[1] && gdb_mi_record_matches(records[1], '^', "done", NULL))
 	{
-		const struct gdb_mi_result *locals = gdb_mi_result_var(record->first, "locals", GDB_MI_VAL_LIST);
+		const struct gdb_mi_result *locals = gdb_mi_result_var(records[1]->first, "locals", GDB_MI_VAL_LIST);
 
 		gdb_mi_result_foreach_matched (locals, locals, "name", GDB_MI_VAL_STRING)
 		{
 			variable *var = variable_new(locals->val->v.string, VT_LOCAL);
-			vars = g_list_append(vars, var);
+			update->vars = g_list_append(update->vars, var);
 		}
 	}
-	gdb_mi_record_free(record);
+	free_command_records(records, count);
 
-	for (iter = vars; iter; iter = iter->next)
+	/* create new gdb variables */
+	for (iter = update->vars; iter; iter = iter->next)
 	{
 		variable *var = iter->data;
-		struct gdb_mi_record *create_record = NULL;
-		gchar *escaped;
-		const gchar *intname;
+		gchar *escaped = escape_string(var->name->str);
 
-		/* create new gdb variable */
-		escaped = escape_string(var->name->str);
-		g_snprintf(command, sizeof command, "-var-create - * \"%s\"", escaped);
+		g_ptr_array_add(commands, g_strdup_printf("-var-create - * \"%s\"", escaped));
 		g_free(escaped);
+	}
+	exec_command_batch(commands, on_autos_created, update);
+}
 
-		/* form new variable */
-		if (RC_DONE == exec_sync_command(command, TRUE, &create_record) && create_record &&
-			(intname = gdb_mi_result_var(create_record->first, "name", GDB_MI_VAL_STRING)))
-		{
-			var->evaluated = TRUE;
-			g_string_assign(var->internal, intname);
-			autos = g_list_append(autos, var);
-		}
-		else
-		{
-			var->evaluated = FALSE;
-			g_string_assign(var->internal, "");
-			unevaluated = g_list_append(unevaluated, var);
-		}
-		gdb_mi_record_free(create_record);
+static void on_autos_deleted(struct gdb_mi_record **records, guint count, gpointer data)
+{
+	GPtrArray *commands = g_ptr_array_new_with_free_func(g_free);
+
+	free_command_records(records, count);
+
+	g_list_foreach(autos, (GFunc)variable_free, NULL);
+	g_list_free(autos);
+	autos = NULL;
+
+	/* add current autos to the list */
+	g_ptr_array_add(commands, g_strdup_printf("-stack-list-arguments 0 %i %i", active_frame, active_frame));
+	g_ptr_array_add(commands, g_strdup("-stack-list-locals 0"));
+	exec_command_batch(commands, on_autos_listed, data);
+}
+
+/*
+ * updates autos list, calls "callback" when done
+ */
+static void update_autos_async(update_callback callback, gpointer data)
+{
+	GPtrArray *commands = g_ptr_array_new_with_free_func(g_free);
+	GList *iter;
+
+	/* remove all previous GDB variables for autos */
+	for (iter = autos; iter; iter = iter->next)
+	{
+		variable *var = (variable*)iter->data;
+
+		g_ptr_array_add(commands, g_strdup_printf("-var-delete %s", var->internal->str));
 	}
-	g_list_free(vars);
+	exec_command_batch(commands, on_autos_deleted, variables_update_new(callback, data));
+}
 
-	/* get values for the autos (without incorrect variables) */
-	get_variables(autos);
+/*
+ * updates autos list, waiting for the results
+ */
+static void update_autos(void)
+{
+	gboolean done = FALSE;
 
-	/* add incorrect variables */
-	autos = g_list_concat(autos, unevaluated);
+	update_autos_async(on_sync_update_done, &done);
+	wait_for_update(&done);
 }
 
 /*
@@ -1508,7 +2036,7 @@ static GList* get_children (gchar* path)
 		return NULL;
 
 	/* recursive get children and put into list */
-	g_snprintf(command, sizeof command, "-var-list-children \"%s\"", path);
+	g_snprintf(command, sizeof command, "-var-list-children --all-values \"%s\"", path);
 	rc = exec_sync_command(command, TRUE, &record);
 	if (RC_DONE == rc && record)
 	{
@@ -1525,6 +2053,7 @@ static GList* get_children (gchar* path)
 
 			var = variable_new2(name, internal, VT_CHILD);
 			var->evaluated = TRUE;
+			set_variable_info(var, child_node->val->v.list);
 
 			children = g_list_prepend(children, var);
 		}
@@ -1564,6 +2093,7 @@ static variable* add_watch(gchar* expression)
 
 	name = gdb_mi_result_var(record->first, "name", GDB_MI_VAL_STRING);
 	g_string_assign(var->internal, name ? name : "");
+	set_variable_info(var, record->first);
 	var->evaluated = name != NULL;
 
 	vars = g_list_append(NULL, var);
@@ -1629,6 +2159,10 @@ static gboolean request_interrupt(void)
 	dbg_cbs->send_message(msg, "red");
 #endif
 
+	/* the target is stopped already and reports it once the refresh is done */
+	if (stop_refresh_pending)
+		return FALSE;
+
 	requested_interrupt = TRUE;
 	kill(target_pid, SIGINT);
 
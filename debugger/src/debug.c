@@ -106,6 +106,10 @@ dbg_module *active_module = NULL;
 bs_callback			interrupt_cb = NULL;
 gpointer			interrupt_data = NULL;
 
+/* whether to resume after the interrupt callback, FALSE if the debug module
+ * didn't interrupt because the target was stopping anyway */
+gboolean			interrupt_resume = TRUE;
+
 /* flag to set when debug stop is requested while debugger is running.
  * Then this flag is set to TRUE, and debug_request_interrupt function is called
  */
@@ -666,7 +670,7 @@ static void on_debugger_stopped (int thread_id)
 	debug_state = DBS_STOPPED;
 
 	/* update buttons panel state */
-	if (!interrupt_data)
+	if (!interrupt_data || !interrupt_resume)
 	{
 		btnpanel_set_debug_state(debug_state);
 	}
@@ -689,10 +693,13 @@ static void on_debugger_stopped (int thread_id)
 	{
 		interrupt_cb(interrupt_data);
 		interrupt_data = NULL;
-		
-		active_module->resume();
-		
-		return;
+
+		/* a real stop, go on handling it */
+		if (interrupt_resume)
+		{
+			active_module->resume();
+			return;
+		}
 	}
 
 	/* clear stack tree view */
@@ -1355,7 +1362,7 @@ void debug_request_interrupt(bs_callback cb, gpointer data)
 	interrupt_cb = cb;
 	interrupt_data = data;
 
-	active_module->request_interrupt();	
+	interrupt_resume = active_module->request_interrupt();
 }
 
 /*
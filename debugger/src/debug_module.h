@@ -136,6 +136,8 @@ typedef struct _dbg_module {
 
 	gchar* (*evaluate_expression)(gchar *expression);
 	
+	/* returns FALSE if the target is stopping anyway and no
+	interrupt was sent, so it must not be resumed after the stop */
 	gboolean (*request_interrupt) (void);
 	gchar* (*error_message) (void);
 	module_features features;
@@ -36,8 +36,132 @@
 
 #define ascii_isodigit(c) (((guchar) (c)) >= '0' && ((guchar) (c)) <= '7')
 
+/* minimum size of an arena chunk */
+#define ARENA_CHUNK_SIZE 4096
+/* alignment of arena allocations */
+#define ARENA_ALIGN(n) (((n) + 2 * sizeof(gpointer) - 1) & ~(2 * sizeof(gpointer) - 1))
 
-static struct gdb_mi_value *parse_value(const gchar **p);
+/* minimum number of results in a tuple or list for it to be indexed */
+#define INDEX_MIN_WIDTH 16
+
+
+/* arena chunk, its data follows the header */
+struct gdb_mi_chunk
+{
+	struct gdb_mi_chunk *next;
+	gsize size;
+	gsize used;
+};
+
+struct gdb_mi_arena
+{
+	struct gdb_mi_chunk *chunks;
+	GSList *indexes; /*< indexes to destroy with the arena */
+};
+
+struct gdb_mi_parser
+{
+	guint flags;
+	struct gdb_mi_arena *arena; /*< NULL if not parsing with GDB_MI_PARSE_ARENA */
+};
+
+
+static struct gdb_mi_value *parse_value(struct gdb_mi_parser *parser, gchar **p);
+
+
+static struct gdb_mi_arena *arena_new(void)
+{
+	return g_malloc0(sizeof(struct gdb_mi_arena));
+}
+
+static void arena_free(struct gdb_mi_arena *arena)
+{
+	while (arena->chunks)
+	{
+		struct gdb_mi_chunk *next = arena->chunks->next;
+		g_free(arena->chunks);
+		arena->chunks = next;
+	}
+	g_slist_free_full(arena->indexes, (GDestroyNotify) g_hash_table_destroy);
+	g_free(arena);
+}
+
+static gpointer arena_alloc(struct gdb_mi_arena *arena, gsize size)
+{
+	struct gdb_mi_chunk *chunk = arena->chunks;
+	gchar *mem;
+
+	size = ARENA_ALIGN(size);
+	if (! chunk || chunk->size - chunk->used < size)
+	{
+		gsize chunk_size = MAX(size, ARENA_CHUNK_SIZE);
+
+		/* grow geometrically so wide records need few chunks */
+		if (chunk)
+			chunk_size = MAX(chunk_size, chunk->size * 2);
+		chunk = g_malloc(ARENA_ALIGN(sizeof *chunk) + chunk_size);
+		chunk->size = chunk_size;
+		chunk->used = 0;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+
+	mem = (gchar *) chunk + ARENA_ALIGN(sizeof *chunk) + chunk->used;
+	chunk->used += size;
+	return mem;
+}
+
+static gpointer parser_alloc0(struct gdb_mi_parser *parser, gsize size)
+{
+	if (parser->arena)
+		return memset(arena_alloc(parser->arena, size), 0, size);
+	return g_malloc0(size);
+}
+
+static gchar *parser_strndup(struct gdb_mi_parser *parser, const gchar *str, gsize len)
+{
+	if (parser->arena)
+	{
+		gchar *dup = arena_alloc(parser->arena, len + 1);
+		memcpy(dup, str, len);
+		dup[len] = 0;
+		return dup;
+	}
+	return g_strndup(str, len);
+}
+
+static void parser_free_result(struct gdb_mi_parser *parser, struct gdb_mi_result *res)
+{
+	/* arena memory goes away with the record */
+	if (! parser->arena)
+		gdb_mi_result_free(res, TRUE);
+}
+
+/* builds a lookup table by name for the results starting at @first, if there
+ * are enough of them for it to be worth it */
+static void parser_index_results(struct gdb_mi_parser *parser, struct gdb_mi_result *first)
+{
+	struct gdb_mi_result *res;
+	guint n = 0;
+
+	if (! (parser->flags & GDB_MI_PARSE_INDEX))
+		return;
+
+	for (res = first; res && n < INDEX_MIN_WIDTH; res = res->next)
+		n++;
+	if (n < INDEX_MIN_WIDTH)
+		return;
+
+	first->index = g_hash_table_new(g_str_hash, g_str_equal);
+	for (res = first; res; res = res->next)
+	{
+		/* like a linear lookup, the first result of a name wins */
+		if (res->var && ! g_hash_table_lookup(first->index, res->var))
+			g_hash_table_insert(first->index, res->var, res);
+	}
+	if (parser->arena)
+		parser->arena->indexes = g_slist_prepend(parser->arena->indexes, first->index);
+}
 
 
 void gdb_mi_value_free(struct gdb_mi_value *val)
@@ -63,6 +187,8 @@ void gdb_mi_result_free(struct gdb_mi_result *res, gboolean next)
 		return;
 	g_free(res->var);
 	gdb_mi_value_free(res->val);
+	if (res->index)
+		g_hash_table_destroy(res->index);
 	if (next)
 		gdb_mi_result_free(res->next, next);
 	g_free(res);
@@ -72,6 +198,12 @@ void gdb_mi_record_free(struct gdb_mi_record *record)
 {
 	if (! record)
 		return;
+	if (record->arena)
+	{
+		/* the record itself lives in the arena */
+		arena_free(record->arena);
+		return;
+	}
 	g_free(record->token);
 	g_free(record->klass);
 	gdb_mi_result_free(record->first, TRUE);
@@ -85,100 +217,111 @@ void gdb_mi_record_free(struct gdb_mi_record *record)
  * c-string ==>
  *     """ seven-bit-iso-c-string-content """ 
  * 
+ * the string is unescaped in place, as its unescaped form is never longer.
+ * 
  * FIXME: what exactly does "seven-bit-iso-c-string-content" mean?
  *        reading between the lines suggests it's US-ASCII with values >= 0x80
  *        encoded as \NNN (most likely octal), but that's not really clear --
  *        although it parses everything I encountered
  * FIXME: this does NOT convert to UTF-8.  should it? */
-static gchar *parse_cstring(const gchar **p)
+static gchar *parse_cstring(struct gdb_mi_parser *parser, gchar **p)
 {
-	GString *str = g_string_new(NULL);
+	gchar *start, *out;
+	const gchar *base;
 
-	if (**p == '"')
-	{
-		const gchar *base;
+	if (**p != '"')
+		return parser_strndup(parser, "", 0);
 
-		(*p)++;
-		base = *p;
-		while (**p != '"')
+	(*p)++;
+	start = out = *p;
+	base = *p;
+	while (**p != '"')
+	{
+		gchar c = **p;
+		/* TODO: check expansions here */
+		if (c == '\\')
 		{
-			gchar c = **p;
-			/* TODO: check expansions here */
-			if (c == '\\')
+			memmove(out, base, (gsize) ((*p) - base));
+			out += (*p) - base;
+			(*p)++;
+			c = **p;
+			switch (g_ascii_tolower(c))
 			{
-				g_string_append_len(str, base, (*p) - base);
-				(*p)++;
-				c = **p;
-				switch (g_ascii_tolower(c))
-				{
-					case '\\':
-					case '"': break;
-					case 'a': c = '\a'; break;
-					case 'b': c = '\b'; break;
-					case 'f': c = '\f'; break;
-					case 'n': c = '\n'; break;
-					case 'r': c = '\r'; break;
-					case 't': c = '\t'; break;
-					case 'v': c = '\v'; break;
-					default:
-						/* hex escape, 1-2 digits (\xN or \xNN)
-						 * 
-						 * FIXME: is this useful?  Is this right?
-						 * the original dbm_gdb.c:unescape_hex_values() used to
-						 * read escapes of the form \xNNN and treat them as wide
-						 * characters numbers, but  this looks weird for a C-like
-						 * escape.
-						 * Also, note that this doesn't seem to be referenced anywhere
-						 * in GDB/MI syntax.  Only reference in GDB manual is about
-						 * keybindings, which use the syntax implemented here */
-						if (g_ascii_tolower(**p) == 'x' && g_ascii_isxdigit((*p)[1]))
-						{
-							c = (gchar) g_ascii_xdigit_value(*++(*p));
-							if (g_ascii_isxdigit((*p)[1]))
-								c = (gchar) ((c * 16) + g_ascii_xdigit_value(*++(*p)));
-						}
-						/* octal escape, 1-3 digits (\N, \NN or \NNN) */
-						else if (ascii_isodigit(**p))
-						{
-							int i, v;
-							v = g_ascii_digit_value(**p);
-							for (i = 0; ascii_isodigit((*p)[1]) && i < 2; i++)
-								v = (v * 8) + g_ascii_digit_value(*++(*p));
-							if (v <= 0xff)
-								c = (gchar) v;
-							else
-							{
-								*p = *p - 3; /* put the whole sequence back */
-								c = **p;
-								g_warning("Octal escape sequence out of range: %.4s", *p);
-							}
-						}
+				case '\\':
+				case '"': break;
+				case 'a': c = '\a'; break;
+				case 'b': c = '\b'; break;
+				case 'f': c = '\f'; break;
+				case 'n': c = '\n'; break;
+				case 'r': c = '\r'; break;
+				case 't': c = '\t'; break;
+				case 'v': c = '\v'; break;
+				default:
+					/* hex escape, 1-2 digits (\xN or \xNN)
+					 * 
+					 * FIXME: is this useful?  Is this right?
+					 * the original dbm_gdb.c:unescape_hex_values() used to
+					 * read escapes of the form \xNNN and treat them as wide
+					 * characters numbers, but  this looks weird for a C-like
+					 * escape.
+					 * Also, note that this doesn't seem to be referenced anywhere
+					 * in GDB/MI syntax.  Only reference in GDB manual is about
+					 * keybindings, which use the syntax implemented here */
+					if (g_ascii_tolower(**p) == 'x' && g_ascii_isxdigit((*p)[1]))
+					{
+						c = (gchar) g_ascii_xdigit_value(*++(*p));
+						if (g_ascii_isxdigit((*p)[1]))
+							c = (gchar) ((c * 16) + g_ascii_xdigit_value(*++(*p)));
+					}
+					/* octal escape, 1-3 digits (\N, \NN or \NNN) */
+					else if (ascii_isodigit(**p))
+					{
+						int i, v;
+						v = g_ascii_digit_value(**p);
+						for (i = 0; ascii_isodigit((*p)[1]) && i < 2; i++)
+							v = (v * 8) + g_ascii_digit_value(*++(*p));
+						if (v <= 0xff)
+							c = (gchar) v;
 						else
 						{
-							g_warning("Unknown escape \"\\%c\"", **p);
-							(*p)--; /* put the \ back */
+							*p = *p - 3; /* put the whole sequence back */
 							c = **p;
+							g_warning("Octal escape sequence out of range: %.4s", *p);
 						}
-						break;
-				}
-				g_string_append_c(str, c);
-				base = (*p) + 1;
+					}
+					else
+					{
+						g_warning("Unknown escape \"\\%c\"", **p);
+						(*p)--; /* put the \ back */
+						c = **p;
+					}
+					break;
 			}
-			else if (**p == '\0')
-				break;
-			(*p)++;
+			*out++ = c;
+			base = (*p) + 1;
 		}
-		g_string_append_len(str, base, (*p) - base);
-		if (**p == '"')
-			(*p)++;
+		else if (**p == '\0')
+			break;
+		(*p)++;
+	}
+	memmove(out, base, (gsize) ((*p) - base));
+	out += (*p) - base;
+	if (**p == '"')
+		(*p)++;
+
+	/* the arena owns the line, so the string can stay there */
+	if (parser->arena)
+	{
+		*out = 0;
+		return start;
 	}
-	return g_string_free(str, FALSE);
+	return g_strndup(start, (gsize) (out - start));
 }
 
 /* parses: string
  * FIXME: what really is a string?  here it uses [a-zA-Z_-.][a-zA-Z0-9_-.]* but
  *        the docs aren't clear on this */
-static gchar *parse_string(const gchar **p)
+static gchar *parse_string(struct gdb_mi_parser *parser, gchar **p)
 {
 	const gchar *base = *p;
 
@@ -188,47 +331,47 @@ static gchar *parse_string(const gchar **p)
 			;
 	}
 
-	return g_strndup (base, *p - base);
+	return parser_strndup(parser, base, (gsize) (*p - base));
 }
 
 /* parses: string "=" value */
-static gboolean parse_result(struct gdb_mi_result *result, const gchar **p)
+static gboolean parse_result(struct gdb_mi_parser *parser, struct gdb_mi_result *result, gchar **p)
 {
-	result->var = parse_string(p);
+	result->var = parse_string(parser, p);
 	while (g_ascii_isspace(**p)) (*p)++;
 	if (**p == '=')
 	{
 		(*p)++;
 		while (g_ascii_isspace(**p)) (*p)++;
-		result->val = parse_value(p);
+		result->val = parse_value(parser, p);
 	}
 	return result->var && result->val;
 }
 
 /* parses: cstring | list | tuple
  * Actually, this is more permissive and allows mixed tuples/lists */
-static struct gdb_mi_value *parse_value(const gchar **p)
+static struct gdb_mi_value *parse_value(struct gdb_mi_parser *parser, gchar **p)
 {
 	struct gdb_mi_value *val = NULL;
 	if (**p == '"')
 	{
-		val = g_malloc0(sizeof *val);
+		val = parser_alloc0(parser, sizeof *val);
 		val->type = GDB_MI_VAL_STRING;
-		val->v.string = parse_cstring(p);
+		val->v.string = parse_cstring(parser, p);
 	}
 	else if (**p == '{' || **p == '[')
 	{
 		struct gdb_mi_result *prev = NULL;
-		val = g_malloc0(sizeof *val);
+		val = parser_alloc0(parser, sizeof *val);
 		val->type = GDB_MI_VAL_LIST;
 		gchar end = **p == '{' ? '}' : ']';
 		(*p)++;
 		while (**p && **p != end)
 		{
-			struct gdb_mi_result *item = g_malloc0(sizeof *item);
+			struct gdb_mi_result *item = parser_alloc0(parser, sizeof *item);
 			while (g_ascii_isspace(**p)) (*p)++;
-			if ((item->val = parse_value(p)) ||
-				parse_result(item, p))
+			if ((item->val = parse_value(parser, p)) ||
+				parse_result(parser, item, p))
 			{
 				if (prev)
 					prev->next = item;
@@ -238,7 +381,7 @@ static struct gdb_mi_value *parse_value(const gchar **p)
 			}
 			else
 			{
-				gdb_mi_result_free(item, TRUE);
+				parser_free_result(parser, item);
 				break;
 			}
 			while (g_ascii_isspace(**p)) (*p)++;
@@ -247,6 +390,8 @@ static struct gdb_mi_value *parse_value(const gchar **p)
 		}
 		if (**p == end)
 			(*p)++;
+		if (val->v.list)
+			parser_index_results(parser, val->v.list);
 	}
 	return val;
 }
@@ -264,6 +409,11 @@ static gboolean is_prompt(const gchar *p)
 /* parses: async-record | stream-record | result-record
  * note: post-value data is ignored.
  * 
+ * with GDB_MI_PARSE_ARENA, the record and all its nodes and strings are
+ * allocated from a single arena freed with the record, and the nodes must not
+ * be freed separately.  with GDB_MI_PARSE_INDEX, wide tuples and lists get a
+ * lookup table by name for gdb_mi_result_var().
+ * 
  * FIXME: that's NOT exactly what the GDB docs call an output, and that's not
  *        exactly what a line could be.  The GDB docs state that a line can
  *        contain more than one stream-record, as it's not terminated by a
@@ -286,9 +436,29 @@ static gboolean is_prompt(const gchar *p)
  *        parser here only extracts the first record it will fail with combined
  *        records in one line.
  */
-struct gdb_mi_record *gdb_mi_record_parse(const gchar *line)
+struct gdb_mi_record *gdb_mi_record_parse_full(const gchar *input, guint flags)
 {
-	struct gdb_mi_record *record = g_malloc0(sizeof *record);
+	struct gdb_mi_parser parser = { flags, NULL };
+	struct gdb_mi_record *record;
+	gchar *buffer;
+	gchar *line;
+
+	/* work on a copy of the input, strings are unescaped in place */
+	if (flags & GDB_MI_PARSE_ARENA)
+	{
+		gsize len = strlen(input);
+
+		parser.arena = arena_new();
+		buffer = memcpy(arena_alloc(parser.arena, len + 1), input, len + 1);
+		record = parser_alloc0(&parser, sizeof *record);
+		record->arena = parser.arena;
+	}
+	else
+	{
+		buffer = g_strdup(input);
+		record = g_malloc0(sizeof *record);
+	}
+	line = buffer;
 
 	/* FIXME: prompt detection should not really be useful, especially not as a
 	 * special case, as the prompt should always follow an (optional) record */
@@ -297,12 +467,12 @@ struct gdb_mi_record *gdb_mi_record_parse(const gchar *line)
 	else
 	{
 		/* extract token */
-		const gchar *token_end = line;
+		gchar *token_end = line;
 		for (token_end = line; g_ascii_isdigit(*token_end); token_end++)
 			;
 		if (token_end > line)
 		{
-			record->token = g_strndup(line, (gsize)(token_end - line));
+			record->token = parser_strndup(&parser, line, (gsize)(token_end - line));
 			line = token_end;
 			while (g_ascii_isspace(*line)) line++;
 		}
@@ -325,7 +495,7 @@ struct gdb_mi_record *gdb_mi_record_parse(const gchar *line)
 				 * > implicit newline).
 				 * 
 				 * This adds "raw text" to "c-string"... so? */
-				record->klass = parse_cstring(&line);
+				record->klass = parse_cstring(&parser, &line);
 				break;
 			case '^':
 			case '*':
@@ -333,7 +503,7 @@ struct gdb_mi_record *gdb_mi_record_parse(const gchar *line)
 			case '=':
 			{
 				struct gdb_mi_result *prev = NULL;
-				record->klass = parse_string(&line);
+				record->klass = parse_string(&parser, &line);
 				while (*line)
 				{
 					while (g_ascii_isspace(*line)) line++;
@@ -341,13 +511,13 @@ struct gdb_mi_record *gdb_mi_record_parse(const gchar *line)
 						break;
 					else
 					{
-						struct gdb_mi_result *res = g_malloc0(sizeof *res);
+						struct gdb_mi_result *res = parser_alloc0(&parser, sizeof *res);
 						line++;
 						while (g_ascii_isspace(*line)) line++;
-						if (!parse_result(res, &line))
+						if (!parse_result(&parser, res, &line))
 						{
 							g_warning("failed to parse result");
-							gdb_mi_result_free(res, TRUE);
+							parser_free_result(&parser, res);
 							break;
 						}
 						if (prev)
@@ -357,6 +527,8 @@ struct gdb_mi_record *gdb_mi_record_parse(const gchar *line)
 						prev = res;
 					}
 				}
+				if (record->first)
+					parser_index_results(&parser, record->first);
 				break;
 			}
 			default:
@@ -365,15 +537,30 @@ struct gdb_mi_record *gdb_mi_record_parse(const gchar *line)
 		}
 	}
 
+	if (! parser.arena)
+		g_free(buffer);
+
 	return record;
 }
 
+/* parses a record allocating each node separately, see gdb_mi_record_parse_full() */
+struct gdb_mi_record *gdb_mi_record_parse(const gchar *line)
+{
+	return gdb_mi_record_parse_full(line, 0);
+}
+
 /* Extracts a variable value from a result
  * @res may be NULL */
 static const struct gdb_mi_value *gdb_mi_result_var_value(const struct gdb_mi_result *result, const gchar *name)
 {
 	g_return_val_if_fail(name != NULL, NULL);
 
+	if (result && result->index)
+	{
+		const struct gdb_mi_result *found = g_hash_table_lookup(result->index, name);
+		return found ? found->val : NULL;
+	}
+
 	for (; result; result = result->next)
 	{
 		if (result->var && strcmp(result->var, name) == 0)
@@ -495,13 +682,95 @@ static gchar *read_line(FILE *fp)
 	return g_string_free(line, line->len < 1);
 }
 
+/* number of times the benchmark parses its input in each mode */
+#define BENCH_ROUNDS 20
+
+/* looks up every result of the given results by name, to measure lookups */
+static guint lookup_all(const struct gdb_mi_result *first)
+{
+	const struct gdb_mi_result *res;
+	guint found = 0;
+
+	for (res = first; res; res = res->next)
+	{
+		if (res->var && gdb_mi_result_var(first, res->var, res->val->type))
+			found++;
+		if (res->val->type == GDB_MI_VAL_LIST)
+			found += lookup_all(res->val->v.list);
+	}
+	return found;
+}
+
+static int benchmark(FILE *fp)
+{
+	const guint modes[] = { 0, GDB_MI_PARSE_ARENA, GDB_MI_PARSE_ARENA | GDB_MI_PARSE_INDEX };
+	const gchar *names[] = { "plain", "arena", "arena+index" };
+	GPtrArray *lines = g_ptr_array_new_with_free_func(g_free);
+	gsize bytes = 0;
+	gchar *line;
+	guint m;
+
+	while ((line = read_line(fp)) != NULL)
+	{
+		bytes += strlen(line);
+		g_ptr_array_add(lines, line);
+	}
+
+	for (m = 0; m < G_N_ELEMENTS(modes); m++)
+	{
+		gint64 parse_time = 0, lookup_time = 0;
+		guint found = 0;
+		guint r, i;
+
+		for (r = 0; r < BENCH_ROUNDS; r++)
+		{
+			for (i = 0; i < lines->len; i++)
+			{
+				gint64 start = g_get_monotonic_time();
+				struct gdb_mi_record *record = gdb_mi_record_parse_full(lines->pdata[i], modes[m]);
+				gint64 parsed = g_get_monotonic_time();
+
+				found += lookup_all(record->first);
+				lookup_time += g_get_monotonic_time() - parsed;
+				gdb_mi_record_free(record);
+				parse_time += parsed - start;
+			}
+		}
+
+		printf("%-12s parse: %8.1f MB/s, %10.0f records/s, lookups: %8" G_GINT64_FORMAT " us (%u found)\n",
+			names[m],
+			(double) bytes * BENCH_ROUNDS / MAX(parse_time, 1),
+			(double) lines->len * BENCH_ROUNDS * G_USEC_PER_SEC / MAX(parse_time, 1),
+			lookup_time, found);
+	}
+
+	g_ptr_array_free(lines, TRUE);
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
+	guint flags = 0;
 	gchar *line;
+	gint i;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--arena") == 0)
+			flags |= GDB_MI_PARSE_ARENA | GDB_MI_PARSE_INDEX;
+		else if (strcmp(argv[i], "--bench") == 0)
+			return benchmark(stdin);
+		else
+		{
+			fprintf(stderr, "Usage: %s [--arena | --bench]\n", argv[0]);
+			return 1;
+		}
+	}
 
 	while ((line = read_line(stdin)) != NULL)
 	{
-		struct gdb_mi_record *record = gdb_mi_record_parse(line);
+		struct gdb_mi_record *record = gdb_mi_record_parse_full(line, flags);
 
 		gdb_mi_record_dump(record);
 		gdb_mi_record_free(record);
@@ -45,6 +45,7 @@ struct gdb_mi_result
 	gchar *var;
 	struct gdb_mi_value *val;
 	struct gdb_mi_result *next;
+	GHashTable *index; /*< results from this one by name, for wide tuples (if any) */
 };
 
 enum gdb_mi_record_type
@@ -59,12 +60,20 @@ enum gdb_mi_record_type
 	GDB_MI_TYPE_LOG_STREAM = '&'
 };
 
+enum gdb_mi_parse_flags
+{
+	GDB_MI_PARSE_ARENA = 1 << 0, /*< allocate the whole record from one arena */
+	GDB_MI_PARSE_INDEX = 1 << 1 /*< index wide tuples and lists by name */
+};
+
+struct gdb_mi_arena;
 struct gdb_mi_record
 {
 	enum gdb_mi_record_type type;
 	gchar *token;
 	gchar *klass; /*< contains the async record class or the stream output */
 	struct gdb_mi_result *first; /*< pointer to the first result (if any) */
+	struct gdb_mi_arena *arena; /*< memory of the whole record (if any) */
 };
 
 
@@ -72,6 +81,7 @@ void gdb_mi_value_free(struct gdb_mi_value *val);
 void gdb_mi_result_free(struct gdb_mi_result *res, gboolean next);
 void gdb_mi_record_free(struct gdb_mi_record *record);
 struct gdb_mi_record *gdb_mi_record_parse(const gchar *line);
+struct gdb_mi_record *gdb_mi_record_parse_full(const gchar *line, guint flags);
 const void *gdb_mi_result_var(const struct gdb_mi_result *result, const gchar *name, enum gdb_mi_value_type type);
 gboolean gdb_mi_record_matches(const struct gdb_mi_record *record, enum gdb_mi_record_type type, const gchar *klass, ...) G_GNUC_NULL_TERMINATED;
 
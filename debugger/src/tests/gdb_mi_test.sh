@@ -9,14 +9,58 @@ strip_comments()
   ${SED:-sed} -e '/^#/d'
 }
 
+# generates large replies, like the ones for big programs
+large_input()
+{
+  ${AWK:-awk} 'BEGIN {
+    # -stack-list-frames
+    printf "^done,stack=["
+    for (i = 0; i < 2000; i++)
+      printf "%sframe={level=\"%d\",addr=\"0x%016x\",func=\"func_%d\",file=\"file_%d.c\",fullname=\"/some/path/file_%d.c\",line=\"%d\"}", (i ? "," : ""), i, i * 16, i, i, i, i
+    printf "]\n"
+    # -file-list-exec-source-files
+    printf "^done,files=["
+    for (i = 0; i < 5000; i++)
+      printf "%s{file=\"dir_%d/file_%d.c\",fullname=\"/some/path/dir_%d/file_\\303\\251_%d.c\"}", (i ? "," : ""), i % 50, i, i % 50, i
+    printf "]\n"
+    # -data-read-memory
+    printf "^done,addr=\"0x00601040\",nr-bytes=\"4096\",total-bytes=\"4096\",next-row=\"0x00602040\",prev-row=\"0x00600040\",next-page=\"0x00602040\",prev-page=\"0x00600040\",memory=["
+    for (i = 0; i < 256; i++)
+    {
+      printf "%s{addr=\"0x%08x\",data=[", (i ? "," : ""), 6295616 + i * 16
+      for (j = 0; j < 16; j++)
+        printf "%s\"0x%02x\"", (j ? "," : ""), (i + j) % 256
+      printf "]}"
+    }
+    printf "]\n"
+    # wide tuple
+    printf "^done,value={"
+    for (i = 0; i < 2000; i++)
+      printf "%sfield_%d=\"value \\\"%d\\\"\"", (i ? "," : ""), i, i
+    printf "}\n"
+  }'
+}
+
 SUBDIR=tests
 TMPOUT=$SUBDIR/gdb_mi_test.output.tmp
 TMPEXCPT=$SUBDIR/gdb_mi_test.expected.tmp
+TMPLARGE=$SUBDIR/gdb_mi_test.large.tmp
 
-trap 'rm -f "$TMPOUT" "$TMPEXCPT";
+trap 'rm -f "$TMPOUT" "$TMPEXCPT" "$TMPLARGE";
       rmdir "$SUBDIR" 2>/dev/null || :' EXIT QUIT TERM INT
 
 test -d "$SUBDIR" || mkdir "$SUBDIR"
 strip_comments < "$srcdir/tests/gdb_mi_test.input" | ./gdb_mi_test 2> "$TMPOUT"
 strip_comments < "$srcdir/tests/gdb_mi_test.expected" > "$TMPEXCPT"
 diff -u "$TMPEXCPT" "$TMPOUT"
+
+# the arena parser should give the very same results
+strip_comments < "$srcdir/tests/gdb_mi_test.input" | ./gdb_mi_test --arena 2> "$TMPOUT"
+diff -u "$TMPEXCPT" "$TMPOUT"
+
+# large input throughput, both parsers should agree too
+large_input > "$TMPLARGE"
+./gdb_mi_test < "$TMPLARGE" 2> "$TMPEXCPT"
+./gdb_mi_test --arena < "$TMPLARGE" 2> "$TMPOUT"
+cmp "$TMPEXCPT" "$TMPOUT"
+./gdb_mi_test --bench < "$TMPLARGE"
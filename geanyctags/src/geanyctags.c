@@ -18,6 +18,7 @@
 
 #include <sys/time.h>
 #include <string.h>
+#include <time.h>
 
 #ifdef HAVE_CONFIG_H
 # include "config.h"
@@ -26,6 +27,7 @@
 #include <geanyplugin.h>
 
 #include "readtags.h"
+#include "tagcache.h"
 
 #include <errno.h>
 #include <glib/gstdio.h>
@@ -36,6 +38,9 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <signal.h>
+#ifndef G_OS_WIN32
+# include <utime.h>
+#endif
 
 
 /* Pre-GTK 2.24 compatibility */
@@ -51,7 +56,7 @@ static GeanyData *geany_data = NULL;
 
 
 static GtkWidget *s_context_fdec_item, *s_context_fdef_item, *s_context_sep_item,
-	*s_gt_item, *s_sep_item, *s_ft_item;
+	*s_gt_item, *s_ut_item, *s_sep_item, *s_ft_item;
 
 static struct
 {
@@ -63,11 +68,14 @@ static struct
 	GtkWidget *declaration;
 } s_ft_dialog = {NULL, NULL, NULL, NULL, NULL};
 
+static TagCache *s_tag_cache = NULL;
+
 
 enum
 {
 	KB_FIND_TAG,
 	KB_GENERATE_TAGS,
+	KB_UPDATE_TAGS,
 	KB_COUNT
 };
 
@@ -76,6 +84,7 @@ enum
 static void set_widgets_sensitive(gboolean sensitive)
 {
 	gtk_widget_set_sensitive(GTK_WIDGET(s_gt_item), sensitive);
+	gtk_widget_set_sensitive(GTK_WIDGET(s_ut_item), sensitive);
 	gtk_widget_set_sensitive(GTK_WIDGET(s_ft_item), sensitive);
 	gtk_widget_set_sensitive(GTK_WIDGET(s_context_fdec_item), sensitive);
 	gtk_widget_set_sensitive(GTK_WIDGET(s_context_fdef_item), sensitive);
@@ -86,9 +95,16 @@ static void on_project_open(G_GNUC_UNUSED GObject * obj, GKeyFile * config, G_GN
 	set_widgets_sensitive(TRUE);
 }
 
+static void close_tag_cache(void)
+{
+	tag_cache_free(s_tag_cache);
+	s_tag_cache = NULL;
+}
+
 static void on_project_close(G_GNUC_UNUSED GObject * obj, G_GNUC_UNUSED gpointer user_data)
 {
 	set_widgets_sensitive(FALSE);
+	close_tag_cache();
 }
 
 static void on_project_save(G_GNUC_UNUSED GObject * obj, GKeyFile * config, G_GNUC_UNUSED gpointer user_data)
@@ -108,17 +124,375 @@ static void plugin_geanyctags_help (G_GNUC_UNUSED GeanyPlugin *plugin, G_GNUC_UN
 	utils_open_browser("https://plugins.geany.org/geanyctags.html");
 }
 
-static void spawn_cmd(const gchar *cmd, const gchar *dir)
+typedef struct
+{
+	gchar *tag_filename;
+	gchar *tmp_filename;	/* the finished tags file, renamed over tag_filename */
+	gchar *new_filename;	/* ctags output of the changed files (incremental only) */
+	gchar *files_filename;	/* list of the changed files (incremental only) */
+	gchar *base_path;	/* locale encoded */
+	gboolean incremental;
+	time_t start_time;
+	GPid pid;
+	gint cancelled;
+
+	GThread *thread;
+	gchar *merge_error;
+	guint added, removed;
+} GenerateJob;
+
+static GenerateJob *s_job = NULL;
+
+
+static void generate_job_free(GenerateJob *job)
+{
+	if (job->tmp_filename)
+		g_unlink(job->tmp_filename);
+	if (job->incremental)
+	{
+		g_unlink(job->new_filename);
+		g_unlink(job->files_filename);
+	}
+
+	if (s_job == job)
+		s_job = NULL;
+
+	g_free(job->tag_filename);
+	g_free(job->tmp_filename);
+	g_free(job->new_filename);
+	g_free(job->files_filename);
+	g_free(job->base_path);
+	g_free(job->merge_error);
+	g_free(job);
+}
+
+static gboolean install_tags_file(GenerateJob *job)
+{
+	/* the old file may still be mapped, which prevents renaming over it on windows */
+	close_tag_cache();
+
+	if (g_rename(job->tmp_filename, job->tag_filename) != 0)
+	{
+		msgwin_msg_add(COLOR_RED, -1, NULL, _("Failed to write %s (%s)"), job->tag_filename,
+			g_strerror(errno));
+		return FALSE;
+	}
+
+#ifndef G_OS_WIN32
+	{
+		struct utimbuf times;
+
+		/* files modified while ctags was running are picked by the next update */
+		times.actime = times.modtime = job->start_time;
+		g_utime(job->tag_filename, &times);
+	}
+#endif
+
+	if (job->incremental)
+	{
+		msgwin_msg_add(COLOR_BLUE, -1, NULL, _("Tags updated: %u added, %u removed"),
+			job->added, job->removed);
+	}
+	else
+		msgwin_msg_add(COLOR_BLUE, -1, NULL, _("Tags generated"));
+	return TRUE;
+}
+
+static gboolean on_index_finished(gpointer data)
+{
+	GenerateJob *job = data;
+
+	g_thread_join(job->thread);
+	generate_job_free(job);
+	return G_SOURCE_REMOVE;
+}
+
+static gpointer index_thread(gpointer data)
+{
+	GenerateJob *job = data;
+
+	if (!g_atomic_int_get(&job->cancelled))
+		tag_cache_update_index(job->tag_filename);
+
+	g_idle_add(on_index_finished, job);
+	return NULL;
+}
+
+/* builds the index for pattern lookups once the tags file is in place; the job
+ * stays running meanwhile so that no new tags file replaces the one being read */
+static void index_tags_file(GenerateJob *job)
+{
+	job->thread = g_thread_new("geanyctags-index", index_thread, job);
+}
+
+/* sort --ignore-case order, which is what ctags --sort=foldcase produces */
+static gint compare_tag_lines(const gchar *a, gsize a_len, const gchar *b, gsize b_len)
+{
+	gsize len = MIN(a_len, b_len);
+	gsize i;
+
+	for (i = 0; i < len; i++)
+	{
+		gint ca = g_ascii_toupper(a[i]);
+		gint cb = g_ascii_toupper(b[i]);
+
+		if (ca != cb)
+			return (guchar) ca - (guchar) cb;
+	}
+
+	if (a_len != b_len)
+		return a_len < b_len ? -1 : 1;
+
+	return memcmp(a, b, len);
+}
+
+static const gchar *next_line(const gchar *pos, const gchar *end)
+{
+	const gchar *nl = memchr(pos, '\n', end - pos);
+	return nl ? nl + 1 : end;
+}
+
+static gsize line_length(const gchar *pos, const gchar *next)
+{
+	gsize len = next - pos;
+
+	if (len && pos[len - 1] == '\n')
+		len--;
+	if (len && pos[len - 1] == '\r')
+		len--;
+	return len;
+}
+
+static gboolean is_pseudo_tag(const gchar *pos, const gchar *end)
+{
+	return end - pos >= 6 && strncmp(pos, "!_TAG_", 6) == 0;
+}
+
+static gboolean write_tag_line(FILE *fp, const gchar *pos, gsize len)
+{
+	return fwrite(pos, 1, len, fp) == len && putc('\n', fp) != EOF;
+}
+
+/* tags of files that were re-scanned or no longer exist are dropped */
+static gboolean keep_old_line(GenerateJob *job, const gchar *pos, gsize len,
+	GHashTable *changed, GHashTable *existing, GString *file)
+{
+	const gchar *end = pos + len;
+	const gchar *start = memchr(pos, '\t', len);
+	const gchar *stop;
+	gpointer exists;
+
+	if (!start)
+		return FALSE;
+	start++;
+	stop = memchr(start, '\t', end - start);
+	if (!stop)
+		return FALSE;
+
+	g_string_truncate(file, 0);
+	g_string_append_len(file, start, stop - start);
+
+	if (g_hash_table_contains(changed, file->str))
+		return FALSE;
+
+	exists = g_hash_table_lookup(existing, file->str);
+	if (!exists)
+	{
+		gchar *path = g_build_filename(job->base_path, file->str, NULL);
+
+		exists = GINT_TO_POINTER(g_file_test(path, G_FILE_TEST_EXISTS) ? 1 : 2);
+		g_hash_table_insert(existing, g_strdup(file->str), exists);
+		g_free(path);
+	}
+
+	return exists == GINT_TO_POINTER(1);
+}
+
+static gboolean merge_tags(GenerateJob *job, FILE *fp, const gchar *old_pos, const gchar *old_end,
+	const gchar *new_pos, const gchar *new_end, gchar **files)
+{
+	GHashTable *changed = g_hash_table_new(g_str_hash, g_str_equal);
+	GHashTable *existing = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	GString *file = g_string_new(NULL);
+	const gchar *old_checked = NULL;
+	gboolean success = TRUE;
+	guint count = 0;
+	gchar **name;
+
+	for (name = files; *name; name++)
+	{
+		g_strchomp(*name);
+		if (**name)
+			g_hash_table_add(changed, *name);
+	}
+
+	/* the pseudo tags of the new file describe the merged one as well */
+	while (new_pos < new_end && is_pseudo_tag(new_pos, new_end))
+	{
+		const gchar *next = next_line(new_pos, new_end);
+
+		success &= write_tag_line(fp, new_pos, line_length(new_pos, next));
+		new_pos = next;
+	}
+
+	while (old_pos < old_end && is_pseudo_tag(old_pos, old_end))
+		old_pos = next_line(old_pos, old_end);
+
+	while (success && (old_pos < old_end || new_pos < new_end))
+	{
+		const gchar *old_next = old_pos < old_end ? next_line(old_pos, old_end) : old_end;
+		const gchar *new_next = new_pos < new_end ? next_line(new_pos, new_end) : new_end;
+		gsize old_len = line_length(old_pos, old_next);
+		gsize new_len = line_length(new_pos, new_next);
+
+		if ((++count & 0xfff) == 0 && g_atomic_int_get(&job->cancelled))
+			success = FALSE;
+		else if (old_pos < old_end && old_pos != old_checked &&
+			!keep_old_line(job, old_pos, old_len, changed, existing, file))
+		{
+			job->removed++;
+			old_pos = old_next;
+		}
+		else if (old_pos < old_end && (new_pos == new_end ||
+			compare_tag_lines(old_pos, old_len, new_pos, new_len) <= 0))
+		{
+			old_checked = old_pos;
+			success = write_tag_line(fp, old_pos, old_len);
+			old_pos = old_next;
+		}
+		else
+		{
+			old_checked = old_pos;
+			success = write_tag_line(fp, new_pos, new_len);
+			job->added++;
+			new_pos = new_next;
+		}
+	}
+
+	g_string_free(file, TRUE);
+	g_hash_table_destroy(existing);
+	g_hash_table_destroy(changed);
+	return success;
+}
+
+static gboolean on_merge_finished(gpointer data)
+{
+	GenerateJob *job = data;
+
+	g_thread_join(job->thread);
+
+	if (!g_atomic_int_get(&job->cancelled))
+	{
+		if (job->merge_error)
+			msgwin_msg_add(COLOR_RED, -1, NULL, _("Failed to merge tags (%s)"), job->merge_error);
+		else if (install_tags_file(job))
+		{
+			index_tags_file(job);
+			return G_SOURCE_REMOVE;
+		}
+	}
+
+	generate_job_free(job);
+	return G_SOURCE_REMOVE;
+}
+
+static gpointer merge_thread(gpointer data)
+{
+	GenerateJob *job = data;
+	GMappedFile *old_map = NULL, *new_map = NULL;
+	gchar *contents = NULL;
+	GError *error = NULL;
+
+	if ((old_map = g_mapped_file_new(job->tag_filename, FALSE, &error)) != NULL &&
+		(new_map = g_mapped_file_new(job->new_filename, FALSE, &error)) != NULL &&
+		g_file_get_contents(job->files_filename, &contents, NULL, &error))
+	{
+		const gchar *old_pos = g_mapped_file_get_contents(old_map);
+		const gchar *new_pos = g_mapped_file_get_contents(new_map);
+		gchar **files = g_strsplit(contents, "\n", -1);
+		FILE *fp = g_fopen(job->tmp_filename, "wb");
+
+		if (!fp)
+			job->merge_error = g_strdup(g_strerror(errno));
+		else
+		{
+			gboolean success = merge_tags(job, fp,
+				old_pos, old_pos + g_mapped_file_get_length(old_map),
+				new_pos, new_pos + g_mapped_file_get_length(new_map), files);
+
+			if (ferror(fp))
+				success = FALSE;
+			if (fclose(fp) != 0)
+				success = FALSE;
+			if (!success && !g_atomic_int_get(&job->cancelled))
+				job->merge_error = g_strdup(_("write error"));
+		}
+		g_strfreev(files);
+	}
+
+	if (error)
+	{
+		job->merge_error = g_strdup(error->message);
+		g_error_free(error);
+	}
+
+	g_free(contents);
+	if (new_map)
+		g_mapped_file_unref(new_map);
+	if (old_map)
+		g_mapped_file_unref(old_map);
+
+	g_idle_add(on_merge_finished, job);
+	return NULL;
+}
+
+static void on_ctags_output(GString *string, GIOCondition condition, gpointer data)
+{
+	GenerateJob *job = data;
+
+	if (!g_atomic_int_get(&job->cancelled) && (condition & (G_IO_IN | G_IO_PRI)))
+	{
+		gchar *line = utils_get_utf8_from_locale(string->str);
+
+		g_strchomp(line);
+		if (*line)
+			msgwin_msg_add(COLOR_BLACK, -1, NULL, "%s", line);
+		g_free(line);
+	}
+}
+
+static void on_ctags_exit(G_GNUC_UNUSED GPid pid, gint status, gpointer data)
+{
+	GenerateJob *job = data;
+
+	job->pid = 0;
+
+	if (g_atomic_int_get(&job->cancelled))
+		generate_job_free(job);
+	else if (!SPAWN_WIFEXITED(status) || SPAWN_WEXITSTATUS(status) != 0)
+	{
+		msgwin_msg_add(COLOR_RED, -1, NULL, _("Tag generation failed (exit status %d)"),
+			SPAWN_WIFEXITED(status) ? SPAWN_WEXITSTATUS(status) : status);
+		generate_job_free(job);
+	}
+	else if (job->incremental)
+	{
+		msgwin_msg_add(COLOR_BLUE, -1, NULL, _("Merging tags..."));
+		job->thread = g_thread_new("geanyctags-merge", merge_thread, job);
+	}
+	else if (install_tags_file(job))
+		index_tags_file(job);
+	else
+		generate_job_free(job);
+}
+
+static void spawn_cmd(GenerateJob *job, const gchar *cmd, const gchar *dir)
 {
 	GError *error = NULL;
 	gchar **argv = NULL;
 	gchar *working_dir;
 	gchar *utf8_working_dir;
 	gchar *utf8_cmd_string;
-	gchar *out;
-	gint exitcode;
-	gboolean success;
-	GString *output;
 
 #ifndef G_OS_WIN32
 	/* run within shell so we can use pipes */
@@ -139,34 +513,30 @@ static void spawn_cmd(const gchar *cmd, const gchar *dir)
 	g_free(utf8_working_dir);
 	g_free(utf8_cmd_string);
 
-	output = g_string_new(NULL);
+	/* ctags reports its progress and totals on stderr; both are line buffered */
 #ifndef G_OS_WIN32
-	success = spawn_sync(working_dir, NULL, argv, NULL,
-			NULL, NULL, output, &exitcode, &error);
+	if (spawn_with_callbacks(working_dir, NULL, argv, NULL,
+		SPAWN_STDOUT_RECURSIVE | SPAWN_STDERR_RECURSIVE, NULL, NULL,
+		on_ctags_output, job, 0, on_ctags_output, job, 0, on_ctags_exit, job, &job->pid, &error))
 #else
-	success = spawn_sync(working_dir, cmd, NULL, NULL,
-			NULL, output, NULL, &exitcode, &error);
+	if (spawn_with_callbacks(working_dir, cmd, NULL, NULL,
+		SPAWN_STDOUT_RECURSIVE | SPAWN_STDERR_RECURSIVE, NULL, NULL,
+		on_ctags_output, job, 0, on_ctags_output, job, 0, on_ctags_exit, job, &job->pid, &error))
 #endif
-	out = g_string_free(output, FALSE);
-	if (!success || exitcode != 0)
 	{
-		if (error != NULL)
-		{
-			msgwin_msg_add(COLOR_RED, -1, NULL, _("Process execution failed (%s)"), error->message);
-			g_error_free(error);
-		}
-		msgwin_msg_add(COLOR_RED, -1, NULL, "%s", out);
+		s_job = job;
 	}
 	else
 	{
-		msgwin_msg_add(COLOR_BLACK, -1, NULL, "%s", out);
+		msgwin_msg_add(COLOR_RED, -1, NULL, _("Process execution failed (%s)"), error->message);
+		g_error_free(error);
+		generate_job_free(job);
 	}
 
 	/* cppcheck-suppress mismatchAllocDealloc symbolName=argv
 	 * argv is built manually, but is a valid GStrv */
 	g_strfreev(argv);
 	g_free(working_dir);
-	g_free(out);
 }
 
 static gchar *get_tags_filename(void)
@@ -219,25 +589,44 @@ static gchar *get_base_path(void)
 }
 
 
-static void
-on_generate_tags(GtkMenuItem *menuitem, gpointer user_data)
+static void generate_tags(gboolean incremental)
 {
 	GeanyProject *prj;
 
 	prj = geany_data->app->project;
-	if (prj)
+	if (s_job)
+		msgwin_status_add(_("Tag generation is already running"));
+	else if (prj)
 	{
+		GenerateJob *job = g_new0(GenerateJob, 1);
 		gchar *cmd;
-		gchar *tag_filename;
 		gchar *base_path;
 
-		tag_filename = get_tags_filename();
+		job->tag_filename = get_tags_filename();
+		job->tmp_filename = g_strconcat(job->tag_filename, ".tmp", NULL);
+		job->start_time = time(NULL);
 
 #ifndef G_OS_WIN32
 		gchar *find_string = generate_find_string(prj);
-		cmd = g_strconcat(find_string,
-			" | ctags --totals --fields=fKsSt --extra=-fq --c-kinds=+p --sort=foldcase --excmd=number -L - -f '",
-			tag_filename, "'", NULL);
+
+		/* without an existing tags file there is nothing to update */
+		job->incremental = incremental && g_file_test(job->tag_filename, G_FILE_TEST_IS_REGULAR);
+		if (job->incremental)
+		{
+			/* the tags file mtime is set to the start of the previous run */
+			job->new_filename = g_strconcat(job->tag_filename, ".new", NULL);
+			job->files_filename = g_strconcat(job->tag_filename, ".files", NULL);
+			cmd = g_strconcat(find_string, " -newer '", job->tag_filename, "' > '",
+				job->files_filename, "' && ",
+				"ctags --totals --fields=fKsSt --extra=-fq --c-kinds=+p --sort=foldcase --excmd=number -L '",
+				job->files_filename, "' -f '", job->new_filename, "'", NULL);
+		}
+		else
+		{
+			cmd = g_strconcat(find_string,
+				" | ctags --totals --fields=fKsSt --extra=-fq --c-kinds=+p --sort=foldcase --excmd=number -L - -f '",
+				job->tmp_filename, "'", NULL);
+		}
 		g_free(find_string);
 #else
 		/* We don't have find and | on windows, generate tags for all files in the project (-R recursively) */
@@ -245,21 +634,33 @@ on_generate_tags(GtkMenuItem *menuitem, gpointer user_data)
 		/* Unfortunately, there's a bug in ctags - when run with -R, the first line is
 		 * empty, ctags doesn't recognize the tags file as a valid ctags file and
 		 * refuses to overwrite it. Therefore, we need to delete the tags file manually. */
-		g_unlink(tag_filename);
+		g_unlink(job->tmp_filename);
 
 		cmd = g_strconcat("ctags.exe -R --totals --fields=fKsSt --extra=-fq --c-kinds=+p --sort=foldcase --excmd=number -f \"",
-			tag_filename, "\"", NULL);
+			job->tmp_filename, "\"", NULL);
 #endif
 
 		base_path = get_base_path();
-		spawn_cmd(cmd, base_path);
+		job->base_path = utils_get_locale_from_utf8(base_path);
+		spawn_cmd(job, cmd, base_path);
 
 		g_free(cmd);
-		g_free(tag_filename);
 		g_free(base_path);
 	}
 }
 
+static void
+on_generate_tags(GtkMenuItem *menuitem, gpointer user_data)
+{
+	generate_tags(FALSE);
+}
+
+static void
+on_update_tags(GtkMenuItem *menuitem, gpointer user_data)
+{
+	generate_tags(TRUE);
+}
+
 static void show_entry(tagEntry *entry)
 {
 	const gchar *kind;
@@ -370,33 +771,6 @@ typedef enum
 	MATCH_PATTERN
 } MatchType;
 
-static gboolean find_first(tagFile *tf, tagEntry *entry, const gchar *name, MatchType match_type)
-{
-	gboolean ret;
-
-	if (match_type == MATCH_PATTERN)
-		ret = tagsFirst(tf, entry) == TagSuccess;
-	else
-	{
-		int options = TAG_IGNORECASE;
-
-		options |= match_type == MATCH_PREFIX ? TAG_PARTIALMATCH : TAG_FULLMATCH;
-		ret = tagsFind(tf, entry, name, options) == TagSuccess;
-	}
-	return ret;
-}
-
-static gboolean find_next(tagFile *tf, tagEntry *entry, MatchType match_type)
-{
-	gboolean ret;
-
-	if (match_type == MATCH_PATTERN)
-		ret = tagsNext(tf, entry) == TagSuccess;
-	else
-		ret = tagsFindNext(tf, entry) == TagSuccess;
-	return ret;
-}
-
 #if ! GLIB_CHECK_VERSION(2, 70, 0)
 # define g_pattern_spec_match_string g_pattern_match_string
 #endif
@@ -428,15 +802,66 @@ static gboolean filter_tag(tagEntry *entry, GPatternSpec *name, gboolean declara
 	return filter;
 }
 
+/* the tags file stays mapped until it changes or the project is closed */
+static TagCache *get_tag_cache(void)
+{
+	gchar *tag_filename = get_tags_filename();
+
+	if (s_tag_cache && (g_strcmp0(tag_cache_get_filename(s_tag_cache), tag_filename) != 0 ||
+		!tag_cache_is_current(s_tag_cache)))
+	{
+		close_tag_cache();
+	}
+
+	if (!s_tag_cache && tag_filename)
+	{
+		s_tag_cache = tag_cache_open(tag_filename);
+
+		/* tags files which weren't generated here may have no index yet */
+		if (s_tag_cache && !s_job && !tag_cache_has_index(s_tag_cache))
+		{
+			GenerateJob *job = g_new0(GenerateJob, 1);
+
+			job->tag_filename = g_strdup(tag_filename);
+			s_job = job;
+			index_tags_file(job);
+		}
+	}
+
+	g_free(tag_filename);
+	return s_tag_cache;
+}
+
+typedef struct
+{
+	GPatternSpec *name_pat;
+	gboolean declaration;
+	gboolean case_sensitive;
+	const gchar *base_path;
+	gchar *path;
+	gint num;
+	unsigned long last_line_number;
+} FindData;
+
+static void on_tag_found(tagEntry *entry, gpointer user_data)
+{
+	FindData *data = user_data;
+
+	if (!filter_tag(entry, data->name_pat, data->declaration, data->case_sensitive))
+	{
+		if (!data->path)
+			data->path = g_build_filename(data->base_path, entry->file, NULL);
+		show_entry(entry);
+		data->last_line_number = entry->address.lineNumber;
+		data->num++;
+	}
+}
+
 static void find_tags(const gchar *name, gboolean declaration, gboolean case_sensitive, MatchType match_type)
 {
-	tagFile *tf;
+	TagCache *cache;
 	GeanyProject *prj;
-	gchar *tag_filename = NULL;
 	gchar *base_path;
-	tagEntry entry;
-	tagFileInfo info;
-	int last_line_number = 0;
 
 	prj = geany_data->app->project;
 	if (!prj)
@@ -446,67 +871,43 @@ static void find_tags(const gchar *name, gboolean declaration, gboolean case_sen
 	msgwin_clear_tab(MSG_MESSAGE);
 	msgwin_set_messages_dir(base_path);
 
-	tag_filename = get_tags_filename();
-	tf = tagsOpen(tag_filename, &info);
+	cache = get_tag_cache();
 
-	if (tf)
+	if (cache)
 	{
-		if (find_first(tf, &entry, name, match_type))
-		{
-			GPatternSpec *name_pat;
-			gchar *name_case;
-			gchar *path = NULL; 
-			gint num = 0;
+		FindData data = {NULL, declaration, case_sensitive, base_path, NULL, 0, 0};
+		gchar *name_case;
 
-			if (case_sensitive)
-				name_case = g_strdup(name);
-			else
-				name_case = g_utf8_strdown(name, -1);
+		if (case_sensitive)
+			name_case = g_strdup(name);
+		else
+			name_case = g_utf8_strdown(name, -1);
 
-			SETPTR(name_case, g_strconcat("*", name_case, "*", NULL));
-			name_pat = g_pattern_spec_new(name_case);
+		SETPTR(name_case, g_strconcat("*", name_case, "*", NULL));
+		data.name_pat = g_pattern_spec_new(name_case);
 
-			if (!filter_tag(&entry, name_pat, declaration, case_sensitive))
-			{
-				path = g_build_filename(base_path, entry.file, NULL);
-				show_entry(&entry);
-				last_line_number = entry.address.lineNumber;
-				num++;
-			}
-			
-			while (find_next(tf, &entry, match_type))
-			{
-				if (!filter_tag(&entry, name_pat, declaration, case_sensitive))
-				{
-					if (!path)
-						path = g_build_filename(base_path, entry.file, NULL);
-					show_entry(&entry);
-					last_line_number = entry.address.lineNumber;
-					num++;
-				}
-			}
-			
-			if (num == 1)
+		if (match_type == MATCH_PATTERN)
+			tag_cache_find_pattern(cache, name_case, on_tag_found, &data);
+		else
+			tag_cache_find(cache, name, match_type == MATCH_PREFIX, on_tag_found, &data);
+
+		if (data.num == 1)
+		{
+			GeanyDocument *doc = document_open_file(data.path, FALSE, NULL, NULL);
+			if (doc != NULL)
 			{
-				GeanyDocument *doc = document_open_file(path, FALSE, NULL, NULL);
-				if (doc != NULL)
-				{
-					navqueue_goto_line(document_get_current(), doc, last_line_number);
-					gtk_widget_grab_focus(GTK_WIDGET(doc->editor->sci));
-				}
+				navqueue_goto_line(document_get_current(), doc, data.last_line_number);
+				gtk_widget_grab_focus(GTK_WIDGET(doc->editor->sci));
 			}
-
-			g_pattern_spec_free(name_pat);
-			g_free(name_case);
-			g_free(path);
 		}
 
-		tagsClose(tf);
+		g_pattern_spec_free(data.name_pat);
+		g_free(name_case);
+		g_free(data.path);
 	}
 
 	msgwin_switch_tab(MSG_MESSAGE, TRUE);
 
-	g_free(tag_filename);
 	g_free(base_path);
 }
 
@@ -642,6 +1043,9 @@ static gboolean kb_callback(guint key_id)
 		case KB_GENERATE_TAGS:
 			on_generate_tags(NULL, NULL);
 			return TRUE;
+		case KB_UPDATE_TAGS:
+			on_update_tags(NULL, NULL);
+			return TRUE;
 	}
 	return FALSE;
 }
@@ -653,6 +1057,9 @@ static gboolean plugin_geanyctags_init(GeanyPlugin *plugin, G_GNUC_UNUSED gpoint
 	geany_plugin = plugin;
 	geany_data = plugin->geany_data;
 
+	/* a running tag generation finishes through callbacks into this module */
+	plugin_module_make_resident(geany_plugin);
+
 	key_group = plugin_set_key_group(geany_plugin, "GeanyCtags", KB_COUNT, kb_callback);
 
 	s_context_sep_item = gtk_separator_menu_item_new();
@@ -680,6 +1087,13 @@ static gboolean plugin_geanyctags_init(GeanyPlugin *plugin, G_GNUC_UNUSED gpoint
 	keybindings_set_item(key_group, KB_GENERATE_TAGS, NULL,
 		0, 0, "generate_tags", _("Generate tags"), s_gt_item);
 
+	s_ut_item = gtk_menu_item_new_with_mnemonic(_("Update tags"));
+	gtk_widget_show(s_ut_item);
+	gtk_container_add(GTK_CONTAINER(geany->main_widgets->project_menu), s_ut_item);
+	g_signal_connect((gpointer) s_ut_item, "activate", G_CALLBACK(on_update_tags), NULL);
+	keybindings_set_item(key_group, KB_UPDATE_TAGS, NULL,
+		0, 0, "update_tags", _("Update tags"), s_ut_item);
+
 	s_ft_item = gtk_menu_item_new_with_mnemonic(_("Find tag..."));
 	gtk_widget_show(s_ft_item);
 	gtk_container_add(GTK_CONTAINER(geany->main_widgets->project_menu), s_ft_item);
@@ -700,11 +1114,23 @@ static void plugin_geanyctags_cleanup(G_GNUC_UNUSED GeanyPlugin *plugin, G_GNUC_
 
 	gtk_widget_destroy(s_ft_item);
 	gtk_widget_destroy(s_gt_item);
+	gtk_widget_destroy(s_ut_item);
 	gtk_widget_destroy(s_sep_item);
 
 	if (s_ft_dialog.widget)
 		gtk_widget_destroy(s_ft_dialog.widget);
 	s_ft_dialog.widget = NULL;
+
+	if (s_job)
+	{
+		/* the job frees itself once ctags or the merge thread is done */
+		g_atomic_int_set(&s_job->cancelled, TRUE);
+		if (s_job->pid)
+			spawn_kill_process(s_job->pid, NULL);
+		s_job = NULL;
+	}
+
+	close_tag_cache();
 }
 
 
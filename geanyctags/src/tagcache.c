@@ -0,0 +1,800 @@
+/*
+ *	  Copyright 2026 The Geany-Plugins contributors
+ *
+ *	  This program is free software; you can redistribute it and/or modify
+ *	  it under the terms of the GNU General Public License as published by
+ *	  the Free Software Foundation; either version 2 of the License, or
+ *	  (at your option) any later version.
+ *
+ *	  This program is distributed in the hope that it will be useful,
+ *	  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	  GNU General Public License for more details.
+ *
+ *	  You should have received a copy of the GNU General Public License
+ *	  along with this program; if not, write to the Free Software
+ *	  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "tagcache.h"
+
+
+#define INDEX_MAGIC 0x58444954	/* "TIDX" */
+#define INDEX_VERSION 2
+#define INDEX_SUFFIX ".idx"
+
+#define TRIGRAM(s) (((guint32) (guchar) (s)[0] << 16) | ((guint32) (guchar) (s)[1] << 8) | \
+	(guint32) (guchar) (s)[2])
+
+/* The index file is a header followed by the offsets of the name groups
+ * (runs of lines with the same lowercase name) in the tags file, the sorted
+ * trigrams with the position of their first posting, and the postings,
+ * which are group numbers in ascending order. */
+typedef struct
+{
+	guint32 magic;
+	guint32 version;
+	guint32 n_groups;
+	guint32 n_trigrams;
+	guint64 tags_size;
+	gint64 tags_mtime;	/* in microseconds */
+	guint64 tags_inode;
+} IndexHeader;
+
+typedef struct
+{
+	guint32 key;
+	guint32 start;
+} IndexTrigram;
+
+struct TagCache
+{
+	gchar *filename;
+	GMappedFile *map;
+	const gchar *data;
+	gsize size;
+	gint64 mtime;
+	guint64 inode;
+	gsize entries;
+	gboolean foldsorted;
+
+	GMappedFile *index_map;
+	const IndexHeader *header;
+	const guint64 *groups;
+	const IndexTrigram *trigrams;
+	const guint32 *postings;
+
+	gchar *line;
+	GArray *fields;
+};
+
+
+static gsize line_end(TagCache *cache, gsize pos)
+{
+	const gchar *p = memchr(cache->data + pos, '\n', cache->size - pos);
+
+	return p ? (gsize) (p - cache->data) : cache->size;
+}
+
+static gsize next_line(TagCache *cache, gsize pos)
+{
+	pos = line_end(cache, pos);
+	return pos < cache->size ? pos + 1 : pos;
+}
+
+static gboolean line_has_prefix(TagCache *cache, gsize pos, const gchar *prefix)
+{
+	gsize len = strlen(prefix);
+
+	return cache->size - pos >= len && memcmp(cache->data + pos, prefix, len) == 0;
+}
+
+static gsize name_length(TagCache *cache, gsize pos)
+{
+	const gchar *p = cache->data + pos;
+	const gchar *end = cache->data + cache->size;
+
+	while (p < end && *p != '\t' && *p != '\n' && *p != '\r')
+		p++;
+	return p - (cache->data + pos);
+}
+
+
+/* Gets what tells whether the tags file changed. Whole seconds and the size
+ * miss a rewrite within the same second, hence the sub-second modification
+ * time and the inode, which changes when the file is replaced by a new one. */
+static gboolean query_file_stamp(const gchar *filename, guint64 *size, gint64 *mtime, guint64 *inode)
+{
+	GFile *file = g_file_new_for_path(filename);
+	GFileInfo *info;
+
+	info = g_file_query_info(file,
+		G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+		G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+		G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+		G_FILE_ATTRIBUTE_UNIX_INODE,
+		G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	g_object_unref(file);
+	if (!info)
+		return FALSE;
+
+	*size = g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_STANDARD_SIZE);
+	*mtime = (gint64) g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+		g_file_info_get_attribute_uint32(info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	/* not available on all platforms, it is 0 then */
+	*inode = g_file_info_get_attribute_uint64(info, G_FILE_ATTRIBUTE_UNIX_INODE);
+	g_object_unref(info);
+
+	return TRUE;
+}
+
+
+TagCache *tag_cache_open(const gchar *filename)
+{
+	TagCache *cache;
+	GMappedFile *map;
+	guint64 size, inode;
+	gint64 mtime;
+	gsize pos = 0;
+
+	if (!query_file_stamp(filename, &size, &mtime, &inode))
+		return NULL;
+
+	map = g_mapped_file_new(filename, FALSE, NULL);
+	if (!map)
+		return NULL;
+
+	cache = g_new0(TagCache, 1);
+	cache->filename = g_strdup(filename);
+	cache->map = map;
+	cache->data = g_mapped_file_get_contents(map);
+	cache->size = g_mapped_file_get_length(map);
+	cache->mtime = mtime;
+	cache->inode = inode;
+	cache->fields = g_array_new(FALSE, FALSE, sizeof(tagExtensionField));
+
+	/* pseudo tags precede the tags */
+	while (pos < cache->size && line_has_prefix(cache, pos, "!_"))
+	{
+		if (line_has_prefix(cache, pos, "!_TAG_FILE_SORTED\t"))
+			cache->foldsorted = line_has_prefix(cache, pos, "!_TAG_FILE_SORTED\t2");
+		pos = next_line(cache, pos);
+	}
+	cache->entries = pos;
+
+	return cache;
+}
+
+
+static void free_index(TagCache *cache)
+{
+	if (cache->index_map)
+		g_mapped_file_unref(cache->index_map);
+	cache->index_map = NULL;
+	cache->header = NULL;
+}
+
+
+void tag_cache_free(TagCache *cache)
+{
+	if (!cache)
+		return;
+
+	free_index(cache);
+	g_mapped_file_unref(cache->map);
+	g_array_free(cache->fields, TRUE);
+	g_free(cache->line);
+	g_free(cache->filename);
+	g_free(cache);
+}
+
+
+const gchar *tag_cache_get_filename(TagCache *cache)
+{
+	return cache->filename;
+}
+
+
+gboolean tag_cache_is_current(TagCache *cache)
+{
+	guint64 size, inode;
+	gint64 mtime;
+
+	return query_file_stamp(cache->filename, &size, &mtime, &inode) &&
+		size == cache->size && mtime == cache->mtime && inode == cache->inode;
+}
+
+
+static void unescape_value(gchar *s)
+{
+	gchar *q = s;
+
+	for (; *s; s++, q++)
+	{
+		if (*s == '\\' && (s[1] == 't' || s[1] == 'n' || s[1] == 'r' || s[1] == '\\'))
+		{
+			s++;
+			*q = *s == 't' ? '\t' : *s == 'n' ? '\n' : *s == 'r' ? '\r' : '\\';
+		}
+		else
+			*q = *s;
+	}
+	*q = '\0';
+}
+
+
+/* fills the entry like readtags does, the strings point into cache->line */
+static gboolean parse_line(TagCache *cache, gsize pos, tagEntry *entry)
+{
+	gsize end = line_end(cache, pos);
+	gchar *p, *tab;
+
+	g_free(cache->line);
+	if (end > pos && cache->data[end - 1] == '\r')
+		end--;
+	cache->line = g_strndup(cache->data + pos, end - pos);
+	g_array_set_size(cache->fields, 0);
+	memset(entry, 0, sizeof(*entry));
+
+	entry->name = cache->line;
+	tab = strchr(cache->line, '\t');
+	if (!tab)
+		return FALSE;
+	*tab = '\0';
+
+	entry->file = p = tab + 1;
+	tab = strchr(p, '\t');
+	if (!tab)
+		return FALSE;
+	*tab = '\0';
+
+	p = tab + 1;
+	entry->address.pattern = p;
+	if (g_ascii_isdigit(*p))
+		entry->address.lineNumber = strtoul(p, &p, 10);
+	else if (*p == '/' || *p == '?')
+	{
+		gchar delimiter = *p;
+
+		for (p++; *p && *p != delimiter; p++)
+		{
+			if (*p == '\\' && p[1])
+				p++;
+		}
+		if (*p)
+			p++;
+	}
+
+	if (strncmp(p, ";\"", 2) != 0)
+		return TRUE;
+	*p = '\0';
+	p += 2;
+
+	for (p = *p == '\t' ? p + 1 : NULL; p; p = tab)
+	{
+		gchar *colon;
+
+		tab = strchr(p, '\t');
+		if (tab)
+			*tab++ = '\0';
+
+		colon = strchr(p, ':');
+		if (!colon)
+			entry->kind = p;
+		else
+		{
+			*colon = '\0';
+			unescape_value(colon + 1);
+
+			if (strcmp(p, "kind") == 0)
+				entry->kind = colon + 1;
+			else if (strcmp(p, "file") == 0)
+				entry->fileScope = 1;
+			else if (strcmp(p, "line") == 0)
+				entry->address.lineNumber = strtoul(colon + 1, NULL, 10);
+			else
+			{
+				tagExtensionField field = {p, colon + 1};
+
+				g_array_append_val(cache->fields, field);
+			}
+		}
+	}
+
+	entry->fields.count = cache->fields->len;
+	entry->fields.list = (tagExtensionField *) cache->fields->data;
+	return TRUE;
+}
+
+
+static void report_lines(TagCache *cache, gsize pos, gsize end, TagCacheFunc func,
+	gpointer user_data)
+{
+	for (; pos < end; pos = next_line(cache, pos))
+	{
+		tagEntry entry;
+
+		if (parse_line(cache, pos, &entry))
+			func(&entry, user_data);
+	}
+}
+
+
+/* compares like readtags does for foldcase sorted files */
+static gint compare_name(TagCache *cache, gsize pos, const gchar *name, gsize len,
+	gboolean prefix)
+{
+	gsize name_len = name_length(cache, pos);
+	const guchar *p = (const guchar *) cache->data + pos;
+	gsize i;
+
+	for (i = 0; i < len; i++)
+	{
+		gint c = i < name_len ? g_ascii_toupper(p[i]) : 0;
+		gint diff = c - g_ascii_toupper((guchar) name[i]);
+
+		if (diff != 0)
+			return diff;
+	}
+
+	return prefix || name_len == len ? 0 : 1;
+}
+
+
+void tag_cache_find(TagCache *cache, const gchar *name, gboolean prefix,
+	TagCacheFunc func, gpointer user_data)
+{
+	gsize len = strlen(name);
+	gsize lo = cache->entries;
+	gsize hi = cache->size;
+
+	if (!cache->foldsorted)
+	{
+		for (; lo < hi; lo = next_line(cache, lo))
+		{
+			if (compare_name(cache, lo, name, len, prefix) == 0)
+				report_lines(cache, lo, lo + 1, func, user_data);
+		}
+		return;
+	}
+
+	/* binary search for the first matching line; lo and hi are line starts */
+	while (lo < hi)
+	{
+		gsize mid = lo + (hi - lo) / 2;
+
+		mid = mid > lo ? next_line(cache, mid - 1) : lo;
+		if (mid >= hi)
+			mid = lo;
+
+		if (compare_name(cache, mid, name, len, prefix) < 0)
+			lo = next_line(cache, mid);
+		else
+			hi = mid;
+	}
+
+	for (hi = lo; hi < cache->size && compare_name(cache, hi, name, len, prefix) == 0;
+		hi = next_line(cache, hi));
+	report_lines(cache, lo, hi, func, user_data);
+}
+
+
+static gchar *fold_name(const gchar *name, gsize len)
+{
+	gsize i;
+
+	for (i = 0; i < len; i++)
+	{
+		if ((guchar) name[i] >= 0x80)
+		{
+			if (g_utf8_validate(name, len, NULL))
+				return g_utf8_strdown(name, len);
+			break;
+		}
+	}
+
+	return g_ascii_strdown(name, len);
+}
+
+
+static gint compare_keys(gconstpointer a, gconstpointer b)
+{
+	guint32 key_a = *(const guint32 *) a;
+	guint32 key_b = *(const guint32 *) b;
+
+	return key_a < key_b ? -1 : key_a > key_b;
+}
+
+
+/* appends the distinct trigrams of the folded name, in ascending order */
+static void name_trigrams(const gchar *folded, GArray *keys)
+{
+	gsize len = strlen(folded);
+	guint start = keys->len;
+	guint i, n;
+
+	for (i = 0; i + 2 < len; i++)
+	{
+		guint32 key = TRIGRAM(folded + i);
+
+		g_array_append_val(keys, key);
+	}
+
+	if (keys->len - start < 2)
+		return;
+
+	qsort(&g_array_index(keys, guint32, start), keys->len - start, sizeof(guint32),
+		(int (*)(const void *, const void *)) compare_keys);
+
+	for (i = n = start + 1; i < keys->len; i++)
+	{
+		if (g_array_index(keys, guint32, i) != g_array_index(keys, guint32, n - 1))
+			g_array_index(keys, guint32, n++) = g_array_index(keys, guint32, i);
+	}
+	g_array_set_size(keys, n);
+}
+
+
+/* calls func for the first line of each name group, with the folded name */
+static void foreach_group(TagCache *cache, void (*func)(TagCache *cache, gsize pos,
+	const gchar *folded, gpointer user_data), gpointer user_data)
+{
+	gchar *group = NULL;
+	gsize pos;
+
+	for (pos = cache->entries; pos < cache->size; pos = next_line(cache, pos))
+	{
+		gchar *folded = fold_name(cache->data + pos, name_length(cache, pos));
+
+		if (!group || strcmp(folded, group) != 0)
+		{
+			func(cache, pos, folded, user_data);
+			g_free(group);
+			group = folded;
+		}
+		else
+			g_free(folded);
+	}
+
+	g_free(group);
+}
+
+
+typedef struct
+{
+	GArray *groups;
+	GHashTable *counts;
+	GArray *keys;
+	guint32 *postings;
+	guint32 *cursors;
+	guint32 group;
+} IndexBuild;
+
+
+static void count_group(TagCache *cache, gsize pos, const gchar *folded, gpointer user_data)
+{
+	IndexBuild *build = user_data;
+	guint64 offset = pos;
+	guint i;
+
+	g_array_append_val(build->groups, offset);
+	g_array_set_size(build->keys, 0);
+	name_trigrams(folded, build->keys);
+
+	for (i = 0; i < build->keys->len; i++)
+	{
+		gpointer key = GUINT_TO_POINTER(g_array_index(build->keys, guint32, i));
+		guint count = GPOINTER_TO_UINT(g_hash_table_lookup(build->counts, key));
+
+		g_hash_table_insert(build->counts, key, GUINT_TO_POINTER(count + 1));
+	}
+}
+
+
+static void fill_group(TagCache *cache, gsize pos, const gchar *folded, gpointer user_data)
+{
+	IndexBuild *build = user_data;
+	guint i;
+
+	g_array_set_size(build->keys, 0);
+	name_trigrams(folded, build->keys);
+
+	for (i = 0; i < build->keys->len; i++)
+	{
+		gpointer key = GUINT_TO_POINTER(g_array_index(build->keys, guint32, i));
+		guint slot = GPOINTER_TO_UINT(g_hash_table_lookup(build->counts, key));
+
+		build->postings[build->cursors[slot]++] = build->group;
+	}
+
+	build->group++;
+}
+
+
+static gsize index_size(const IndexHeader *header, gsize n_postings)
+{
+	return sizeof(IndexHeader) + header->n_groups * sizeof(guint64) +
+		(header->n_trigrams + 1) * sizeof(IndexTrigram) + n_postings * sizeof(guint32);
+}
+
+
+static void set_index_pointers(TagCache *cache, gchar *data)
+{
+	cache->header = (const IndexHeader *) data;
+	cache->groups = (const guint64 *) (data + sizeof(IndexHeader));
+	cache->trigrams = (const IndexTrigram *) (cache->groups + cache->header->n_groups);
+	cache->postings = (const guint32 *) (cache->trigrams + cache->header->n_trigrams + 1);
+}
+
+
+static gboolean load_index(TagCache *cache, const gchar *index_filename)
+{
+	GMappedFile *map = g_mapped_file_new(index_filename, FALSE, NULL);
+	const IndexHeader *header;
+	gsize length;
+
+	if (!map)
+		return FALSE;
+
+	header = (const IndexHeader *) g_mapped_file_get_contents(map);
+	length = g_mapped_file_get_length(map);
+
+	if (length >= sizeof(IndexHeader) && header->magic == INDEX_MAGIC &&
+		header->version == INDEX_VERSION && header->tags_size == cache->size &&
+		header->tags_mtime == cache->mtime && header->tags_inode == cache->inode &&
+		length >= index_size(header, 0))
+	{
+		const IndexTrigram *trigrams = (const IndexTrigram *) ((const gchar *) header +
+			sizeof(IndexHeader) + header->n_groups * sizeof(guint64));
+
+		if (length == index_size(header, trigrams[header->n_trigrams].start))
+		{
+			cache->index_map = map;
+			set_index_pointers(cache, g_mapped_file_get_contents(map));
+			return TRUE;
+		}
+	}
+
+	g_mapped_file_unref(map);
+	return FALSE;
+}
+
+
+static gboolean write_index(TagCache *cache, const gchar *index_filename)
+{
+	IndexBuild build = {NULL, NULL, NULL, NULL, NULL, 0};
+	IndexHeader header;
+	GArray *trigram_keys;
+	IndexTrigram *trigrams;
+	gchar *data;
+	gsize n_postings = 0;
+	gboolean success;
+	guint i;
+
+	build.groups = g_array_new(FALSE, FALSE, sizeof(guint64));
+	build.counts = g_hash_table_new(g_direct_hash, g_direct_equal);
+	build.keys = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+	/* first pass: the groups and the number of postings of each trigram */
+	foreach_group(cache, count_group, &build);
+
+	trigram_keys = g_array_sized_new(FALSE, FALSE, sizeof(guint32),
+		g_hash_table_size(build.counts));
+	{
+		GHashTableIter iter;
+		gpointer key;
+
+		g_hash_table_iter_init(&iter, build.counts);
+		while (g_hash_table_iter_next(&iter, &key, NULL))
+		{
+			guint32 k = GPOINTER_TO_UINT(key);
+
+			g_array_append_val(trigram_keys, k);
+		}
+	}
+	g_array_sort(trigram_keys, compare_keys);
+
+	header.magic = INDEX_MAGIC;
+	header.version = INDEX_VERSION;
+	header.n_groups = build.groups->len;
+	header.n_trigrams = trigram_keys->len;
+	header.tags_size = cache->size;
+	header.tags_mtime = cache->mtime;
+	header.tags_inode = cache->inode;
+
+	for (i = 0; i < trigram_keys->len; i++)
+	{
+		gpointer key = GUINT_TO_POINTER(g_array_index(trigram_keys, guint32, i));
+
+		n_postings += GPOINTER_TO_UINT(g_hash_table_lookup(build.counts, key));
+	}
+
+	data = g_malloc(index_size(&header, n_postings));
+	memcpy(data, &header, sizeof(IndexHeader));
+	memcpy(data + sizeof(IndexHeader), build.groups->data, header.n_groups * sizeof(guint64));
+	trigrams = (IndexTrigram *) (data + sizeof(IndexHeader) + header.n_groups * sizeof(guint64));
+	build.postings = (guint32 *) (trigrams + header.n_trigrams + 1);
+	build.cursors = g_new(guint32, header.n_trigrams);
+
+	/* the counts table now maps each trigram to its slot */
+	n_postings = 0;
+	for (i = 0; i < trigram_keys->len; i++)
+	{
+		gpointer key = GUINT_TO_POINTER(g_array_index(trigram_keys, guint32, i));
+
+		trigrams[i].key = g_array_index(trigram_keys, guint32, i);
+		trigrams[i].start = build.cursors[i] = n_postings;
+		n_postings += GPOINTER_TO_UINT(g_hash_table_lookup(build.counts, key));
+		g_hash_table_insert(build.counts, key, GUINT_TO_POINTER(i));
+	}
+	trigrams[i].key = G_MAXUINT32;
+	trigrams[i].start = n_postings;
+
+	/* second pass: the postings, in ascending group order */
+	foreach_group(cache, fill_group, &build);
+
+	g_free(build.cursors);
+	g_array_free(trigram_keys, TRUE);
+	g_array_free(build.keys, TRUE);
+	g_hash_table_destroy(build.counts);
+	g_array_free(build.groups, TRUE);
+
+	success = g_file_set_contents(index_filename, data, index_size(&header, n_postings), NULL);
+	g_free(data);
+	return success;
+}
+
+
+gboolean tag_cache_has_index(TagCache *cache)
+{
+	if (!cache->header)
+	{
+		gchar *index_filename = g_strconcat(cache->filename, INDEX_SUFFIX, NULL);
+
+		load_index(cache, index_filename);
+		g_free(index_filename);
+	}
+
+	return cache->header != NULL;
+}
+
+
+gboolean tag_cache_update_index(const gchar *filename)
+{
+	TagCache *cache = tag_cache_open(filename);
+	gboolean success = FALSE;
+
+	if (cache)
+	{
+		gchar *index_filename = g_strconcat(filename, INDEX_SUFFIX, NULL);
+
+		success = load_index(cache, index_filename) || write_index(cache, index_filename);
+		g_free(index_filename);
+		tag_cache_free(cache);
+	}
+
+	return success;
+}
+
+
+static const IndexTrigram *find_trigram(TagCache *cache, guint32 key)
+{
+	guint lo = 0, hi = cache->header->n_trigrams;
+
+	while (lo < hi)
+	{
+		guint mid = (lo + hi) / 2;
+
+		if (cache->trigrams[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo < cache->header->n_trigrams && cache->trigrams[lo].key == key ?
+		cache->trigrams + lo : NULL;
+}
+
+
+static gint compare_postings_length(gconstpointer a, gconstpointer b)
+{
+	const IndexTrigram *ta = *(const IndexTrigram * const *) a;
+	const IndexTrigram *tb = *(const IndexTrigram * const *) b;
+	guint32 len_a = ta[1].start - ta->start;
+	guint32 len_b = tb[1].start - tb->start;
+
+	return len_a < len_b ? -1 : len_a > len_b;
+}
+
+
+static gboolean postings_contain(TagCache *cache, const IndexTrigram *trigram, guint32 group)
+{
+	guint32 lo = trigram->start, hi = trigram[1].start;
+
+	while (lo < hi)
+	{
+		guint32 mid = lo + (hi - lo) / 2;
+
+		if (cache->postings[mid] < group)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo < trigram[1].start && cache->postings[lo] == group;
+}
+
+
+void tag_cache_find_pattern(TagCache *cache, const gchar *pattern,
+	TagCacheFunc func, gpointer user_data)
+{
+	gchar *folded = fold_name(pattern, strlen(pattern));
+	gchar **runs = g_strsplit_set(folded, "*?", -1);
+	GArray *keys = g_array_new(FALSE, FALSE, sizeof(guint32));
+	GPtrArray *trigrams = g_ptr_array_new();
+	gchar **run;
+	guint i;
+
+	for (run = runs; *run; run++)
+		name_trigrams(*run, keys);
+	g_array_sort(keys, compare_keys);
+
+	if (keys->len == 0 || !tag_cache_has_index(cache))
+	{
+		/* nothing to narrow the search with, or the index isn't built yet */
+		report_lines(cache, cache->entries, cache->size, func, user_data);
+	}
+	else
+	{
+		const IndexTrigram *first;
+		guint32 j;
+
+		for (i = 0; i < keys->len; i++)
+		{
+			const IndexTrigram *trigram = find_trigram(cache, g_array_index(keys, guint32, i));
+
+			if (!trigram)
+				break;
+			g_ptr_array_add(trigrams, (gpointer) trigram);
+		}
+
+		if (i == keys->len)
+		{
+			/* walk the shortest postings and check the others */
+			g_ptr_array_sort(trigrams, compare_postings_length);
+			first = trigrams->pdata[0];
+
+			for (j = first->start; j < first[1].start; j++)
+			{
+				guint32 group = cache->postings[j];
+
+				for (i = 1; i < trigrams->len; i++)
+				{
+					if (!postings_contain(cache, trigrams->pdata[i], group))
+						break;
+				}
+
+				if (i == trigrams->len)
+				{
+					report_lines(cache, cache->groups[group], group + 1 < cache->header->n_groups ?
+						cache->groups[group + 1] : cache->size, func, user_data);
+				}
+			}
+		}
+	}
+
+	g_ptr_array_free(trigrams, TRUE);
+	g_array_free(keys, TRUE);
+	g_strfreev(runs);
+	g_free(folded);
+}
@@ -0,0 +1,57 @@
+/*
+ *	  Copyright 2026 The Geany-Plugins contributors
+ *
+ *	  This program is free software; you can redistribute it and/or modify
+ *	  it under the terms of the GNU General Public License as published by
+ *	  the Free Software Foundation; either version 2 of the License, or
+ *	  (at your option) any later version.
+ *
+ *	  This program is distributed in the hope that it will be useful,
+ *	  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	  GNU General Public License for more details.
+ *
+ *	  You should have received a copy of the GNU General Public License
+ *	  along with this program; if not, write to the Free Software
+ *	  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __TAGCACHE_H__
+#define __TAGCACHE_H__
+
+#include <glib.h>
+
+#include "readtags.h"
+
+/* A tags file mapped into memory, kept open between lookups. Pattern
+ * lookups use a trigram index of the tag names, stored next to the tags
+ * file with the ".idx" suffix. The index is built in the background with
+ * tag_cache_update_index(), and lookups scan the whole file until then. */
+typedef struct TagCache TagCache;
+
+/* called for each candidate entry; the entry is only valid during the call */
+typedef void (*TagCacheFunc)(tagEntry *entry, gpointer user_data);
+
+TagCache *tag_cache_open(const gchar *filename);
+void tag_cache_free(TagCache *cache);
+
+const gchar *tag_cache_get_filename(TagCache *cache);
+gboolean tag_cache_is_current(TagCache *cache);
+
+/* loads the index if it is up to date with the tags file */
+gboolean tag_cache_has_index(TagCache *cache);
+
+/* (re)builds the index of the tags file filename unless it is up to date;
+ * only touches its own copy of the file, so it can run in any thread */
+gboolean tag_cache_update_index(const gchar *filename);
+
+/* case insensitive, like tagsFind() with TAG_IGNORECASE */
+void tag_cache_find(TagCache *cache, const gchar *name, gboolean prefix,
+	TagCacheFunc func, gpointer user_data);
+
+/* reports a superset of the tags whose lowercase name matches the glob
+ * pattern; the caller is expected to do the actual matching */
+void tag_cache_find_pattern(TagCache *cache, const gchar *pattern,
+	TagCacheFunc func, gpointer user_data);
+
+#endif
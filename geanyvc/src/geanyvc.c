@@ -283,19 +283,383 @@ find_dir(const gchar * filename, const char *find, gboolean recursive)
 }
 
 
-static const VC_RECORD *
-find_vc(const char *filename)
+/* VC detection cache. Directories map to the VC they are under, if any, along with
+ * the base directory of the working copy; files map to whether the VC of their
+ * directory tracks them, which is only asked for in working copies.
+ * Each directory is watched by monitors on itself and on the parents up to the base
+ * directory, or up to the root for directories which aren't under version control,
+ * so that a VC directory created or deleted in any of them drops the entries below
+ * it. The VC metadata of working copies (e.g. .git) is watched as well, dropping the
+ * files of the working copy when it changes, e.g. after "git add" in a terminal.
+ * Only the most recently used monitors are kept, dropping the entries depending on
+ * the others, and the whole cache is dropped when VC commands change the working
+ * copy. */
+#define VC_CACHE_MAX_MONITORS 128
+
+typedef struct
+{
+	const VC_RECORD *vc;
+	gchar *base_dir;
+	gchar *metadata;	/* closest VC metadata, e.g. the .git directory */
+} VCCacheEntry;
+
+typedef struct
+{
+	gchar *path;
+	gboolean metadata;	/* whether path is VC metadata rather than a directory */
+	GFileMonitor *monitor;
+	GList *link;		/* in vc_cache_monitor_queue */
+} VCCacheMonitor;
+
+static GHashTable *vc_cache = NULL;		/* directory -> VCCacheEntry */
+static GHashTable *vc_file_cache = NULL;	/* file -> VC_RECORD tracking it, or NULL */
+static GHashTable *vc_cache_monitors = NULL;	/* path -> VCCacheMonitor */
+static GQueue vc_cache_monitor_queue = G_QUEUE_INIT;	/* most recently used first */
+
+/* names of the metadata the backends look for to detect a working copy */
+static const gchar * const vc_cache_markers[] = { ".git", ".hg", ".svn", ".bzr", "CVS", NULL };
+
+static void
+vc_cache_entry_free(VCCacheEntry * entry)
+{
+	g_free(entry->base_dir);
+	g_free(entry->metadata);
+	g_free(entry);
+}
+
+static void
+vc_cache_monitor_free(VCCacheMonitor * m)
+{
+	g_signal_handlers_disconnect_by_data(m->monitor, m);
+	g_file_monitor_cancel(m->monitor);
+	g_object_unref(m->monitor);
+	g_queue_delete_link(&vc_cache_monitor_queue, m->link);
+	g_free(m->path);
+	g_free(m);
+}
+
+static void
+vc_cache_clear(void)
+{
+	if (vc_cache)
+	{
+		g_hash_table_remove_all(vc_cache);
+		g_hash_table_remove_all(vc_file_cache);
+	}
+}
+
+static void
+vc_cache_free(void)
+{
+	if (vc_cache)
+	{
+		g_hash_table_destroy(vc_cache);
+		g_hash_table_destroy(vc_file_cache);
+		g_hash_table_destroy(vc_cache_monitors);
+	}
+	vc_cache = NULL;
+	vc_file_cache = NULL;
+	vc_cache_monitors = NULL;
+}
+
+/* whether the path key is dir or is inside it */
+static gboolean
+vc_cache_is_below(gpointer key, G_GNUC_UNUSED gpointer value, gpointer dir)
+{
+	const gchar *path = key;
+	const gchar *prefix = dir;
+	gsize len = strlen(prefix);
+
+	if (strncmp(path, prefix, len) != 0)
+		return FALSE;
+	return path[len] == '\0' || G_IS_DIR_SEPARATOR(path[len]) ||
+		(len > 0 && G_IS_DIR_SEPARATOR(prefix[len - 1]));
+}
+
+static void
+vc_cache_remove_below(const gchar * dir)
+{
+	g_hash_table_foreach_remove(vc_cache, vc_cache_is_below, (gpointer) dir);
+	g_hash_table_foreach_remove(vc_file_cache, vc_cache_is_below, (gpointer) dir);
+}
+
+/* drops the files of the working copy described by metadata */
+static void
+vc_cache_forget_tracked(const gchar * metadata)
+{
+	gchar *dir = g_path_get_dirname(metadata);
+
+	g_hash_table_foreach_remove(vc_file_cache, vc_cache_is_below, dir);
+	g_free(dir);
+}
+
+/* drops what creating or deleting file can change: the detection of everything
+ * in its directory for VC metadata, otherwise the file and what is inside it */
+static void
+vc_cache_forget_file(GFile * file)
+{
+	gchar *locale_path = g_file_get_path(file);
+	gchar *path;
+	gchar *name;
+
+	if (!locale_path)
+		return;
+
+	path = utils_get_utf8_from_locale(locale_path);
+	name = g_path_get_basename(path);
+	if (g_strv_contains(vc_cache_markers, name))
+		SETPTR(path, g_path_get_dirname(path));
+	vc_cache_remove_below(path);
+
+	g_free(name);
+	g_free(path);
+	g_free(locale_path);
+}
+
+static void
+on_vc_cache_changed(G_GNUC_UNUSED GFileMonitor * monitor, GFile * file,
+		    GFile * other_file, GFileMonitorEvent event, gpointer data)
+{
+	VCCacheMonitor *m = data;
+
+	if (m->metadata)
+	{
+		/* e.g. the index changed, so files may have been added or removed */
+		vc_cache_forget_tracked(m->path);
+	}
+	/* content changes don't move files in or out of version control */
+	else if (event == G_FILE_MONITOR_EVENT_CREATED || event == G_FILE_MONITOR_EVENT_DELETED ||
+		 event == G_FILE_MONITOR_EVENT_MOVED)
+	{
+		vc_cache_forget_file(file);
+		if (other_file)
+			vc_cache_forget_file(other_file);
+	}
+}
+
+/* starts watching path, or marks it as most recently used if it is already */
+static void
+vc_cache_watch(const gchar * path, gboolean metadata)
+{
+	VCCacheMonitor *m;
+	gchar *locale_path;
+	GFile *file;
+	GFileMonitor *monitor;
+
+	m = g_hash_table_lookup(vc_cache_monitors, path);
+	if (m)
+	{
+		g_queue_unlink(&vc_cache_monitor_queue, m->link);
+		g_queue_push_head_link(&vc_cache_monitor_queue, m->link);
+		return;
+	}
+
+	locale_path = utils_get_locale_from_utf8(path);
+	file = g_file_new_for_path(locale_path);
+	if (metadata)
+		monitor = g_file_monitor(file, G_FILE_MONITOR_NONE, NULL, NULL);
+	else
+		monitor = g_file_monitor_directory(file, G_FILE_MONITOR_NONE, NULL, NULL);
+	if (monitor)
+	{
+		m = g_new0(VCCacheMonitor, 1);
+		m->path = g_strdup(path);
+		m->metadata = metadata;
+		m->monitor = monitor;
+		g_queue_push_head(&vc_cache_monitor_queue, m);
+		m->link = vc_cache_monitor_queue.head;
+		g_hash_table_insert(vc_cache_monitors, m->path, m);
+		g_signal_connect(monitor, "changed", G_CALLBACK(on_vc_cache_changed), m);
+	}
+	g_object_unref(file);
+	g_free(locale_path);
+}
+
+/* watches dir and its parents up to top, or up to the root if top is NULL */
+static void
+vc_cache_watch_parents(const gchar * dir, const gchar * top)
+{
+	gchar *path = g_strdup(dir);
+
+	while (TRUE)
+	{
+		gchar *parent;
+
+		vc_cache_watch(path, FALSE);
+		if (top && utils_str_equal(path, top))
+			break;
+		parent = g_path_get_dirname(path);
+		if (utils_str_equal(parent, path))
+		{
+			g_free(parent);
+			break;
+		}
+		SETPTR(path, parent);
+	}
+	g_free(path);
+}
+
+/* keeps the monitors the entry of dir depends on, dropping the least recently used
+ * ones beyond the limit along with what depends on them, possibly entry itself */
+static void
+vc_cache_watch_entry(const gchar * dir, VCCacheEntry * entry)
+{
+	vc_cache_watch_parents(dir, entry->base_dir);
+	if (entry->metadata)
+		vc_cache_watch(entry->metadata, TRUE);
+
+	while (vc_cache_monitor_queue.length > VC_CACHE_MAX_MONITORS)
+	{
+		VCCacheMonitor *m = g_queue_peek_tail(&vc_cache_monitor_queue);
+
+		if (m->metadata)
+			vc_cache_forget_tracked(m->path);
+		else
+			vc_cache_remove_below(m->path);
+		g_hash_table_remove(vc_cache_monitors, m->path);
+	}
+}
+
+/* the closest VC metadata from dir up to base_dir, e.g. the .git directory of
+ * the working copy or the CVS directory of dir */
+static gchar *
+vc_cache_find_metadata(const gchar * dir, const gchar * base_dir)
+{
+	gchar *path = g_strdup(dir);
+
+	while (TRUE)
+	{
+		const gchar * const *marker;
+		gchar *parent;
+
+		for (marker = vc_cache_markers; *marker; marker++)
+		{
+			gchar *metadata = g_build_filename(path, *marker, NULL);
+			gchar *locale_metadata = utils_get_locale_from_utf8(metadata);
+			gboolean exists = g_file_test(locale_metadata, G_FILE_TEST_EXISTS);
+
+			g_free(locale_metadata);
+			if (exists)
+			{
+				g_free(path);
+				return metadata;
+			}
+			g_free(metadata);
+		}
+
+		parent = g_path_get_dirname(path);
+		if ((base_dir && utils_str_equal(path, base_dir)) || utils_str_equal(parent, path))
+		{
+			g_free(parent);
+			break;
+		}
+		SETPTR(path, parent);
+	}
+	g_free(path);
+	return NULL;
+}
+
+/* the cached detection of directory dir, asking the backends on a miss */
+static VCCacheEntry *
+vc_cache_get_dir(const gchar * dir)
 {
+	VCCacheEntry *entry;
 	GSList *tmp;
 
+	if (!vc_cache)
+	{
+		vc_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+						 (GDestroyNotify) vc_cache_entry_free);
+		vc_file_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+		vc_cache_monitors = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+							  (GDestroyNotify) vc_cache_monitor_free);
+	}
+
+	entry = g_hash_table_lookup(vc_cache, dir);
+	if (entry)
+		return entry;
+
+	entry = g_new0(VCCacheEntry, 1);
 	for (tmp = VC; tmp != NULL; tmp = g_slist_next(tmp))
 	{
-		if (((VC_RECORD *) tmp->data)->in_vc(filename))
+		if (((VC_RECORD *) tmp->data)->in_vc(dir))
 		{
-			return (VC_RECORD *) tmp->data;
+			entry->vc = tmp->data;
+			break;
 		}
 	}
-	return NULL;
+	if (entry->vc)
+	{
+		entry->base_dir = entry->vc->get_base_dir(dir);
+		entry->metadata = vc_cache_find_metadata(dir, entry->base_dir);
+	}
+	g_hash_table_insert(vc_cache, g_strdup(dir), entry);
+
+	return entry;
+}
+
+static const VC_RECORD *
+find_vc(const char *filename)
+{
+	VCCacheEntry *entry;
+	const VC_RECORD *vc;
+	gpointer tracked = NULL;
+	gboolean known_file, is_file;
+	gchar *dir;
+
+	if (!filename)
+		return NULL;
+
+	/* only paths which aren't known yet are checked on disk */
+	known_file = vc_file_cache &&
+		g_hash_table_lookup_extended(vc_file_cache, filename, NULL, &tracked);
+	is_file = known_file || !((vc_cache && g_hash_table_contains(vc_cache, filename)) ||
+				  g_file_test(filename, G_FILE_TEST_IS_DIR));
+	if (is_file)
+		dir = g_path_get_dirname(filename);
+	else
+		dir = g_strdup(filename);
+
+	entry = vc_cache_get_dir(dir);
+	if (!is_file)
+		vc = entry->vc;
+	else if (known_file)
+		vc = tracked;
+	else
+	{
+		/* files are tracked by the VC of their directory, if any */
+		vc = (entry->vc && entry->vc->in_vc(filename)) ? entry->vc : NULL;
+		g_hash_table_insert(vc_file_cache, g_strdup(filename), (gpointer) vc);
+	}
+
+	vc_cache_watch_entry(dir, entry);
+	g_free(dir);
+
+	return vc;
+}
+
+/* vc->get_base_dir(), remembered for the directory of filename */
+static gchar *
+find_base_dir(const VC_RECORD * vc, const gchar * filename)
+{
+	VCCacheEntry *entry;
+	gchar *dir;
+	gchar *ret;
+
+	if (g_file_test(filename, G_FILE_TEST_IS_DIR))
+		dir = g_strdup(filename);
+	else
+		dir = g_path_get_dirname(filename);
+
+	entry = vc_cache_get_dir(dir);
+	if (entry->vc == vc)
+		ret = g_strdup(entry->base_dir);
+	else
+		ret = vc->get_base_dir(filename);
+	vc_cache_watch_entry(dir, entry);
+
+	g_free(dir);
+	return ret;
 }
 
 static void *
@@ -449,6 +813,32 @@ show_output(const gchar * std_output, const gchar * name,
 	}
 }
 
+/* need to convert output text from the encoding of the original file into
+ * UTF-8 because internally Geany always needs UTF-8; empty output becomes NULL */
+static void
+normalize_output(gchar ** text)
+{
+	GString *tmp;
+
+	if (!*text)
+		return;
+
+	tmp = g_string_new(*text);
+	utils_string_replace_all(tmp, "\r\n", "\n");
+	utils_string_replace_all(tmp, "\r", "\n");
+	SETPTR(*text, g_string_free(tmp, FALSE));
+
+	if (!g_utf8_validate(*text, -1, NULL))
+	{
+		SETPTR(*text, encodings_convert_to_utf8(*text, strlen(*text), NULL));
+	}
+	if (EMPTY(*text))
+	{
+		g_free(*text);
+		*text = NULL;
+	}
+}
+
 /*
  * Execute command by command spec, return std_out std_err
  *
@@ -469,7 +859,6 @@ execute_custom_command(const gchar * dir, const gchar ** argv, const gchar ** en
 			   const gchar * message)
 {
 	gint exit_code;
-	GString *tmp;
 	GSList *cur;
 	GSList *largv = get_cmd(argv, dir, filename, list, message);
 	GError *error = NULL;
@@ -509,44 +898,10 @@ execute_custom_command(const gchar * dir, const gchar ** argv, const gchar ** en
 			g_error_free(error);
 		}
 
-		/* need to convert output text from the encoding of the original file into
-		   UTF-8 because internally Geany always needs UTF-8 */
-		if (std_out && *std_out)
-		{
-			tmp = g_string_new(*std_out);
-			utils_string_replace_all(tmp, "\r\n", "\n");
-			utils_string_replace_all(tmp, "\r", "\n");
-			SETPTR(*std_out, g_string_free(tmp, FALSE));
-
-			if (!g_utf8_validate(*std_out, -1, NULL))
-			{
-				SETPTR(*std_out, encodings_convert_to_utf8(*std_out,
-									   strlen(*std_out), NULL));
-			}
-			if (EMPTY(*std_out))
-			{
-				g_free(*std_out);
-				*std_out = NULL;
-			}
-		}
-		if (std_err && *std_err)
-		{
-			tmp = g_string_new(*std_err);
-			utils_string_replace_all(tmp, "\r\n", "\n");
-			utils_string_replace_all(tmp, "\r", "\n");
-			SETPTR(*std_err, g_string_free(tmp, FALSE));
-
-			if (!g_utf8_validate(*std_err, -1, NULL))
-			{
-				SETPTR(*std_err, encodings_convert_to_utf8(*std_err,
-									   strlen(*std_err), NULL));
-			}
-			if (EMPTY(*std_err))
-			{
-				g_free(*std_err);
-				*std_err = NULL;
-			}
-		}
+		if (std_out)
+			normalize_output(std_out);
+		if (std_err)
+			normalize_output(std_err);
 		g_strfreev(cur->data);
 	}
 	g_slist_free(largv);
@@ -580,7 +935,7 @@ execute_command(const VC_RECORD * vc, gchar ** std_out, gchar ** std_err, const
 	}
 	else if (vc->commands[cmd].startdir == VC_COMMAND_STARTDIR_BASE)
 	{
-		dir = vc->get_base_dir(filename);
+		dir = find_base_dir(vc, filename);
 	}
 	else
 	{
@@ -597,6 +952,365 @@ execute_command(const VC_RECORD * vc, gchar ** std_out, gchar ** std_err, const
 	return ret;
 }
 
+/*
+ * Asynchronous command execution.
+ *
+ * The commands of the spec run one after another without blocking the UI. Standard
+ * output of the last command is passed to output_func line by line as it arrives,
+ * converted to UTF-8, then done_func gets the exit code and standard error. Neither
+ * is called once the job has been cancelled; user_data is released with destroy
+ * when the job goes away in any case.
+ */
+typedef struct _VCJob VCJob;
+
+typedef void (*VCJobOutputFunc) (VCJob * job, const gchar * text, gpointer user_data);
+typedef void (*VCJobDoneFunc) (VCJob * job, gint exit_code, const gchar * std_err,
+			       gpointer user_data);
+
+struct _VCJob
+{
+	gchar *dir;
+	const gchar **env;
+	GSList *argv_list;	/* remaining commands, the first one is running */
+	GPid pid;
+	guint idle_id;
+	gboolean cancelled;
+	gint exit_code;
+	gchar *std_out;		/* output of a custom command function */
+	GString *std_err;
+	VCJobOutputFunc output_func;
+	VCJobDoneFunc done_func;
+	gpointer user_data;
+	GDestroyNotify destroy;
+};
+
+static GSList *running_jobs = NULL;
+
+static void
+vc_job_free(VCJob * job)
+{
+	running_jobs = g_slist_remove(running_jobs, job);
+	if (job->destroy)
+		job->destroy(job->user_data);
+	g_slist_free_full(job->argv_list, (GDestroyNotify) g_strfreev);
+	g_string_free(job->std_err, TRUE);
+	g_free(job->std_out);
+	g_free(job->dir);
+	g_free(job);
+}
+
+static void
+vc_job_finish(VCJob * job)
+{
+	if (!job->cancelled && job->done_func)
+	{
+		gchar *std_err = g_strdup(job->std_err->str);
+
+		normalize_output(&std_err);
+		job->done_func(job, job->exit_code, std_err, job->user_data);
+		g_free(std_err);
+	}
+	vc_job_free(job);
+}
+
+static void
+vc_job_cancel(VCJob * job)
+{
+	job->cancelled = TRUE;
+	if (job->pid)
+		spawn_kill_process(job->pid, NULL);	/* freed by on_job_exit() */
+	else if (job->idle_id)
+	{
+		g_source_remove(job->idle_id);
+		vc_job_free(job);
+	}
+	/* otherwise we are inside one of the job callbacks, vc_job_finish() frees it */
+}
+
+static void
+vc_cancel_all_jobs(void)
+{
+	GSList *jobs = g_slist_copy(running_jobs);
+	GSList *item;
+
+	foreach_slist(item, jobs)
+	{
+		vc_job_cancel(item->data);
+	}
+	g_slist_free(jobs);
+}
+
+static gboolean
+on_job_idle(gpointer data)
+{
+	VCJob *job = data;
+
+	job->idle_id = 0;
+	if (job->std_out && job->output_func)
+		job->output_func(job, job->std_out, job->user_data);
+	vc_job_finish(job);
+	return FALSE;
+}
+
+static void
+on_job_stdout(GString * string, GIOCondition condition, gpointer data)
+{
+	VCJob *job = data;
+	gchar *text;
+
+	/* the output of all but the last command is dropped */
+	if (job->cancelled || job->argv_list->next || !(condition & (G_IO_IN | G_IO_PRI)))
+		return;
+
+	text = g_strdup(string->str);
+	normalize_output(&text);
+	if (text && job->output_func)
+		job->output_func(job, text, job->user_data);
+	g_free(text);
+}
+
+static void
+on_job_stderr(GString * string, GIOCondition condition, gpointer data)
+{
+	VCJob *job = data;
+
+	if (!job->cancelled && !job->argv_list->next && (condition & (G_IO_IN | G_IO_PRI)))
+		g_string_append(job->std_err, string->str);
+}
+
+static gboolean vc_job_spawn(VCJob * job);
+
+static void
+on_job_exit(G_GNUC_UNUSED GPid pid, gint status, gpointer data)
+{
+	VCJob *job = data;
+	GSList *cur = job->argv_list;
+
+	job->pid = 0;
+	job->exit_code = status;
+	job->argv_list = cur->next;
+	g_strfreev(cur->data);
+	g_slist_free_1(cur);
+
+	if (job->cancelled)
+		vc_job_free(job);
+	else if (!vc_job_spawn(job))
+		vc_job_finish(job);
+}
+
+/* starts the next command, returns FALSE when there is none left */
+static gboolean
+vc_job_spawn(VCJob * job)
+{
+	while (job->argv_list)
+	{
+		GSList *cur = job->argv_list;
+		GError *error = NULL;
+
+		if (spawn_with_callbacks(job->dir, NULL, cur->data, (gchar **) job->env,
+					 SPAWN_STDOUT_RECURSIVE | SPAWN_STDERR_RECURSIVE, NULL, NULL,
+					 on_job_stdout, job, 0, on_job_stderr, job, 0,
+					 on_job_exit, job, &job->pid, &error))
+		{
+			return TRUE;
+		}
+
+		g_warning("geanyvc: spawn error: %s", error->message);
+		ui_set_statusbar(FALSE, _("geanyvc: spawn error: %s"), error->message);
+		g_error_free(error);
+
+		job->exit_code = -1;
+		job->argv_list = cur->next;
+		g_strfreev(cur->data);
+		g_slist_free_1(cur);
+	}
+	return FALSE;
+}
+
+static VCJob *
+vc_job_new(const gchar * dir, const gchar ** env, VCJobOutputFunc output_func,
+	   VCJobDoneFunc done_func, gpointer user_data, GDestroyNotify destroy)
+{
+	VCJob *job = g_new0(VCJob, 1);
+
+	job->dir = g_strdup(dir);
+	job->env = env;
+	job->std_err = g_string_new(NULL);
+	job->output_func = output_func;
+	job->done_func = done_func;
+	job->user_data = user_data;
+	job->destroy = destroy;
+	running_jobs = g_slist_prepend(running_jobs, job);
+	return job;
+}
+
+static VCJob *
+execute_command_async(const VC_RECORD * vc, const gchar * filename, gint cmd, GSList * list,
+		      const gchar * message, VCJobOutputFunc output_func,
+		      VCJobDoneFunc done_func, gpointer user_data, GDestroyNotify destroy)
+{
+	VCJob *job;
+	gchar *dir = NULL;
+	const gint action_command_cell = 1;
+
+	if (vc->commands[cmd].function)
+	{
+		gchar *std_err = NULL;
+
+		/* custom command functions are synchronous, only report asynchronously so
+		 * the callers don't need to care */
+		job = vc_job_new(NULL, NULL, output_func, done_func, user_data, destroy);
+		job->exit_code = vc->commands[cmd].function(&job->std_out, &std_err, filename,
+							    list, message);
+		if (std_err)
+			g_string_append(job->std_err, std_err);
+		g_free(std_err);
+		job->idle_id = g_idle_add(on_job_idle, job);
+		return job;
+	}
+
+	if (vc->commands[cmd].startdir == VC_COMMAND_STARTDIR_FILE)
+	{
+		if (g_file_test(filename, G_FILE_TEST_IS_DIR))
+			dir = g_strdup(filename);
+		else
+			dir = g_path_get_dirname(filename);
+	}
+	else if (vc->commands[cmd].startdir == VC_COMMAND_STARTDIR_BASE)
+	{
+		dir = find_base_dir(vc, filename);
+	}
+	else
+	{
+		g_warning("geanyvc: unknown startdir type: %d", vc->commands[cmd].startdir);
+	}
+
+	job = vc_job_new(dir, vc->commands[cmd].env, output_func, done_func, user_data, destroy);
+	job->argv_list = get_cmd(vc->commands[cmd].command, dir, filename, list, message);
+	if (!vc_job_spawn(job))
+		job->idle_id = g_idle_add(on_job_idle, job);
+
+	ui_set_statusbar(TRUE, _("File %s: action %s executed via %s."),
+			 filename, vc->commands[cmd].command[action_command_cell], vc->program);
+
+	g_free(dir);
+	return job;
+}
+
+/* Output of a command streamed into a document */
+typedef struct
+{
+	VCJob *job;
+	gchar *name;
+	gchar *force_encoding;
+	GeanyFiletype *ftype;
+	gint line;
+	const gchar *empty_message;
+	gboolean started;
+} OutputDoc;
+
+static GSList *output_docs = NULL;
+
+static void
+output_doc_free(OutputDoc * out)
+{
+	output_docs = g_slist_remove(output_docs, out);
+	g_free(out->name);
+	g_free(out->force_encoding);
+	g_free(out);
+}
+
+static void
+on_output_doc_text(VCJob * job, const gchar * text, gpointer user_data)
+{
+	OutputDoc *out = user_data;
+	GeanyDocument *doc = document_find_by_filename(out->name);
+
+	if (!out->started)
+	{
+		GeanyDocument *cur_doc = document_get_current();
+
+		if (doc == NULL)
+		{
+			doc = document_new_file(out->name, out->ftype, text);
+		}
+		else
+		{
+			sci_set_text(doc->editor->sci, text);
+			if (out->ftype)
+				document_set_filetype(doc, out->ftype);
+		}
+		document_set_encoding(doc, (out->force_encoding ? out->force_encoding : "UTF-8"));
+		navqueue_goto_line(cur_doc, doc, 1);
+		out->started = TRUE;
+	}
+	else if (doc == NULL)
+	{
+		/* the document was closed meanwhile */
+		vc_job_cancel(job);
+	}
+	else
+	{
+		scintilla_send_message(doc->editor->sci, SCI_APPENDTEXT, strlen(text),
+				       (sptr_t) text);
+	}
+}
+
+static void
+on_output_doc_done(G_GNUC_UNUSED VCJob * job, G_GNUC_UNUSED gint exit_code,
+		   G_GNUC_UNUSED const gchar * std_err, gpointer user_data)
+{
+	OutputDoc *out = user_data;
+
+	if (out->started)
+	{
+		GeanyDocument *doc = document_find_by_filename(out->name);
+
+		if (doc)
+		{
+			document_set_text_changed(doc, set_changed_flag);
+			if (out->line > 0)
+				sci_goto_line(doc->editor->sci, out->line, TRUE);
+		}
+	}
+	else if (out->empty_message)
+	{
+		ui_set_statusbar(FALSE, "%s", out->empty_message);
+	}
+}
+
+/* name should be in UTF-8, and can have a path. */
+static void
+show_command_output(const VC_RECORD * vc, const gchar * filename, gint cmd, const gchar * name,
+		    const gchar * force_encoding, GeanyFiletype * ftype, gint line,
+		    const gchar * empty_message)
+{
+	OutputDoc *out;
+	GSList *item;
+
+	/* a previous command still writing into the same document is superseded */
+	foreach_slist(item, output_docs)
+	{
+		out = item->data;
+		if (utils_str_equal(out->name, name))
+		{
+			vc_job_cancel(out->job);
+			break;
+		}
+	}
+
+	out = g_new0(OutputDoc, 1);
+	out->name = g_strdup(name);
+	out->force_encoding = g_strdup(force_encoding);
+	out->ftype = ftype;
+	out->line = line;
+	out->empty_message = empty_message;
+	output_docs = g_slist_prepend(output_docs, out);
+
+	out->job = execute_command_async(vc, filename, cmd, NULL, NULL, on_output_doc_text,
+					 on_output_doc_done, out, (GDestroyNotify) output_doc_free);
+}
+
 static gint
 get_command_exit_status(gint exit_code)
 {
@@ -675,27 +1389,25 @@ vcdiff_file_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpoint
 	vc = find_vc(doc->file_name);
 	g_return_if_fail(vc);
 
-	execute_command(vc, &text, NULL, doc->file_name, VC_COMMAND_DIFF_FILE, NULL, NULL);
-	if (text)
+	if (set_external_diff && get_external_diff_viewer())
 	{
-		if (set_external_diff && get_external_diff_viewer())
+		execute_command(vc, &text, NULL, doc->file_name, VC_COMMAND_DIFF_FILE, NULL, NULL);
+		if (text)
 		{
 			g_free(text);
 			diff_external(vc, doc->file_name);
-			return;
 		}
 		else
 		{
-			name = g_strconcat(doc->file_name, ".vc.diff", NULL);
-			show_output(text, name, doc->encoding, NULL, 0);
-			g_free(text);
-			g_free(name);
+			ui_set_statusbar(FALSE, _("No changes were made."));
 		}
-
 	}
 	else
 	{
-		ui_set_statusbar(FALSE, _("No changes were made."));
+		name = g_strconcat(doc->file_name, ".vc.diff", NULL);
+		show_command_output(vc, doc->file_name, VC_COMMAND_DIFF_FILE, name, doc->encoding,
+				    NULL, 0, _("No changes were made."));
+		g_free(name);
 	}
 }
 
@@ -724,7 +1436,7 @@ vcdiff_dir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, gpointer data)
 
 	if (flags & FLAG_BASEDIR)
 	{
-		dir = vc->get_base_dir(doc->file_name);
+		dir = find_base_dir(vc, doc->file_name);
 	}
 	else if (flags & FLAG_DIR)
 	{
@@ -734,10 +1446,10 @@ vcdiff_dir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, gpointer data)
 		return;
 	g_return_if_fail(dir);
 
-	execute_command(vc, &text, NULL, dir, VC_COMMAND_DIFF_DIR, NULL, NULL);
-	if (text)
+	if (set_external_diff && get_external_diff_viewer())
 	{
-		if (set_external_diff && get_external_diff_viewer())
+		execute_command(vc, &text, NULL, dir, VC_COMMAND_DIFF_DIR, NULL, NULL);
+		if (text)
 		{
 			GSList *lst;
 
@@ -772,16 +1484,16 @@ vcdiff_dir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, gpointer data)
 		}
 		else
 		{
-			gchar *name;
-			name = g_strconcat(dir, ".vc.diff", NULL);
-			show_output(text, name, doc->encoding, NULL, 0);
-			g_free(text);
-			g_free(name);
+			ui_set_statusbar(FALSE, _("No changes were made."));
 		}
 	}
 	else
 	{
-		ui_set_statusbar(FALSE, _("No changes were made."));
+		gchar *name;
+		name = g_strconcat(dir, ".vc.diff", NULL);
+		show_command_output(vc, dir, VC_COMMAND_DIFF_DIR, name, doc->encoding, NULL, 0,
+				    _("No changes were made."));
+		g_free(name);
 	}
 	g_free(dir);
 }
@@ -789,7 +1501,6 @@ vcdiff_dir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, gpointer data)
 static void
 vcblame_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
 {
-	gchar *text = NULL;
 	const VC_RECORD *vc;
 	GeanyDocument *doc;
 
@@ -799,24 +1510,15 @@ vcblame_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer g
 	vc = find_vc(doc->file_name);
 	g_return_if_fail(vc);
 
-	execute_command(vc, &text, NULL, doc->file_name, VC_COMMAND_BLAME, NULL, NULL);
-	if (text)
-	{
-		show_output(text, "*VC-BLAME*", NULL,
-			doc->file_type, sci_get_current_line(doc->editor->sci));
-		g_free(text);
-	}
-	else
-	{
-		ui_set_statusbar(FALSE, _("No history available"));
-	}
+	show_command_output(vc, doc->file_name, VC_COMMAND_BLAME, "*VC-BLAME*", NULL,
+			    doc->file_type, sci_get_current_line(doc->editor->sci),
+			    _("No history available"));
 }
 
 
 static void
 vclog_file_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
 {
-	gchar *output = NULL;
 	const VC_RECORD *vc;
 	GeanyDocument *doc;
 
@@ -826,19 +1528,14 @@ vclog_file_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointe
 	vc = find_vc(doc->file_name);
 	g_return_if_fail(vc);
 
-	execute_command(vc, &output, NULL, doc->file_name, VC_COMMAND_LOG_FILE, NULL, NULL);
-	if (output)
-	{
-		show_output(output, "*VC-LOG*", NULL, NULL, 0);
-		g_free(output);
-	}
+	show_command_output(vc, doc->file_name, VC_COMMAND_LOG_FILE, "*VC-LOG*", NULL, NULL, 0,
+			    NULL);
 }
 
 static void
 vclog_dir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
 {
 	gchar *base_name = NULL;
-	gchar *text = NULL;
 	const VC_RECORD *vc;
 	GeanyDocument *doc;
 
@@ -850,12 +1547,7 @@ vclog_dir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 	vc = find_vc(base_name);
 	g_return_if_fail(vc);
 
-	execute_command(vc, &text, NULL, base_name, VC_COMMAND_LOG_DIR, NULL, NULL);
-	if (text)
-	{
-		show_output(text, "*VC-LOG*", NULL, NULL, 0);
-		g_free(text);
-	}
+	show_command_output(vc, base_name, VC_COMMAND_LOG_DIR, "*VC-LOG*", NULL, NULL, 0, NULL);
 
 	g_free(base_name);
 }
@@ -863,7 +1555,6 @@ vclog_dir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 static void
 vclog_basedir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
 {
-	gchar *text = NULL;
 	const VC_RECORD *vc;
 	GeanyDocument *doc;
 	gchar *basedir;
@@ -874,15 +1565,10 @@ vclog_basedir_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpoi
 	vc = find_vc(doc->file_name);
 	g_return_if_fail(vc);
 
-	basedir = vc->get_base_dir(doc->file_name);
+	basedir = find_base_dir(vc, doc->file_name);
 	g_return_if_fail(basedir);
 
-	execute_command(vc, &text, NULL, basedir, VC_COMMAND_LOG_DIR, NULL, NULL);
-	if (text)
-	{
-		show_output(text, "*VC-LOG*", NULL, NULL, 0);
-		g_free(text);
-	}
+	show_command_output(vc, basedir, VC_COMMAND_LOG_DIR, "*VC-LOG*", NULL, NULL, 0, NULL);
 	g_free(basedir);
 }
 
@@ -891,7 +1577,6 @@ static void
 vcstatus_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
 {
 	gchar *base_name = NULL;
-	gchar *text = NULL;
 	const VC_RECORD *vc;
 	GeanyDocument *doc;
 
@@ -908,12 +1593,7 @@ vcstatus_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 	vc = find_vc(base_name);
 	g_return_if_fail(vc);
 
-	execute_command(vc, &text, NULL, base_name, VC_COMMAND_STATUS, NULL, NULL);
-	if (text)
-	{
-		show_output(text, "*VC-STATUS*", NULL, NULL, 0);
-		g_free(text);
-	}
+	show_command_output(vc, base_name, VC_COMMAND_STATUS, "*VC-STATUS*", NULL, NULL, 0, NULL);
 
 	g_free(base_name);
 }
@@ -921,7 +1601,7 @@ vcstatus_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 static void
 vcshow_file_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer gdata)
 {
-	gchar *output = NULL;
+	gchar *name;
 	const VC_RECORD *vc;
 	GeanyDocument *doc;
 
@@ -931,15 +1611,10 @@ vcshow_file_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpoint
 	vc = find_vc(doc->file_name);
 	g_return_if_fail(vc);
 
-	execute_command(vc, &output, NULL, doc->file_name, VC_COMMAND_SHOW, NULL, NULL);
-	if (output)
-	{
-		gchar *name;
-		name = g_strconcat(doc->file_name, ".vc.orig", NULL);
-		show_output(output, name, doc->encoding, doc->file_type, 0);
-		g_free(name);
-		g_free(output);
-	}
+	name = g_strconcat(doc->file_name, ".vc.orig", NULL);
+	show_command_output(vc, doc->file_name, VC_COMMAND_SHOW, name, doc->encoding,
+			    doc->file_type, 0, NULL);
+	g_free(name);
 }
 
 static gboolean
@@ -960,7 +1635,7 @@ command_with_question_activated(gchar ** text, gint cmd, const gchar * question,
 
 	if (flags & FLAG_BASEDIR)
 	{
-		dir = vc->get_base_dir(dir);
+		SETPTR(dir, find_base_dir(vc, dir));
 	}
 
 	if (doc->changed)
@@ -992,6 +1667,7 @@ command_with_question_activated(gchar ** text, gint cmd, const gchar * question,
 			execute_command(vc, text, NULL, dir, cmd, NULL, NULL);
 		if (flags & FLAG_RELOAD)
 			document_reload_force(doc, NULL);
+		vc_cache_clear();
 	}
 	g_free(dir);
 	return (result == GTK_RESPONSE_YES);
@@ -1106,70 +1782,200 @@ get_commit_files_foreach(GtkTreeModel * model, G_GNUC_UNUSED GtkTreePath * path,
 	return FALSE;
 }
 
+#define COMMIT_DIFF_JOBS 4
+
+/* Per-file diffs of the commit dialog, collected in the background by up to
+ * COMMIT_DIFF_JOBS commands at a time; the diff of a file is only put into the
+ * diff view when its row gets selected */
+typedef struct
+{
+	GtkTreeView *treeview;
+	GtkTextView *textview;
+	const VC_RECORD *vc;
+	GHashTable *diffs;	/* path -> diff text */
+	GQueue pending;		/* paths waiting for their diff */
+	GSList *running;	/* CommitDiffJob */
+	gchar *selected;	/* path of the row shown in the diff view */
+} CommitDiffs;
+
+typedef struct
+{
+	CommitDiffs *cd;
+	VCJob *job;
+	gchar *path;
+	GString *output;
+} CommitDiffJob;
+
+static void set_diff_buff(GtkWidget * textview, GtkTextBuffer * buffer, const gchar * txt);
+
 static gboolean
-get_commit_diff_foreach(GtkTreeModel * model, G_GNUC_UNUSED GtkTreePath * path, GtkTreeIter * iter,
-			gpointer data)
+get_modified_files_foreach(GtkTreeModel * model, G_GNUC_UNUSED GtkTreePath * path,
+			   GtkTreeIter * iter, gpointer data)
 {
-	GString *diff = data;
-	gboolean commit;
-	gchar *filename;
-	gchar *tmp = NULL;
+	GQueue *files = data;
 	gchar *status;
-	const VC_RECORD *vc;
+	gchar *filename;
 
-	gtk_tree_model_get(model, iter, COLUMN_COMMIT, &commit, -1);
-	if (!commit)
-		return FALSE;
+	gtk_tree_model_get(model, iter, COLUMN_STATUS, &status, COLUMN_PATH, &filename, -1);
 
-	gtk_tree_model_get(model, iter, COLUMN_STATUS, &status, -1);
+	if (utils_str_equal(status, FILE_STATUS_MODIFIED))
+		g_queue_push_tail(files, filename);
+	else
+		g_free(filename);
+	g_free(status);
+	return FALSE;
+}
 
-	if (! utils_str_equal(status, FILE_STATUS_MODIFIED))
+static void
+commit_diffs_show(CommitDiffs * cd)
+{
+	GtkTextBuffer *buffer = gtk_text_view_get_buffer(cd->textview);
+	const gchar *diff;
+
+	if (!cd->selected)
+		gtk_text_buffer_set_text(buffer, "", -1);
+	else if ((diff = g_hash_table_lookup(cd->diffs, cd->selected)) != NULL)
+		set_diff_buff(GTK_WIDGET(cd->textview), buffer, diff);
+	else if (g_queue_find_custom(&cd->pending, cd->selected, (GCompareFunc) g_strcmp0))
+		gtk_text_buffer_set_text(buffer, _("Loading differences..."), -1);
+	else
 	{
-		g_free(status);
-		return FALSE;
+		GSList *item;
+
+		foreach_slist(item, cd->running)
+		{
+			if (utils_str_equal(((CommitDiffJob *) item->data)->path, cd->selected))
+			{
+				gtk_text_buffer_set_text(buffer, _("Loading differences..."), -1);
+				return;
+			}
+		}
+		/* added, deleted or unknown files */
+		gtk_text_buffer_set_text(buffer, "", -1);
 	}
+}
 
-	gtk_tree_model_get(model, iter, COLUMN_PATH, &filename, -1);
+static void
+commit_diff_job_free(CommitDiffJob * dj)
+{
+	if (dj->cd)
+		dj->cd->running = g_slist_remove(dj->cd->running, dj);
+	g_string_free(dj->output, TRUE);
+	g_free(dj->path);
+	g_free(dj);
+}
 
-	vc = find_vc(filename);
-	g_return_val_if_fail(vc, FALSE);
+static void commit_diffs_start(CommitDiffs * cd);
 
-	execute_command(vc, &tmp, NULL, filename, VC_COMMAND_DIFF_FILE, NULL, NULL);
-	if (tmp)
-	{
-		/* We temporarily add the filename to the diff output for parsing the diff output later,
-		 * after we have finished parsing, we apply the tag "invisible" which hides the text. */
-		g_string_append_printf(diff, "VC_DIFF%s\n", filename);
-		g_string_append(diff, tmp);
-		g_free(tmp);
-	}
-	else
+static void
+on_commit_diff_output(G_GNUC_UNUSED VCJob * job, const gchar * text, gpointer user_data)
+{
+	CommitDiffJob *dj = user_data;
+
+	g_string_append(dj->output, text);
+}
+
+static void
+on_commit_diff_done(G_GNUC_UNUSED VCJob * job, G_GNUC_UNUSED gint exit_code,
+		    G_GNUC_UNUSED const gchar * std_err, gpointer user_data)
+{
+	CommitDiffJob *dj = user_data;
+	CommitDiffs *cd = dj->cd;
+
+	if (dj->output->len == 0)
+		g_warning("error: geanyvc: on_commit_diff_done: empty diff output");
+
+	g_hash_table_insert(cd->diffs, g_strdup(dj->path), g_strdup(dj->output->str));
+	if (utils_str_equal(dj->path, cd->selected))
+		commit_diffs_show(cd);
+
+	/* dj is freed once we return, start the next one when it's gone */
+	cd->running = g_slist_remove(cd->running, dj);
+	commit_diffs_start(cd);
+}
+
+static void
+commit_diffs_start(CommitDiffs * cd)
+{
+	while (!g_queue_is_empty(&cd->pending) && g_slist_length(cd->running) < COMMIT_DIFF_JOBS)
 	{
-		g_warning("error: geanyvc: get_commit_diff_foreach: empty diff output");
+		CommitDiffJob *dj = g_new0(CommitDiffJob, 1);
+
+		dj->cd = cd;
+		dj->path = g_queue_pop_head(&cd->pending);
+		dj->output = g_string_new(NULL);
+		cd->running = g_slist_prepend(cd->running, dj);
+
+		dj->job = execute_command_async(cd->vc, dj->path, VC_COMMAND_DIFF_FILE, NULL, NULL,
+						on_commit_diff_output, on_commit_diff_done, dj,
+						(GDestroyNotify) commit_diff_job_free);
 	}
-	g_free(filename);
-	return FALSE;
 }
 
-static gchar *
-get_commit_diff(GtkTreeView * treeview)
+static CommitDiffs *
+commit_diffs_new(GtkTreeView * treeview, GtkTextView * textview, const VC_RECORD * vc)
 {
 	GtkTreeModel *model = gtk_tree_view_get_model(treeview);
-	GString *ret = g_string_new(NULL);
+	CommitDiffs *cd = g_new0(CommitDiffs, 1);
+
+	cd->treeview = treeview;
+	cd->textview = textview;
+	cd->vc = vc;
+	cd->diffs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	g_queue_init(&cd->pending);
 
-	gtk_tree_model_foreach(model, get_commit_diff_foreach, ret);
+	gtk_tree_model_foreach(model, get_modified_files_foreach, &cd->pending);
 
-	return g_string_free(ret, FALSE);
+	commit_diffs_start(cd);
+	return cd;
+}
+
+static void
+commit_diffs_select(CommitDiffs * cd, const gchar * path)
+{
+	GList *item;
+
+	SETPTR(cd->selected, g_strdup(path));
+
+	/* diff the selected file next */
+	item = g_queue_find_custom(&cd->pending, path, (GCompareFunc) g_strcmp0);
+	if (item)
+	{
+		gpointer data = item->data;
+
+		g_queue_delete_link(&cd->pending, item);
+		g_queue_push_head(&cd->pending, data);
+	}
+
+	commit_diffs_show(cd);
+}
+
+static void
+commit_diffs_free(CommitDiffs * cd)
+{
+	g_signal_handlers_disconnect_by_data(gtk_tree_view_get_selection(cd->treeview), cd);
+	while (cd->running)
+	{
+		CommitDiffJob *dj = cd->running->data;
+
+		/* cancelling frees dj, possibly only once the command has gone */
+		cd->running = g_slist_delete_link(cd->running, cd->running);
+		dj->cd = NULL;
+		vc_job_cancel(dj->job);
+	}
+	g_queue_foreach(&cd->pending, (GFunc) g_free, NULL);
+	g_queue_clear(&cd->pending);
+	g_hash_table_destroy(cd->diffs);
+	g_free(cd->selected);
+	g_free(cd);
 }
 
 static void
 set_diff_buff(GtkWidget * textview, GtkTextBuffer * buffer, const gchar * txt)
 {
 	GtkTextIter start, end;
-	GtkTextMark *mark;
-	gchar *filename;
 	const gchar *tagname = "";
-	const gchar *c, *p = txt;
+	const gchar *p = txt;
 
 	if (strlen(txt) > COMMIT_DIFF_MAXLENGTH)
 	{
@@ -1193,7 +1999,6 @@ set_diff_buff(GtkWidget * textview, GtkTextBuffer * buffer, const gchar * txt)
 
 	while (p)
 	{
-		c = NULL;
 		if (*p == '-')
 		{
 			tagname = "deleted";
@@ -1206,14 +2011,6 @@ set_diff_buff(GtkWidget * textview, GtkTextBuffer * buffer, const gchar * txt)
 		{
 			tagname = "";
 		}
-		else if (strncmp(p, "VC_DIFF", 7) == 0)
-		{   /* Lines starting with VC_DIFF are special and were added by our code to tell about
-			 * filename to which the following diff lines belong. We use this file to create
-			 * text marks which we then later use to scroll to if the corresponding file has been
-			 * selected in the commit dialog's files list. */
-			tagname = "invisible";
-			c = strchr(p + 7, '\n');
-		}
 		else
 		{
 			tagname = "default";
@@ -1221,18 +2018,6 @@ set_diff_buff(GtkWidget * textview, GtkTextBuffer * buffer, const gchar * txt)
 		gtk_text_buffer_get_iter_at_offset(buffer, &start,
 						   g_utf8_pointer_to_offset(txt, p));
 
-		if (c)
-		{   /* create the mark *after* the start iter has been updated */
-			filename = g_strndup(p + 7, c - p - 7);
-			/* delete old text marks */
-			mark = gtk_text_buffer_get_mark(buffer, filename);
-			if (mark)
-				gtk_text_buffer_delete_mark(buffer, mark);
-			/* create a new one */
-			gtk_text_buffer_create_mark(buffer, filename, &start, TRUE);
-			g_free(filename);
-		}
-
 		p = strchr(p, '\n');
 		if (p)
 		{
@@ -1247,16 +2032,6 @@ set_diff_buff(GtkWidget * textview, GtkTextBuffer * buffer, const gchar * txt)
 	}
 }
 
-static void
-refresh_diff_view(GtkTreeView *treeview)
-{
-	gchar *diff;
-	GtkWidget *diffView = ui_lookup_widget(GTK_WIDGET(treeview), "textDiff");
-	diff = get_commit_diff(GTK_TREE_VIEW(treeview));
-	set_diff_buff(diffView, gtk_text_view_get_buffer(GTK_TEXT_VIEW(diffView)), diff);
-	g_free(diff);
-}
-
 static void
 commit_toggle_commit(GtkTreeView *treeview, gchar * path_str)
 {
@@ -1264,13 +2039,10 @@ commit_toggle_commit(GtkTreeView *treeview, gchar * path_str)
 	GtkTreeIter iter;
 	GtkTreePath *path = gtk_tree_path_new_from_string(path_str);
 	gboolean fixed;
-	gchar *filename;
-	GtkTextView *diffView = GTK_TEXT_VIEW(ui_lookup_widget(GTK_WIDGET(treeview), "textDiff"));
-	GtkTextMark *mark;
 
 	/* get toggled iter */
 	gtk_tree_model_get_iter(model, &iter, path);
-	gtk_tree_model_get(model, &iter, COLUMN_COMMIT, &fixed, COLUMN_PATH, &filename, -1);
+	gtk_tree_model_get(model, &iter, COLUMN_COMMIT, &fixed, -1);
 
 	/* do something with the value */
 	fixed ^= 1;
@@ -1278,18 +2050,8 @@ commit_toggle_commit(GtkTreeView *treeview, gchar * path_str)
 	/* set new value */
 	gtk_list_store_set(GTK_LIST_STORE(model), &iter, COLUMN_COMMIT, fixed, -1);
 
-	if (! fixed)
-	{
-		mark = gtk_text_buffer_get_mark(gtk_text_view_get_buffer(diffView), filename);
-		if (mark)
-			gtk_text_buffer_delete_mark(gtk_text_view_get_buffer(diffView), mark);
-	}
-
-	refresh_diff_view(treeview);
-
 	/* clean up */
 	gtk_tree_path_free(path);
-	g_free(filename);
 }
 
 static void
@@ -1314,8 +2076,6 @@ commit_all_toggled_cb(GtkToggleButton *check_box, gpointer treeview)
 	gint toggled = gtk_toggle_button_get_active(check_box);
 
 	gtk_tree_model_foreach(model, toggle_all_commit_files, &toggled);
-
-	refresh_diff_view(treeview);
 }
 
 static void
@@ -1372,25 +2132,17 @@ get_diff_color(G_GNUC_UNUSED GeanyDocument * doc, gint style)
 #define GLADE_HOOKUP_OBJECT_NO_REF(component,widget,name) \
   g_object_set_data (G_OBJECT (component), name, widget)
 
-static void commit_tree_selection_changed_cb(GtkTreeSelection *sel, GtkTextView *textview)
+static void commit_tree_selection_changed_cb(GtkTreeSelection *sel, CommitDiffs *cd)
 {
 	GtkTreeModel *model;
 	GtkTreeIter iter;
-	GtkTextMark *mark;
 	gchar *path;
-	gboolean set;
 
 	if (! gtk_tree_selection_get_selected(sel, &model, &iter))
 		return;
 
-	gtk_tree_model_get(model, &iter, COLUMN_COMMIT, &set, COLUMN_PATH, &path, -1);
-
-	if (set)
-	{
-		mark = gtk_text_buffer_get_mark(gtk_text_view_get_buffer(textview), path);
-		if (mark)
-			gtk_text_view_scroll_to_mark(textview, mark, 0.0, TRUE, 0.0, 0.0);
-	}
+	gtk_tree_model_get(model, &iter, COLUMN_PATH, &path, -1);
+	commit_diffs_select(cd, path);
 	g_free(path);
 }
 
@@ -1686,7 +2438,6 @@ create_commitDialog(void)
 
 	sel = gtk_tree_view_get_selection(GTK_TREE_VIEW(treeSelect));
 	gtk_tree_selection_set_mode(sel, GTK_SELECTION_SINGLE);
-	g_signal_connect(sel, "changed", G_CALLBACK(commit_tree_selection_changed_cb), textDiff);
 
 	g_signal_connect(treeSelect, "key-release-event",
 		G_CALLBACK(commit_tree_view_key_release_cb), NULL);
@@ -1764,11 +2515,12 @@ vccommit_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 
 	GtkTextIter begin;
 	GtkTextIter end;
+	GtkTreeIter iter;
 	GSList *selected_files = NULL;
+	CommitDiffs *diffs;
 
 	gchar *dir;
 	gchar *message;
-	gchar *diff;
 
 	gint height;
 
@@ -1782,7 +2534,7 @@ vccommit_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 	g_return_if_fail(doc->file_name);
 	vc = find_vc(doc->file_name);
 	g_return_if_fail(vc);
-	dir = vc->get_base_dir(doc->file_name);
+	dir = find_base_dir(vc, doc->file_name);
 
 	lst = vc->get_commit_files(dir);
 	if (!lst)
@@ -1799,7 +2551,6 @@ vccommit_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 	/* add columns to the tree view */
 	add_commit_columns(GTK_TREE_VIEW(treeview));
 
-	diff = get_commit_diff(GTK_TREE_VIEW(treeview));
 	diffbuf = gtk_text_view_get_buffer(GTK_TEXT_VIEW(diffView));
 
 	gtk_text_buffer_create_tag(diffbuf, "deleted", "foreground-gdk",
@@ -1811,10 +2562,14 @@ vccommit_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 	gtk_text_buffer_create_tag(diffbuf, "default", "foreground-gdk",
 				   get_diff_color(doc, SCE_DIFF_POSITION), NULL);
 
-	gtk_text_buffer_create_tag(diffbuf, "invisible", "invisible",
-				   TRUE, NULL);
-
-	set_diff_buff(diffView, diffbuf, diff);
+	/* the diffs show up while the dialog is already open, each one only
+	 * once its file gets selected */
+	diffs = commit_diffs_new(GTK_TREE_VIEW(treeview), GTK_TEXT_VIEW(diffView), vc);
+	g_signal_connect(gtk_tree_view_get_selection(GTK_TREE_VIEW(treeview)), "changed",
+		G_CALLBACK(commit_tree_selection_changed_cb), diffs);
+	if (gtk_tree_model_get_iter_first(model, &iter))
+		gtk_tree_selection_select_iter(
+			gtk_tree_view_get_selection(GTK_TREE_VIEW(treeview)), &iter);
 
 	if (set_maximize_commit_dialog)
 	{
@@ -1862,6 +2617,7 @@ vccommit_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 
 			exit_code = execute_command(vc, NULL, &err_output, dir, VC_COMMAND_COMMIT, selected_files,
 					message);
+			vc_cache_clear();
 
 			if (err_output)
 			{
@@ -1887,10 +2643,10 @@ vccommit_activated(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer
 	gtk_window_get_size(GTK_WINDOW(commit),
 		&commit_dialog_width, &commit_dialog_height);
 
+	commit_diffs_free(diffs);
 	gtk_widget_destroy(commit);
 	free_commit_list(lst);
 	g_free(dir);
-	g_free(diff);
 }
 
 typedef struct _VCFileMenu
@@ -2390,6 +3146,8 @@ registrate(void)
 	REGISTER_VC(SVK, enable_svk);
 	REGISTER_VC(BZR, enable_bzr);
 	REGISTER_VC(HG, enable_hg);
+
+	vc_cache_clear();
 }
 
 static void
@@ -2681,6 +3439,9 @@ plugin_init(G_GNUC_UNUSED GeanyData * data)
 	load_config();
 	registrate();
 
+	/* running commands report back through callbacks into this module */
+	plugin_module_make_resident(geany_plugin);
+
 	external_diff_viewer_init();
 
 	if (set_menubar_entry == TRUE)
@@ -2758,6 +3519,7 @@ void
 plugin_cleanup(void)
 {
 	save_config();
+	vc_cancel_all_jobs();
 	external_diff_viewer_deinit();
 	remove_menuitems_from_editor_menu();
 	gtk_widget_destroy(menu_entry);
@@ -2768,6 +3530,7 @@ plugin_cleanup(void)
 	}
 	g_slist_free(VC);
 	VC = NULL;
+	vc_cache_free();
 	g_slist_free_full(commit_message_history, g_free);
 	g_free(config_file);
 }
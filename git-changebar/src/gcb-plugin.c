@@ -77,9 +77,9 @@ PLUGIN_SET_TRANSLATABLE_INFO (
 )
 
 
-/* g_async_queue_push() doesn't allow for NULL data, so use a non-NULL fake
- * data that we know cannot ever be a valid job */
-#define QUIT_THREAD_JOB ((AsyncBlobContentsJob *) (&G_queue))
+/* number of threads fetching blobs, jobs for different repositories run in
+ * parallel */
+#define BLOB_WORKER_THREADS 4
 
 #define RESOURCES_ALLOCATED_QTAG \
   (g_quark_from_string (PLUGIN"/git-resources-allocated"))
@@ -87,10 +87,15 @@ PLUGIN_SET_TRANSLATABLE_INFO (
   (g_quark_from_string (PLUGIN"/git-undo-line"))
 #define DOC_ID_QTAG \
   (g_quark_from_string (PLUGIN"/git-doc-id"))
+#define DIFF_STATE_QTAG \
+  (g_quark_from_string (PLUGIN"/git-diff-state"))
 
 #define REMOVED_MARKER_POS(pos) \
     ((pos) == 0 ? 0 : (pos) - 1)
 
+/* maximum number of HEAD blobs kept around for quick tab switching */
+#define BLOB_CACHE_MAX_ENTRIES 32
+
 enum {
   MARKER_LINE_ADDED,
   MARKER_LINE_CHANGED,
@@ -112,13 +117,77 @@ typedef void (*BlobContentsReadyFunc) (const gchar *path,
 typedef struct AsyncBlobContentsJob AsyncBlobContentsJob;
 struct AsyncBlobContentsJob {
   gboolean              force;
-  guint                 tag;
+  guint                 generation; /* repository generation at read time */
   gchar                *path;
+  gchar                *workdir;
+  gchar                *relpath;
+  git_oid               commit_id;
   git_buf               buf;
   BlobContentsReadyFunc callback;
   gpointer              user_data;
 };
 
+/* a filtered HEAD blob, identified by the repository, the path inside it and
+ * the commit it was read from */
+typedef struct CachedBlob CachedBlob;
+struct CachedBlob {
+  gchar  *path; /* system path, the lookup key */
+  gchar  *workdir;
+  gchar  *relpath;
+  git_oid commit_id;
+  git_buf buf;
+  guint   serial;       /* unique for the lifetime of the plugin */
+  GArray *line_starts;  /* offsets of each line in @buf, computed lazily */
+  gint    ref_count;
+};
+
+/* an open repository, shared by all the documents inside its workdir */
+typedef struct RepoEntry RepoEntry;
+struct RepoEntry {
+  GMutex          lock;         /* protects all but @workdir and @stale */
+  gchar          *workdir;      /* immutable */
+  git_repository *repo;
+  GFileMonitor   *monitors[2];
+  gint            stale;        /* whether @repo has to be reopened */
+  gint            generation;   /* bumped each time the repository changes */
+};
+
+typedef struct DiffHunk DiffHunk;
+struct DiffHunk {
+  gint old_start;
+  gint old_lines;
+  gint new_start;
+  gint new_lines;
+};
+
+/* per-document state of the last diff, so only what was edited since needs
+ * to be diffed again */
+typedef struct DiffState DiffState;
+struct DiffState {
+  gboolean  valid;        /* whether @hunks can be updated incrementally */
+  guint     blob_serial;  /* serial of the blob @hunks were computed against */
+  GArray   *hunks;        /* DiffHunk, in document order */
+  gint      dirty_start;  /* first edited line since last update, or -1 */
+  gint      dirty_end;    /* last edited line since last update (inclusive) */
+  guint     version;      /* bumped on each edit, unique across documents */
+  guint     pending_version;      /* version being diffed, or 0 */
+  guint     pending_blob_serial;  /* blob being diffed against */
+};
+
+/* a full diff computed in the background against a snapshot of the document */
+typedef struct AsyncDiffJob AsyncDiffJob;
+struct AsyncDiffJob {
+  guint       doc_id;
+  guint       version;
+  CachedBlob *blob;
+  gchar      *buf;
+  gsize       len;
+  gboolean    has_bom;
+  gchar      *encoding;
+  GArray     *hunks;
+  int         status;
+};
+
 typedef struct TooltipHunkData TooltipHunkData;
 struct TooltipHunkData {
   gint            line;
@@ -150,11 +219,21 @@ struct UndoHunkData {
   gint     new_lines;
 };
 
-static void         on_git_repo_changed         (GFileMonitor     *monitor,
+static void         get_cached_blob_contents_async
+                                                (const gchar          *path,
+                                                 gboolean              force,
+                                                 BlobContentsReadyFunc callback,
+                                                 gpointer              user_data);
+static void         on_git_head_changed         (GFileMonitor     *monitor,
                                                  GFile            *file,
                                                  GFile            *other_file,
                                                  GFileMonitorEvent event_type,
-                                                 gpointer          force);
+                                                 gpointer          entry);
+static void         on_git_ref_changed          (GFileMonitor     *monitor,
+                                                 GFile            *file,
+                                                 GFile            *other_file,
+                                                 GFileMonitorEvent event_type,
+                                                 gpointer          entry);
 static gboolean     on_sci_query_tooltip        (GtkWidget   *widget,
                                                  gint         x,
                                                  gint         y,
@@ -180,11 +259,18 @@ static void         write_setting_boolean       (GKeyFile      *kf,
 
 
 /* cache */
-static git_buf          G_blob_contents       = { 0 };
-static guint            G_blob_contents_tag   = 0;
+static GQueue           G_blob_cache          = G_QUEUE_INIT; /* MRU first */
+static GHashTable      *G_blob_cache_table    = NULL; /* path -> GList */
+static guint            G_blob_cache_serial   = 0;
+static guint            G_diff_state_version  = 0;
 /* global state */
-static GAsyncQueue     *G_queue               = NULL;
-static GThread         *G_thread              = NULL;
+static GThreadPool     *G_blob_pool           = NULL;
+static gint             G_blob_pool_quitting  = FALSE;
+static GMutex           G_repos_lock;
+static GPtrArray       *G_repos               = NULL; /* RepoEntry */
+static GHashTable      *G_repo_dirs           = NULL; /* dir -> RepoEntry */
+static GThreadPool     *G_diff_pool           = NULL;
+static gint             G_diff_pool_quitting  = FALSE;
 static gulong           G_source_id           = 0;
 static gboolean         G_monitoring_enabled  = TRUE;
 static GtkWidget       *G_undo_menu_item      = NULL;
@@ -238,14 +324,225 @@ buf_zero (git_buf *buf)
   }
 }
 
+static CachedBlob *
+cached_blob_ref (CachedBlob *blob)
+{
+  g_atomic_int_inc (&blob->ref_count);
+  
+  return blob;
+}
+
+/* blobs are referenced by the cache and by the diff jobs using them */
+static void
+cached_blob_unref (CachedBlob *blob)
+{
+  if (g_atomic_int_dec_and_test (&blob->ref_count)) {
+    if (blob->buf.ptr) {
+      git_buf_dispose (&blob->buf);
+    }
+    if (blob->line_starts) {
+      g_array_free (blob->line_starts, TRUE);
+    }
+    g_free (blob->path);
+    g_free (blob->workdir);
+    g_free (blob->relpath);
+    g_slice_free1 (sizeof *blob, blob);
+  }
+}
+
+/* marks blobs being read from the repository at @workdir, or from any
+ * repository if @workdir is NULL, as outdated */
+static void
+bump_repo_generations (const gchar *workdir)
+{
+  if (G_repos) {
+    guint i;
+    
+    g_mutex_lock (&G_repos_lock);
+    for (i = 0; i < G_repos->len; i++) {
+      RepoEntry *entry = g_ptr_array_index (G_repos, i);
+      
+      if (! workdir || strcmp (entry->workdir, workdir) == 0) {
+        g_atomic_int_inc (&entry->generation);
+      }
+    }
+    g_mutex_unlock (&G_repos_lock);
+  }
+}
+
+/* checks whether the repository at @workdir changed since @generation */
+static gboolean
+repo_generation_changed (const gchar *workdir,
+                         guint        generation)
+{
+  gboolean changed = FALSE;
+  
+  if (G_repos) {
+    guint i;
+    
+    g_mutex_lock (&G_repos_lock);
+    for (i = 0; i < G_repos->len; i++) {
+      RepoEntry *entry = g_ptr_array_index (G_repos, i);
+      
+      if (strcmp (entry->workdir, workdir) == 0) {
+        changed = (guint) g_atomic_int_get (&entry->generation) != generation;
+        break;
+      }
+    }
+    g_mutex_unlock (&G_repos_lock);
+  }
+  
+  return changed;
+}
+
 static void
 clear_cached_blob_contents (void)
 {
-  if (G_blob_contents.ptr) {
-    git_buf_dispose (&G_blob_contents);
-    buf_zero (&G_blob_contents);
+  CachedBlob *blob;
+  
+  bump_repo_generations (NULL);
+  if (G_blob_cache_table) {
+    g_hash_table_remove_all (G_blob_cache_table);
+  }
+  while ((blob = g_queue_pop_head (&G_blob_cache))) {
+    cached_blob_unref (blob);
+  }
+}
+
+static void
+remove_cached_blob_link (GList *link)
+{
+  CachedBlob *blob = link->data;
+  
+  g_hash_table_remove (G_blob_cache_table, blob->path);
+  g_queue_delete_link (&G_blob_cache, link);
+  cached_blob_unref (blob);
+}
+
+/* gets the cached HEAD blob for @path, and marks it as most recently used */
+static CachedBlob *
+lookup_cached_blob (const gchar *path)
+{
+  GList *link;
+  
+  if (! path || ! G_blob_cache_table ||
+      ! (link = g_hash_table_lookup (G_blob_cache_table, path))) {
+    return NULL;
+  }
+  
+  if (link != G_blob_cache.head) {
+    g_queue_unlink (&G_blob_cache, link);
+    g_queue_push_head_link (&G_blob_cache, link);
+  }
+  
+  return link->data;
+}
+
+/* drops the cached blobs coming from the repository at @workdir */
+static void
+clear_cached_blob_contents_for_workdir (const gchar *workdir)
+{
+  GList *link = G_blob_cache.head;
+  
+  bump_repo_generations (workdir);
+  while (link) {
+    GList      *next = link->next;
+    CachedBlob *blob = link->data;
+    
+    if (g_strcmp0 (blob->workdir, workdir) == 0) {
+      remove_cached_blob_link (link);
+    }
+    link = next;
+  }
+}
+
+static void
+remove_cached_blob (const gchar *path)
+{
+  GList *link;
+  
+  if (path && G_blob_cache_table &&
+      (link = g_hash_table_lookup (G_blob_cache_table, path))) {
+    remove_cached_blob_link (link);
+  }
+}
+
+/* checks whether @blob was read from the same file at the same commit as
+ * @job's, in which case the contents are the same */
+static gboolean
+cached_blob_matches_job (const CachedBlob           *blob,
+                         const AsyncBlobContentsJob *job)
+{
+  return (g_strcmp0 (blob->workdir, job->workdir) == 0 &&
+          g_strcmp0 (blob->relpath, job->relpath) == 0 &&
+          git_oid_equal (&blob->commit_id, &job->commit_id));
+}
+
+/* moves the job's blob into the cache, evicting the least recently used entry
+ * if necessary, and returns the cached entry.  If the cached entry for the
+ * same path already holds the same blob it is kept, so its serial doesn't
+ * change and diffs computed against it remain valid */
+static CachedBlob *
+insert_cached_blob (AsyncBlobContentsJob *job)
+{
+  CachedBlob *blob = lookup_cached_blob (job->path);
+  
+  if (blob && cached_blob_matches_job (blob, job)) {
+    git_buf_dispose (&job->buf);
+    buf_zero (&job->buf);
+    
+    return blob;
+  }
+  
+  if (! G_blob_cache_table) {
+    G_blob_cache_table = g_hash_table_new (g_str_hash, g_str_equal);
+  }
+  
+  blob = g_slice_alloc (sizeof *blob);
+  remove_cached_blob (job->path);
+  while (G_blob_cache.length >= BLOB_CACHE_MAX_ENTRIES) {
+    remove_cached_blob_link (G_blob_cache.tail);
+  }
+  
+  blob->path        = g_strdup (job->path);
+  blob->workdir     = job->workdir;
+  blob->relpath     = job->relpath;
+  blob->buf         = job->buf;
+  blob->serial      = ++ G_blob_cache_serial;
+  blob->line_starts = NULL;
+  blob->ref_count   = 1;
+  git_oid_cpy (&blob->commit_id, &job->commit_id);
+  
+  job->workdir  = NULL;
+  job->relpath  = NULL;
+  buf_zero (&job->buf);
+  
+  g_queue_push_head (&G_blob_cache, blob);
+  g_hash_table_insert (G_blob_cache_table, blob->path, G_blob_cache.head);
+  
+  return blob;
+}
+
+/* gets the offset of the start of each line in the blob.  Lines are split the
+ * same way Git does, on LF */
+static const GArray *
+cached_blob_get_line_starts (CachedBlob *blob)
+{
+  if (! blob->line_starts) {
+    gsize i;
+    gsize start = 0;
+    
+    blob->line_starts = g_array_new (FALSE, FALSE, sizeof (gsize));
+    g_array_append_val (blob->line_starts, start);
+    for (i = 0; i < blob->buf.size; i++) {
+      if (blob->buf.ptr[i] == '\n') {
+        start = i + 1;
+        g_array_append_val (blob->line_starts, start);
+      }
+    }
   }
-  G_blob_contents_tag = 0;
+  
+  return blob->line_starts;
 }
 
 /* similar to old git_blob_filtered_content() but makes sure the caller owns
@@ -296,11 +593,12 @@ get_blob_contents (git_buf     *out,
 #endif
 }
 
-/* get the file blob for @relpath at HEAD */
+/* get the file blob for @relpath at HEAD, and the ID of the HEAD commit */
 static gboolean
 repo_get_file_blob_contents (git_repository  *repo,
                              const gchar     *relpath,
                              git_buf         *contents,
+                             git_oid         *commit_id,
                              int              check_for_binary_data)
 {
   git_reference  *head    = NULL;
@@ -309,7 +607,8 @@ repo_get_file_blob_contents (git_repository  *repo,
   if (git_repository_head (&head, repo) == 0) {
     git_commit *commit = NULL;
     
-    if (git_commit_lookup (&commit, repo, git_reference_target (head)) == 0) {
+    git_oid_cpy (commit_id, git_reference_target (head));
+    if (git_commit_lookup (&commit, repo, commit_id) == 0) {
       git_tree *tree = NULL;
       
       if (git_commit_tree (&tree, commit) == 0) {
@@ -345,6 +644,8 @@ free_job (gpointer data)
     git_buf_dispose (&job->buf);
   }
   g_free (job->path);
+  g_free (job->workdir);
+  g_free (job->relpath);
   g_slice_free1 (sizeof *job, job);
 }
 
@@ -353,14 +654,21 @@ report_work_in_idle (gpointer data)
 {
   AsyncBlobContentsJob *job = data;
   
-  /* update cached blob */
-  clear_cached_blob_contents ();
-  G_blob_contents = job->buf;
-  G_blob_contents_tag = job->buf.ptr ? job->tag : 0;
-  
-  job->callback (job->path, job->buf.ptr ? &job->buf : NULL, job->user_data);
-  
-  buf_zero (&job->buf);
+  if (job->buf.ptr &&
+      repo_generation_changed (job->workdir, job->generation)) {
+    /* the repository changed while the blob was read, so it might be
+     * outdated.  Fetch it again rather than reporting contents that can't
+     * be cached */
+    get_cached_blob_contents_async (job->path, FALSE, job->callback,
+                                    job->user_data);
+  } else if (job->buf.ptr) {
+    CachedBlob *blob = insert_cached_blob (job);
+    
+    job->callback (job->path, &blob->buf, job->user_data);
+  } else {
+    remove_cached_blob (job->path);
+    job->callback (job->path, NULL, job->user_data);
+  }
   
   return FALSE;
 }
@@ -462,110 +770,207 @@ get_path_in_repository (git_repository *repo,
 #endif
 }
 
-static gpointer
-worker_thread (gpointer data)
+static void
+repo_entry_close (RepoEntry *entry)
 {
-  GAsyncQueue          *queue       = data;
-  git_repository       *repo        = NULL;
-  GFileMonitor         *monitors[2] = { NULL, NULL };
-  AsyncBlobContentsJob *job;
-  guint                 i;
+  guint i;
   
-  while ((job = g_async_queue_pop (queue)) != QUIT_THREAD_JOB) {
-    const gchar *path = job->path;
-    
-    if (repo && (job->force ||
-                 ! path_dir_contains (path, git_repository_workdir (repo)))) {
-      /* FIXME: this can fail with nested repositories */
+  for (i = 0; i < G_N_ELEMENTS (entry->monitors); i++) {
+    if (entry->monitors[i]) {
+      g_object_unref (entry->monitors[i]);
+      entry->monitors[i] = NULL;
+    }
+  }
+  if (entry->repo) {
+    git_repository_free (entry->repo);
+    entry->repo = NULL;
+  }
+}
+
+/* sets @repo as the repository of @entry, and starts monitoring it.
+ * Must be called with the entry lock held */
+static void
+repo_entry_set_repository (RepoEntry      *entry,
+                           git_repository *repo)
+{
+  repo_entry_close (entry);
+  entry->repo = repo;
+  if (repo && G_monitoring_enabled) {
+    /* we need to monitor HEAD, in case of e.g. branch switch (e.g.
+     * git checkout -b will switch the ref we need to watch) */
+    entry->monitors[0] = monitor_repo_file (repo, "HEAD",
+                                            G_CALLBACK (on_git_head_changed),
+                                            entry);
+    /* and of course the real ref (branch) for when changes get committed */
+    entry->monitors[1] = monitor_head_ref (repo,
+                                           G_CALLBACK (on_git_ref_changed),
+                                           entry);
+  }
+}
+
+static void
+repo_entry_free (gpointer data)
+{
+  RepoEntry *entry = data;
+  
+  repo_entry_close (entry);
+  g_mutex_clear (&entry->lock);
+  g_free (entry->workdir);
+  g_slice_free1 (sizeof *entry, entry);
+}
+
+/* gets the repository entry for the file at @path, opening the repository if
+ * necessary.  Entries live until the plugin is unloaded */
+static RepoEntry *
+get_repo_entry (const gchar *path)
+{
+  gchar          *dirname = g_path_get_dirname (path);
+  git_repository *repo    = NULL;
+  RepoEntry      *entry;
+  
+  g_mutex_lock (&G_repos_lock);
+  entry = g_hash_table_lookup (G_repo_dirs, dirname);
+  g_mutex_unlock (&G_repos_lock);
+  
+  /* the directory -> repository mapping handles nested repositories, as
+   * libgit2 finds the closest one for us */
+  if (! entry && git_repository_open_ext (&repo, dirname, 0, NULL) == 0) {
+    if (git_repository_is_bare (repo)) {
       git_repository_free (repo);
-      repo = NULL;
-      for (i = 0; i < G_N_ELEMENTS (monitors); i++) {
-        if (monitors[i]) {
-          g_object_unref (monitors[i]);
-          monitors[i] = NULL;
+    } else {
+      const gchar *workdir = git_repository_workdir (repo);
+      guint        i;
+      
+      g_mutex_lock (&G_repos_lock);
+      for (i = 0; ! entry && i < G_repos->len; i++) {
+        RepoEntry *e = g_ptr_array_index (G_repos, i);
+        
+        if (strcmp (e->workdir, workdir) == 0) {
+          entry = e;
         }
       }
-    }
-    if (! repo) {
-      gchar *dirname = g_path_get_dirname (path);
-      if (git_repository_open_ext (&repo, dirname, 0, NULL) == 0) {
-        if (git_repository_is_bare (repo)) {
-          git_repository_free (repo);
-          repo = NULL;
-        } else if (G_monitoring_enabled) {
-          /* we need to monitor HEAD, in case of e.g. branch switch (e.g.
-           * git checkout -b will switch the ref we need to watch) */
-          monitors[0] = monitor_repo_file (repo, "HEAD",
-                                           G_CALLBACK (on_git_repo_changed),
-                                           GINT_TO_POINTER (TRUE));
-          /* and of course the real ref (branch) for when changes get committed */
-          monitors[1] = monitor_head_ref (repo, G_CALLBACK (on_git_repo_changed),
-                                          GINT_TO_POINTER (FALSE));
-        }
+      if (entry) {
+        /* already open, possibly by another thread meanwhile */
+        git_repository_free (repo);
+      } else {
+        entry = g_slice_alloc0 (sizeof *entry);
+        g_mutex_init (&entry->lock);
+        entry->workdir = g_strdup (workdir);
+        entry->stale = FALSE;
+        entry->generation = 0;
+        g_mutex_lock (&entry->lock);
+        repo_entry_set_repository (entry, repo);
+        g_mutex_unlock (&entry->lock);
+        g_ptr_array_add (G_repos, entry);
       }
-      g_free(dirname);
+      g_hash_table_insert (G_repo_dirs, g_strdup (dirname), entry);
+      g_mutex_unlock (&G_repos_lock);
     }
+  }
+  g_free (dirname);
+  
+  return entry;
+}
+
+/* makes sure all open repositories are reopened before next use, e.g. after
+ * monitoring settings changed */
+static void
+mark_repos_stale (void)
+{
+  if (G_repos) {
+    guint i;
     
-    buf_zero (&job->buf);
-    if (repo) {
-      gchar *relpath = get_path_in_repository (repo, path);
+    g_mutex_lock (&G_repos_lock);
+    for (i = 0; i < G_repos->len; i++) {
+      RepoEntry *entry = g_ptr_array_index (G_repos, i);
+      
+      g_atomic_int_set (&entry->stale, TRUE);
+    }
+    g_mutex_unlock (&G_repos_lock);
+  }
+}
+
+static void
+blob_worker_func (gpointer data,
+                  gpointer user_data)
+{
+  AsyncBlobContentsJob *job = data;
+  RepoEntry            *entry;
+  
+  if (g_atomic_int_get (&G_blob_pool_quitting)) {
+    free_job (job);
+    return;
+  }
+  
+  buf_zero (&job->buf);
+  if ((entry = get_repo_entry (job->path)) != NULL) {
+    g_mutex_lock (&entry->lock);
+    /* read before the blob so a change happening meanwhile is noticed */
+    job->generation = (guint) g_atomic_int_get (&entry->generation);
+    if (g_atomic_int_compare_and_exchange (&entry->stale, TRUE, FALSE) ||
+        job->force || ! entry->repo) {
+      git_repository *repo = NULL;
+      
+      repo_entry_close (entry);
+      if (git_repository_open (&repo, entry->workdir) == 0) {
+        repo_entry_set_repository (entry, repo);
+      }
+    }
+    if (entry->repo) {
+      gchar *relpath = get_path_in_repository (entry->repo, job->path);
       
       if (relpath) {
-        if (! repo_get_file_blob_contents (repo, relpath, &job->buf, 0)) {
+        if (! repo_get_file_blob_contents (entry->repo, relpath, &job->buf,
+                                           &job->commit_id, 0)) {
           git_buf_dispose (&job->buf);
           buf_zero (&job->buf);
+          g_free (relpath);
+        } else {
+          job->workdir = g_strdup (entry->workdir);
+          job->relpath = relpath;
         }
-        
-        g_free (relpath);
       }
     }
-    
-    g_idle_add_full (G_PRIORITY_LOW, report_work_in_idle, job, free_job);
-  }
-  
-  for (i = 0; i < G_N_ELEMENTS (monitors); i++) {
-    if (monitors[i]) {
-      g_object_unref (monitors[i]);
-      monitors[i] = NULL;
-    }
-  }
-  if (repo) {
-    git_repository_free (repo);
+    g_mutex_unlock (&entry->lock);
   }
   
-  return NULL;
+  g_idle_add_full (G_PRIORITY_LOW, report_work_in_idle, job, free_job);
 }
 
 static void
 get_cached_blob_contents_async (const gchar          *path,
-                                guint                 tag,
                                 gboolean              force,
                                 BlobContentsReadyFunc callback,
                                 gpointer              user_data)
 {
-  if ((! force && G_blob_contents.ptr && tag == G_blob_contents_tag) ||
-      ! path) {
-    callback (path, &G_blob_contents, user_data);
+  CachedBlob *blob = force ? NULL : lookup_cached_blob (path);
+  
+  if (! path) {
+    callback (path, NULL, user_data);
+  } else if (blob) {
+    callback (path, &blob->buf, user_data);
   } else {
-    AsyncBlobContentsJob *job = g_slice_alloc (sizeof *job);
+    AsyncBlobContentsJob *job = g_slice_alloc0 (sizeof *job);
     
     job->force      = force;
-    job->tag        = tag;
+    job->generation = 0;
     job->path       = g_strdup (path);
+    job->workdir    = NULL;
+    job->relpath    = NULL;
     job->callback   = callback;
     job->user_data  = user_data;
     buf_zero (&job->buf);
     
-    if (! G_thread) {
-      G_queue = g_async_queue_new ();
-#if GLIB_CHECK_VERSION (2, 32, 0)
-      G_thread = g_thread_new (PLUGIN"/blob-worker", worker_thread, G_queue);
-#else
-      G_thread = g_thread_create (worker_thread, G_queue, FALSE, NULL);
-#endif
+    if (! G_blob_pool) {
+      g_atomic_int_set (&G_blob_pool_quitting, FALSE);
+      G_repos = g_ptr_array_new_with_free_func (repo_entry_free);
+      G_repo_dirs = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                           g_free, NULL);
+      G_blob_pool = g_thread_pool_new (blob_worker_func, NULL,
+                                       BLOB_WORKER_THREADS, FALSE, NULL);
     }
     
-    g_async_queue_push (G_queue, job);
+    g_thread_pool_push (G_blob_pool, job, NULL);
     /* cppcheck-suppress memleak symbolName=job */
   }
 }
@@ -653,6 +1058,7 @@ release_resources (ScintillaObject *sci)
       }
     }
     g_signal_handlers_disconnect_by_func (sci, on_sci_query_tooltip, NULL);
+    g_object_set_qdata (G_OBJECT (sci), DIFF_STATE_QTAG, NULL);
     g_object_set_qdata (G_OBJECT (sci), RESOURCES_ALLOCATED_QTAG, NULL);
   }
 }
@@ -740,31 +1146,32 @@ add_utf8_bom (gchar   **buffer,
   return TRUE;
 }
 
+/* diffs @old_buf against the UTF-8 document contents @doc_buf.  This doesn't
+ * touch the document so it is safe to call from a worker thread */
 static int
-diff_buf_to_doc (const git_buf   *old_buf,
-                 GeanyDocument   *doc,
+diff_buf_to_buf (const git_buf   *old_buf,
+                 const gchar     *doc_buf,
+                 gsize            doc_len,
+                 gboolean         has_bom,
+                 const gchar     *encoding,
                  git_diff_hunk_cb hunk_cb,
                  void            *payload)
 {
-  ScintillaObject  *sci = doc->editor->sci;
   git_diff_options  opts;
-  gchar            *buf;
-  size_t            len;
-  gboolean          free_buf = FALSE;
+  gchar            *buf       = (gchar *) doc_buf;
+  gsize             len       = doc_len;
+  gboolean          free_buf  = FALSE;
   int               ret;
   
-  buf = (gchar *) scintilla_send_message (sci, SCI_GETCHARACTERPOINTER, 0, 0);
-  len = sci_get_length (sci);
-  
   /* add the BOM if needed */
-  if (doc->has_bom) {
+  if (has_bom) {
     /* UTF-8 BOM, converted below */
     free_buf = add_utf8_bom (&buf, &len, free_buf);
   }
   /* convert the buffer back to in-file encoding if necessary */
-  if (encoding_needs_conversion (doc->encoding)) {
+  if (encoding_needs_conversion (encoding)) {
     free_buf = convert_encoding_inplace (&buf, &len, free_buf,
-                                         doc->encoding, "UTF-8", NULL);
+                                         encoding, "UTF-8", NULL);
   }
   
   git_diff_options_init (&opts, GIT_DIFF_OPTIONS_VERSION);
@@ -783,12 +1190,42 @@ diff_buf_to_doc (const git_buf   *old_buf,
   return ret;
 }
 
+static int
+diff_buf_to_doc (const git_buf   *old_buf,
+                 GeanyDocument   *doc,
+                 git_diff_hunk_cb hunk_cb,
+                 void            *payload)
+{
+  ScintillaObject *sci = doc->editor->sci;
+  
+  return diff_buf_to_buf (old_buf,
+                          (const gchar *) scintilla_send_message (sci, SCI_GETCHARACTERPOINTER, 0, 0),
+                          (gsize) sci_get_length (sci),
+                          doc->has_bom, doc->encoding, hunk_cb, payload);
+}
+
+/* collects the hunks in a GArray of DiffHunk */
 static int
 diff_hunk_cb (const git_diff_delta *delta,
               const git_diff_hunk  *hunk,
               void                 *data)
 {
-  ScintillaObject *sci = data;
+  GArray   *hunks = data;
+  DiffHunk  h;
+  
+  h.old_start = hunk->old_start;
+  h.old_lines = hunk->old_lines;
+  h.new_start = hunk->new_start;
+  h.new_lines = hunk->new_lines;
+  g_array_append_val (hunks, h);
+  
+  return 0;
+}
+
+static void
+add_hunk_markers (ScintillaObject *sci,
+                  const DiffHunk  *hunk)
+{
   gint line;
   
   if (hunk->new_lines > 0) {
@@ -802,8 +1239,404 @@ diff_hunk_cb (const git_diff_delta *delta,
     scintilla_send_message (sci, SCI_MARKERADD, line,
                             G_markers[MARKER_LINE_REMOVED].num);
   }
+}
+
+/* removes our markers from lines @start to @end (exclusive) */
+static void
+clear_markers_range (ScintillaObject *sci,
+                     gint             start,
+                     gint             end)
+{
+  gint  mask = 0;
+  gint  line;
+  guint i;
   
-  return 0;
+  for (i = 0; i < MARKER_COUNT; i++) {
+    mask |= 1 << G_markers[i].num;
+  }
+  
+  for (line = start; line < end; line++) {
+    gint line_mask;
+    
+    while ((line_mask = scintilla_send_message (sci, SCI_MARKERGET,
+                                                line, 0) & mask)) {
+      for (i = 0; i < MARKER_COUNT; i++) {
+        if (line_mask & (1 << G_markers[i].num)) {
+          scintilla_send_message (sci, SCI_MARKERDELETE, line,
+                                  G_markers[i].num);
+        }
+      }
+    }
+  }
+}
+
+/* gets the lines (0-based, end exclusive) @hunk covers in the document.
+ * Removal hunks cover the lines on both sides of the removal point */
+static void
+hunk_get_range (const DiffHunk *hunk,
+                gint           *start,
+                gint           *end)
+{
+  if (hunk->new_lines > 0) {
+    *start = hunk->new_start - 1;
+    *end = *start + hunk->new_lines;
+  } else {
+    *start = MAX (hunk->new_start - 1, 0);
+    *end = hunk->new_start + 1;
+  }
+}
+
+static void
+diff_state_free (gpointer data)
+{
+  DiffState *state = data;
+  
+  g_array_free (state->hunks, TRUE);
+  g_slice_free1 (sizeof *state, state);
+}
+
+static DiffState *
+get_diff_state (ScintillaObject *sci)
+{
+  DiffState *state = g_object_get_qdata (G_OBJECT (sci), DIFF_STATE_QTAG);
+  
+  if (! state) {
+    state = g_slice_alloc (sizeof *state);
+    state->valid        = FALSE;
+    state->blob_serial  = 0;
+    state->hunks        = g_array_new (FALSE, FALSE, sizeof (DiffHunk));
+    state->dirty_start  = -1;
+    state->dirty_end    = -1;
+    state->version      = ++ G_diff_state_version;
+    state->pending_version      = 0;
+    state->pending_blob_serial  = 0;
+    g_object_set_qdata_full (G_OBJECT (sci), DIFF_STATE_QTAG, state,
+                             diff_state_free);
+  }
+  
+  return state;
+}
+
+/* where @line ends up after @lines_added lines were added (or removed if
+ * negative) at @edit_line */
+static gint
+shift_line (gint line,
+            gint edit_line,
+            gint lines_added)
+{
+  return line <= edit_line ? line : MAX (edit_line, line + lines_added);
+}
+
+/* records an edit at @line, keeping the hunks after it in sync */
+static void
+diff_state_mark_dirty (DiffState *state,
+                       gint       line,
+                       gint       lines_added)
+{
+  guint i;
+  
+  if (! state->valid) {
+    return;
+  }
+  
+  for (i = 0; i < state->hunks->len; i++) {
+    DiffHunk *hunk = &g_array_index (state->hunks, DiffHunk, i);
+    
+    if (hunk->new_start - 1 > line) {
+      hunk->new_start = shift_line (hunk->new_start - 1,
+                                    line, lines_added) + 1;
+    }
+  }
+  
+  if (state->dirty_start < 0) {
+    state->dirty_start = line;
+    state->dirty_end = line + MAX (lines_added, 0);
+  } else {
+    state->dirty_start = MIN (shift_line (state->dirty_start,
+                                          line, lines_added), line);
+    state->dirty_end = MAX (shift_line (state->dirty_end, line, lines_added),
+                            line + MAX (lines_added, 0));
+  }
+}
+
+/* re-diffs only the edited part of the document, and only updates the
+ * markers there.  Returns %FALSE if a full update is required */
+static gboolean
+diff_state_update (DiffState     *state,
+                   CachedBlob    *blob,
+                   GeanyDocument *doc)
+{
+  ScintillaObject  *sci = doc->editor->sci;
+  const GArray     *line_starts;
+  GArray           *hunks;
+  git_diff_options  opts;
+  gint              n_old;
+  gint              n_new;
+  gint              start;
+  gint              end;
+  gint              old_start;
+  gint              old_end;
+  gint              delta_before  = 0;
+  gint              delta_after   = 0;
+  gsize             old_pos;
+  gsize             old_len;
+  gint              new_pos;
+  gint              new_len;
+  gboolean          changed;
+  guint             n_before;
+  guint             i;
+  
+  if (! state->valid || state->blob_serial != blob->serial) {
+    return FALSE;
+  } else if (state->dirty_start < 0) {
+    return TRUE; /* nothing changed */
+  }
+  /* we work on raw UTF-8 slices and LF-based line numbers, so bail out if
+   * the document doesn't map directly to the blob */
+  if (doc->has_bom || encoding_needs_conversion (doc->encoding) ||
+      sci_get_eol_mode (sci) == SC_EOL_CR) {
+    return FALSE;
+  }
+  
+  line_starts = cached_blob_get_line_starts (blob);
+  n_old = (gint) line_starts->len;
+  n_new = sci_get_line_count (sci);
+  
+  /* diff window, with a line of context on each side, grown to include any
+   * hunk it touches so that its bounds are on lines unchanged in both */
+  start = MAX (state->dirty_start - 1, 0);
+  end = MIN (state->dirty_end + 2, n_new);
+  do {
+    changed = FALSE;
+    for (i = 0; i < state->hunks->len; i++) {
+      const DiffHunk *hunk = &g_array_index (state->hunks, DiffHunk, i);
+      gint            hunk_start;
+      gint            hunk_end;
+      
+      hunk_get_range (hunk, &hunk_start, &hunk_end);
+      if (hunk_start <= end && hunk_end >= start) {
+        if (hunk_start < start) {
+          start = hunk_start;
+          changed = TRUE;
+        }
+        if (MIN (hunk_end, n_new) > end) {
+          end = MIN (hunk_end, n_new);
+          changed = TRUE;
+        }
+      }
+    }
+  } while (changed);
+  
+  /* not worth it if the window is a large part of the document anyway */
+  if ((end - start) * 2 > n_new) {
+    return FALSE;
+  }
+  
+  /* map the window to the blob, using the hunks around it */
+  for (i = 0; i < state->hunks->len; i++) {
+    const DiffHunk *hunk = &g_array_index (state->hunks, DiffHunk, i);
+    gint            hunk_start;
+    gint            hunk_end;
+    
+    hunk_get_range (hunk, &hunk_start, &hunk_end);
+    if (hunk_end < start) {
+      delta_before += hunk->new_lines - hunk->old_lines;
+    } else if (hunk_start > end) {
+      delta_after += hunk->new_lines - hunk->old_lines;
+    }
+  }
+  old_start = start - delta_before;
+  old_end = n_old - ((n_new - end) - delta_after);
+  if (old_start < 0 || old_start > old_end || old_end > n_old) {
+    return FALSE;
+  }
+  
+  old_pos = g_array_index (line_starts, gsize, old_start);
+  old_len = ((old_end < n_old) ? g_array_index (line_starts, gsize, old_end)
+                               : blob->buf.size) - old_pos;
+  new_pos = sci_get_position_from_line (sci, start);
+  new_len = ((end < n_new) ? sci_get_position_from_line (sci, end)
+                           : sci_get_length (sci)) - new_pos;
+  
+  git_diff_options_init (&opts, GIT_DIFF_OPTIONS_VERSION);
+  opts.context_lines = 0;
+  opts.flags = GIT_DIFF_FORCE_TEXT;
+  
+  hunks = g_array_new (FALSE, FALSE, sizeof (DiffHunk));
+  /* keep the hunks before the window */
+  for (i = 0; i < state->hunks->len; i++) {
+    const DiffHunk *hunk = &g_array_index (state->hunks, DiffHunk, i);
+    gint            hunk_start;
+    gint            hunk_end;
+    
+    hunk_get_range (hunk, &hunk_start, &hunk_end);
+    if (hunk_end < start) {
+      g_array_append_val (hunks, *hunk);
+    }
+  }
+  n_before = hunks->len;
+  if (git_diff_buffers (blob->buf.ptr + old_pos, old_len, NULL,
+                        (const gchar *) scintilla_send_message (sci, SCI_GETRANGEPOINTER,
+                                                                new_pos, new_len),
+                        (size_t) new_len, NULL, &opts, NULL, NULL,
+                        diff_hunk_cb, NULL, hunks) != 0) {
+    g_array_free (hunks, TRUE);
+    return FALSE;
+  }
+  
+  /* move the window's hunks back to document coordinates */
+  clear_markers_range (sci, MAX (start - 1, 0), end);
+  for (i = n_before; i < hunks->len; i++) {
+    DiffHunk *hunk = &g_array_index (hunks, DiffHunk, i);
+    
+    hunk->old_start += old_start;
+    hunk->new_start += start;
+    add_hunk_markers (sci, hunk);
+  }
+  /* and keep the ones after */
+  for (i = 0; i < state->hunks->len; i++) {
+    const DiffHunk *hunk = &g_array_index (state->hunks, DiffHunk, i);
+    gint            hunk_start;
+    gint            hunk_end;
+    
+    hunk_get_range (hunk, &hunk_start, &hunk_end);
+    if (hunk_start > end) {
+      g_array_append_val (hunks, *hunk);
+    }
+  }
+  
+  g_array_free (state->hunks, TRUE);
+  state->hunks = hunks;
+  state->dirty_start = -1;
+  state->dirty_end = -1;
+  
+  return TRUE;
+}
+
+static void
+clear_all_markers (ScintillaObject *sci)
+{
+  guint i;
+  
+  for (i = 0; i < MARKER_COUNT; i++) {
+    scintilla_send_message (sci, SCI_MARKERDELETEALL, G_markers[i].num, 0);
+  }
+}
+
+static void
+free_diff_job (gpointer data)
+{
+  AsyncDiffJob *job = data;
+  
+  if (job->hunks) {
+    g_array_free (job->hunks, TRUE);
+  }
+  cached_blob_unref (job->blob);
+  g_free (job->buf);
+  g_free (job->encoding);
+  g_slice_free1 (sizeof *job, job);
+}
+
+static gboolean
+report_diff_in_idle (gpointer data)
+{
+  AsyncDiffJob  *job  = data;
+  GeanyDocument *doc  = document_find_by_id (job->doc_id);
+  
+  if (doc && g_object_get_qdata (G_OBJECT (doc->editor->sci),
+                                 RESOURCES_ALLOCATED_QTAG)) {
+    ScintillaObject  *sci   = doc->editor->sci;
+    DiffState        *state = g_object_get_qdata (G_OBJECT (sci),
+                                                  DIFF_STATE_QTAG);
+    
+    if (state && state->pending_version == job->version &&
+        state->pending_blob_serial == job->blob->serial) {
+      state->pending_version = 0;
+      state->pending_blob_serial = 0;
+    }
+    /* if the document changed since the snapshot, the result is useless and
+     * a newer diff is on its way anyway */
+    if (state && state->version == job->version) {
+      GArray *hunks = state->hunks;
+      guint   i;
+      
+      state->hunks = job->hunks;
+      job->hunks = hunks;
+      state->valid = (job->status == 0);
+      state->blob_serial = job->blob->serial;
+      state->dirty_start = -1;
+      state->dirty_end = -1;
+      
+      clear_all_markers (sci);
+      for (i = 0; i < state->hunks->len; i++) {
+        add_hunk_markers (sci, &g_array_index (state->hunks, DiffHunk, i));
+      }
+    }
+  }
+  
+  return FALSE;
+}
+
+static void
+diff_worker_func (gpointer data,
+                  gpointer user_data)
+{
+  AsyncDiffJob *job = data;
+  
+  if (g_atomic_int_get (&G_diff_pool_quitting)) {
+    free_diff_job (job);
+    return;
+  }
+  
+  job->status = diff_buf_to_buf (&job->blob->buf, job->buf, job->len,
+                                 job->has_bom, job->encoding,
+                                 diff_hunk_cb, job->hunks);
+  /* we don't need the snapshot anymore */
+  g_free (job->buf);
+  job->buf = NULL;
+  
+  g_idle_add_full (G_PRIORITY_LOW, report_diff_in_idle, job, free_diff_job);
+}
+
+/* queues a full diff of a snapshot of @doc against @blob on the diff worker */
+static void
+push_diff_job (GeanyDocument *doc,
+               DiffState     *state,
+               CachedBlob    *blob)
+{
+  ScintillaObject  *sci = doc->editor->sci;
+  AsyncDiffJob     *job;
+  
+  /* don't diff the same thing twice */
+  if (state->pending_version == state->version &&
+      state->pending_blob_serial == blob->serial) {
+    return;
+  }
+  
+  /* the hunks are about to be replaced, don't bother updating them */
+  state->valid = FALSE;
+  state->pending_version = state->version;
+  state->pending_blob_serial = blob->serial;
+  
+  job = g_slice_alloc (sizeof *job);
+  job->doc_id   = doc->id;
+  job->version  = state->version;
+  job->blob     = cached_blob_ref (blob);
+  job->len      = (gsize) sci_get_length (sci);
+  job->buf      = g_malloc (job->len + 1);
+  job->has_bom  = doc->has_bom;
+  job->encoding = g_strdup (doc->encoding);
+  job->hunks    = g_array_new (FALSE, FALSE, sizeof (DiffHunk));
+  job->status   = -1;
+  memcpy (job->buf,
+          (const gchar *) scintilla_send_message (sci, SCI_GETCHARACTERPOINTER, 0, 0),
+          job->len + 1);
+  
+  if (! G_diff_pool) {
+    g_atomic_int_set (&G_diff_pool_quitting, FALSE);
+    G_diff_pool = g_thread_pool_new (diff_worker_func, NULL, 1, FALSE, NULL);
+  }
+  g_thread_pool_push (G_diff_pool, job, NULL);
 }
 
 static GtkWidget *
@@ -930,6 +1763,7 @@ on_sci_query_tooltip (GtkWidget  *widget,
   gint              max_x;
   ScintillaObject  *sci         = (ScintillaObject *) widget;
   GeanyDocument    *doc         = document_get_current ();
+  CachedBlob       *blob;
   gboolean          has_tooltip = FALSE;
   
   /* for some reason the widget isn't the current one during tab switch, so
@@ -942,7 +1776,7 @@ on_sci_query_tooltip (GtkWidget  *widget,
   max_x = min_x + scintilla_send_message (sci, SCI_GETMARGINWIDTHN, 1, 0);
   
   if (x >= min_x && x <= max_x &&
-      G_blob_contents.ptr && G_blob_contents_tag == doc->id) {
+      (blob = lookup_cached_blob (doc->real_path))) {
     gint pos  = scintilla_send_message (sci, SCI_POSITIONFROMPOINT, x, y);
     gint line = sci_get_line_from_position (sci, pos);
     gint mask = scintilla_send_message (sci, SCI_MARKERGET, line, 0);
@@ -950,9 +1784,9 @@ on_sci_query_tooltip (GtkWidget  *widget,
     if (mask & ((1 << G_markers[MARKER_LINE_CHANGED].num) |
                 (1 << G_markers[MARKER_LINE_REMOVED].num))) {
       TooltipHunkData thd = TOOLTIP_HUNK_DATA_INIT (line + 1, doc,
-                                                    &G_blob_contents, tooltip);
+                                                    &blob->buf, tooltip);
       
-      diff_buf_to_doc (&G_blob_contents, doc, tooltip_diff_hunk_cb, &thd);
+      diff_buf_to_doc (&blob->buf, doc, tooltip_diff_hunk_cb, &thd);
       has_tooltip = thd.found;
     }
   }
@@ -968,29 +1802,36 @@ update_diff (const gchar *path,
   GeanyDocument *doc = document_get_current ();
   
   if (doc && doc->id == GPOINTER_TO_UINT (data)) {
-    ScintillaObject  *sci = doc->editor->sci;
+    ScintillaObject  *sci   = doc->editor->sci;
+    CachedBlob       *blob  = contents ? lookup_cached_blob (path) : NULL;
     gboolean    allocated = !! g_object_get_qdata (G_OBJECT (sci),
                                                    RESOURCES_ALLOCATED_QTAG);
     
-    if (allocated) {
-      guint i;
-      
-      /* clear previous markers */
-      for (i = 0; i < MARKER_COUNT; i++) {
-        scintilla_send_message (sci, SCI_MARKERDELETEALL, G_markers[i].num, 0);
-      }
+    if (blob && &blob->buf != contents) {
+      blob = NULL;
     }
     
     gtk_widget_set_visible (G_undo_menu_item, contents != NULL);
     
-    if (contents && (allocated || allocate_resources (sci))) {
-      diff_buf_to_doc (contents, doc, diff_hunk_cb, sci);
-    } else if (! contents && allocated) {
-      /* if we don't have contents, it probably means the document doesn't
-       * match any object known by Git, so next attempts will fail just the
-       * same.  So, drop allocated resources if any (if it used to be a valid
-       * object, e.g. the document was renamed to something unknown to Git) */
-      release_resources (sci);
+    if (blob && (allocated || allocate_resources (sci))) {
+      DiffState *state = get_diff_state (sci);
+      
+      /* markers are updated when the diff is ready */
+      if (! diff_state_update (state, blob, doc)) {
+        push_diff_job (doc, state, blob);
+      }
+    } else if (allocated) {
+      /* clear previous markers */
+      clear_all_markers (sci);
+      
+      if (! contents) {
+        /* if we don't have contents, it probably means the document doesn't
+         * match any object known by Git, so next attempts will fail just the
+         * same.  So, drop allocated resources if any (if it used to be a
+         * valid object, e.g. the document was renamed to something unknown
+         * to Git) */
+        release_resources (sci);
+      }
     }
   }
 }
@@ -1004,7 +1845,7 @@ do_update_diff_idle (guint    doc_id,
   G_source_id = 0;
   /* make sure the document is still valid and current */
   if (doc && doc->id == doc_id) {
-    get_cached_blob_contents_async (doc->real_path, doc_id, force, update_diff,
+    get_cached_blob_contents_async (doc->real_path, force, update_diff,
                                     GUINT_TO_POINTER (doc->id));
   }
   
@@ -1065,6 +1906,19 @@ on_editor_notify (GObject        *obj,
                   SCNotification *nt,
                   gpointer        user_data)
 {
+  if (nt->nmhdr.code == SCN_MODIFIED &&
+      nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)) {
+    DiffState *state = g_object_get_qdata (G_OBJECT (editor->sci),
+                                           DIFF_STATE_QTAG);
+    
+    if (state) {
+      state->version = ++ G_diff_state_version;
+      diff_state_mark_dirty (state,
+                             sci_get_line_from_position (editor->sci,
+                                                         (gint) nt->position),
+                             (gint) nt->linesAdded);
+    }
+  }
   if (nt->nmhdr.code == SCN_CHARADDED ||
       (nt->nmhdr.code == SCN_MODIFIED &&
        nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))) {
@@ -1079,7 +1933,11 @@ on_document_activate (GObject        *obj,
                       GeanyDocument  *doc,
                       gpointer        user_data)
 {
-  clear_cached_blob_contents ();
+  /* without monitoring we have no way to know whether the cached blobs are
+   * still up-to-date, so play it safe */
+  if (! G_monitoring_enabled) {
+    clear_cached_blob_contents ();
+  }
   update_diff_push (doc, FALSE);
 }
 
@@ -1095,20 +1953,42 @@ on_startup_complete (GObject *obj,
 }
 
 static void
-on_git_repo_changed (GFileMonitor     *monitor,
-                     GFile            *file,
-                     GFile            *other_file,
-                     GFileMonitorEvent event_type,
-                     gpointer          force)
+repo_changed (RepoEntry *entry,
+              gboolean   reopen)
 {
   GeanyDocument *doc = document_get_current ();
   
+  if (reopen) {
+    g_atomic_int_set (&entry->stale, TRUE);
+  }
+  clear_cached_blob_contents_for_workdir (entry->workdir);
   if (doc) {
-    clear_cached_blob_contents ();
-    update_diff_push (doc, GPOINTER_TO_INT (force));
+    update_diff_push (doc, FALSE);
   }
 }
 
+static void
+on_git_head_changed (GFileMonitor     *monitor,
+                     GFile            *file,
+                     GFile            *other_file,
+                     GFileMonitorEvent event_type,
+                     gpointer          entry)
+{
+  /* HEAD might point to another ref now, so the repository needs reopening
+   * to monitor the right one */
+  repo_changed (entry, TRUE);
+}
+
+static void
+on_git_ref_changed (GFileMonitor     *monitor,
+                    GFile            *file,
+                    GFile            *other_file,
+                    GFileMonitorEvent event_type,
+                    gpointer          entry)
+{
+  repo_changed (entry, FALSE);
+}
+
 static int
 goto_next_hunk_diff_hunk_cb (const git_diff_delta *delta,
                              const git_diff_hunk  *hunk,
@@ -1169,7 +2049,7 @@ on_kb_goto_next_hunk (guint kb)
     data->line      = sci_get_current_line (doc->editor->sci);
     data->next_line = -1;
     
-    get_cached_blob_contents_async (doc->real_path, doc->id, FALSE,
+    get_cached_blob_contents_async (doc->real_path, FALSE,
                                     goto_next_hunk_cb, data);
   }
 }
@@ -1290,7 +2170,7 @@ undo_hunk (GeanyDocument *doc,
   data->line   = line + 1;
   data->found  = FALSE;
   
-  get_cached_blob_contents_async (doc->real_path, doc->id, FALSE,
+  get_cached_blob_contents_async (doc->real_path, FALSE,
                                   undo_hunk_cb, data);
 }
 
@@ -1357,7 +2237,7 @@ on_update_editor_menu (GObject       *object,
     data->line   = sci_get_line_from_position (doc->editor->sci, pos) + 1;
     data->found  = FALSE;
     
-    get_cached_blob_contents_async (doc->real_path, doc->id, FALSE,
+    get_cached_blob_contents_async (doc->real_path, FALSE,
                                     check_undo_hunk_cb, data);
   }
 }
@@ -1529,11 +2409,13 @@ plugin_init (GeanyData *data)
 {
   GeanyKeyGroup *kb_group;
   
-  buf_zero (&G_blob_contents);
-  G_blob_contents_tag = 0;
+  g_queue_init (&G_blob_cache);
+  G_blob_cache_table  = NULL;
   G_source_id         = 0;
-  G_thread            = NULL;
-  G_queue             = NULL;
+  G_blob_pool         = NULL;
+  G_repos             = NULL;
+  G_repo_dirs         = NULL;
+  G_diff_pool         = NULL;
   
   if (git_libgit2_init () < 0) {
     const git_error *err = git_error_last ();
@@ -1589,14 +2471,27 @@ plugin_cleanup (void)
     g_source_remove (G_source_id);
     G_source_id = 0;
   }
-  if (G_thread) {
-    g_async_queue_push (G_queue, QUIT_THREAD_JOB); /* notify the thread */
-    g_thread_join (G_thread);
-    G_thread = NULL;
-    g_async_queue_unref (G_queue);
-    G_queue = NULL;
+  if (G_blob_pool) {
+    /* drop pending jobs and wait for the running ones */
+    g_atomic_int_set (&G_blob_pool_quitting, TRUE);
+    g_thread_pool_free (G_blob_pool, FALSE, TRUE);
+    G_blob_pool = NULL;
+    g_hash_table_destroy (G_repo_dirs);
+    G_repo_dirs = NULL;
+    g_ptr_array_free (G_repos, TRUE);
+    G_repos = NULL;
+  }
+  if (G_diff_pool) {
+    /* drop pending jobs and wait for the running one */
+    g_atomic_int_set (&G_diff_pool_quitting, TRUE);
+    g_thread_pool_free (G_diff_pool, FALSE, TRUE);
+    G_diff_pool = NULL;
   }
   clear_cached_blob_contents ();
+  if (G_blob_cache_table) {
+    g_hash_table_destroy (G_blob_cache_table);
+    G_blob_cache_table = NULL;
+  }
   
   foreach_document (i) {
     release_resources (documents[i]->editor->sci);
@@ -1665,6 +2560,7 @@ on_plugin_configure_response (GtkDialog        *dialog,
       G_markers[MARKER_LINE_REMOVED].color = color_to_int (&color);
       
       /* update everything */
+      mark_repos_stale ();
       foreach_document (i) {
         release_resources (documents[i]->editor->sci);
       }
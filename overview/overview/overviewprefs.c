@@ -38,6 +38,7 @@ enum
   PROP_SHOW_TOOLTIP,
   PROP_SHOW_SCROLLBAR,
   PROP_DOUBLE_BUFFERED,
+  PROP_CACHED_RENDERING,
   PROP_SCROLL_LINES,
   PROP_OVERLAY_ENABLED,
   PROP_OVERLAY_COLOR,
@@ -56,6 +57,7 @@ struct OverviewPrefs_
   gboolean        show_tt;
   gboolean        show_sb;
   gboolean        dbl_buf;
+  gboolean        cached;
   gint            scr_lines;
   gboolean        ovl_en;
   OverviewColor   ovl_clr;
@@ -101,6 +103,7 @@ overview_prefs_class_init (OverviewPrefsClass *klass)
   pspecs[PROP_SHOW_TOOLTIP] = g_param_spec_boolean ("show-tooltip", "ShowTooltip", "Whether to show informational tooltip over the overview", TRUE, G_PARAM_CONSTRUCT | G_PARAM_READWRITE);
   pspecs[PROP_SHOW_SCROLLBAR] = g_param_spec_boolean ("show-scrollbar", "ShowScrollbar", "Whether to show the normal editor scrollbar", TRUE, G_PARAM_CONSTRUCT | G_PARAM_READWRITE);
   pspecs[PROP_DOUBLE_BUFFERED] = g_param_spec_boolean ("double-buffered", "DoubleBuffered", "Whether the overview drawing is double-buffered", TRUE, G_PARAM_CONSTRUCT | G_PARAM_READWRITE);
+  pspecs[PROP_CACHED_RENDERING] = g_param_spec_boolean ("cached-rendering", "CachedRendering", "Whether the overview is drawn from cached tiles", FALSE, G_PARAM_CONSTRUCT | G_PARAM_READWRITE);
   pspecs[PROP_SCROLL_LINES] = g_param_spec_uint ("scroll-lines", "ScrollLines", "The number of lines to scroll the overview by", 1, 512, 1, G_PARAM_CONSTRUCT | G_PARAM_READWRITE);
   pspecs[PROP_OVERLAY_ENABLED] = g_param_spec_boolean ("overlay-enabled", "OverlayEnabled", "Whether an overlay is drawn overtop the overview", TRUE, G_PARAM_CONSTRUCT | G_PARAM_READWRITE);
   pspecs[PROP_OVERLAY_COLOR] = g_param_spec_boxed ("overlay-color", "OverlayColor", "The color of the overlay", OVERVIEW_TYPE_COLOR, G_PARAM_CONSTRUCT | G_PARAM_READWRITE);
@@ -149,6 +152,10 @@ overview_prefs_set_property (GObject      *object,
       self->dbl_buf = g_value_get_boolean (value);
       g_object_notify (object, "double-buffered");
       break;
+    case PROP_CACHED_RENDERING:
+      self->cached = g_value_get_boolean (value);
+      g_object_notify (object, "cached-rendering");
+      break;
     case PROP_SCROLL_LINES:
       self->scr_lines = g_value_get_uint (value);
       g_object_notify (object, "scroll-lines");
@@ -216,6 +223,9 @@ overview_prefs_get_property (GObject      *object,
     case PROP_DOUBLE_BUFFERED:
       g_value_set_boolean (value, self->dbl_buf);
       break;
+    case PROP_CACHED_RENDERING:
+      g_value_set_boolean (value, self->cached);
+      break;
     case PROP_SCROLL_LINES:
       g_value_set_uint (value, self->scr_lines);
       break;
@@ -339,6 +349,7 @@ overview_prefs_from_data (OverviewPrefs *self,
   GET (boolean, "show-tooltip",     self->show_tt);
   GET (boolean, "show-scrollbar",   self->show_sb);
   GET (boolean, "double-buffered",  self->dbl_buf);
+  GET (boolean, "cached-rendering", self->cached);
   GET (uint64,  "scroll-lines",     self->scr_lines);
   GET (boolean, "overlay-enabled",  self->ovl_en);
   GET (boolean, "overlay-inverted", self->ovl_inv);
@@ -407,6 +418,7 @@ overview_prefs_to_data (OverviewPrefs *self,
   SET (boolean, "show-tooltip",     self->show_tt);
   SET (boolean, "show-scrollbar",   self->show_sb);
   SET (boolean, "double-buffered",  self->dbl_buf);
+  SET (boolean, "cached-rendering", self->cached);
   SET (uint64,  "scroll-lines",     self->scr_lines);
   SET (boolean, "overlay-enabled",  self->ovl_en);
   SET (boolean, "overlay-inverted", self->ovl_inv);
@@ -438,6 +450,7 @@ overview_prefs_bind_scintilla (OverviewPrefs *self,
   BIND ("show-tooltip");
   BIND ("show-scrollbar");
   BIND ("double-buffered");
+  BIND ("cached-rendering");
   BIND ("scroll-lines");
   BIND ("overlay-enabled");
   BIND ("overlay-color");
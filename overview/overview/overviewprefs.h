@@ -61,6 +61,7 @@ void           overview_prefs_bind_scintilla (OverviewPrefs *prefs,
     "zoom = -10\n"                      \
     "show-tooltip = true\n"             \
     "double-buffered = true\n"          \
+    "cached-rendering = false\n"        \
     "scroll-lines = 4\n"                \
     "show-scrollbar = true\n"           \
     "overlay-enabled = true\n"          \
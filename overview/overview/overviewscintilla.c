@@ -38,6 +38,8 @@
 #define OVERVIEW_SCINTILLA_WIDTH_MAX     512
 #define OVERVIEW_SCINTILLA_WIDTH_DEF     120
 #define OVERVIEW_SCINTILLA_SCROLL_LINES  1
+#define OVERVIEW_SCINTILLA_TILE_HEIGHT   64
+#define OVERVIEW_SCINTILLA_MAX_TILES     64
 
 #ifndef SC_MAX_MARGIN
 # define SC_MAX_MARGIN 4
@@ -63,11 +65,23 @@ enum
   PROP_OVERLAY_OUTLINE_COLOR,
   PROP_OVERLAY_INVERTED,
   PROP_DOUBLE_BUFFERED,
+  PROP_CACHED_RENDERING,
   PROP_SCROLL_LINES,
   PROP_SHOW_SCROLLBAR,
   N_PROPERTIES,
 };
 
+typedef struct
+{
+  GQuark   font;
+  gint     size;
+  gint     weight;
+  gboolean italic;
+  gint     fore;
+  gint     back;
+}
+OverviewStyle;
+
 struct OverviewScintilla_
 {
   ScintillaObject  parent;
@@ -84,6 +98,18 @@ struct OverviewScintilla_
   OverviewColor    overlay_outline_color; // the color of the outline of the overlay
   gboolean         overlay_inverted;// draw overlay over the visible area instead of around it
   gboolean         double_buffered; // whether to enable double-buffering on internal scintilla canvas
+  gboolean         cached_rendering;// whether to draw from cached tiles instead of letting scintilla draw
+  gboolean         rendering_tile;  // whether scintilla is currently drawing into a tile
+  gulong           sci_draw;        // signal id of scintilla's own draw handler on the canvas
+  gboolean         sci_draw_blocked;// whether scintilla's draw handler is blocked
+  GHashTable      *tiles;           // tile index -> cairo_surface_t of the rendered lines
+  gint             tiles_width;     // width of the cached tiles
+  gint             tiles_line_height; // line height the cached tiles were rendered with
+  OverviewStyle    styles[STYLE_MAX]; // styles last copied from the source scintilla
+  gboolean         styles_valid;    // whether styles were copied already
+  gboolean         styles_stale;    // whether styles have to be compared regardless of the fingerprint
+  gint             styles_lexer;    // lexer of the source scintilla when styles were last compared
+  gboolean         view_configured; // whether the view settings were applied already
   gint             scroll_lines;    // number of lines to scroll each scroll-event
   gboolean         show_scrollbar;  // show the main scintilla's scrollbar
   gboolean         mouse_down;      // whether the mouse is down
@@ -99,6 +125,10 @@ struct OverviewScintillaClass_
 
 static GParamSpec *pspecs[N_PROPERTIES] = { NULL };
 
+// styles checked to tell whether the source scintilla's styles changed, a colour
+// scheme or filetype change is very unlikely to leave all of them alone
+static const gint overview_key_styles[] = { STYLE_DEFAULT, 0, 1, 2, 3, 4, 5, 6, 7 };
+
 static void overview_scintilla_finalize     (GObject           *object);
 static void overview_scintilla_set_property (GObject           *object,
                                              guint              prop_id,
@@ -113,6 +143,7 @@ static void overview_scintilla_set_src_sci  (OverviewScintilla *self,
 
 #if GTK_CHECK_VERSION (3, 0, 0)
 static gboolean overview_scintilla_draw (GtkWidget *widget, cairo_t *cr, gpointer user_data);
+static gboolean overview_scintilla_draw_cached (GtkWidget *widget, cairo_t *cr, gpointer user_data);
 #else
 static gboolean overview_scintilla_expose_event (GtkWidget *widget, GdkEventExpose *event, gpointer user_data);
 #endif
@@ -212,6 +243,13 @@ overview_scintilla_class_init (OverviewScintillaClass *klass)
                           TRUE,
                           G_PARAM_CONSTRUCT | G_PARAM_READWRITE);
 
+  pspecs[PROP_CACHED_RENDERING] =
+    g_param_spec_boolean ("cached-rendering",
+                          "CachedRendering",
+                          "Whether the overview is drawn from cached tiles of rendered lines",
+                          FALSE,
+                          G_PARAM_CONSTRUCT | G_PARAM_READWRITE);
+
   pspecs[PROP_SCROLL_LINES] =
     g_param_spec_int ("scroll-lines",
                       "ScrollLines",
@@ -242,6 +280,7 @@ overview_scintilla_finalize (GObject *object)
     g_signal_handler_disconnect (self->src_canvas, self->conf_event);
 
   g_object_unref (self->sci);
+  g_hash_table_destroy (self->tiles);
 
   G_OBJECT_CLASS (overview_scintilla_parent_class)->finalize (object);
 }
@@ -314,15 +353,154 @@ overview_scintilla_draw_real (OverviewScintilla *self,
   cairo_restore (cr);
 }
 
+static void
+overview_scintilla_invalidate_tiles (OverviewScintilla *self,
+                                     gint               first_line,
+                                     gint               last_line);
+
 #if GTK_CHECK_VERSION (3, 0, 0)
 static gboolean
 overview_scintilla_draw (GtkWidget *widget,
                          cairo_t   *cr,
                          gpointer   user_data)
 {
-  overview_scintilla_draw_real (OVERVIEW_SCINTILLA (user_data), cr);
+  OverviewScintilla *self = OVERVIEW_SCINTILLA (user_data);
+  // the overlay isn't part of the cached tiles
+  if (! self->rendering_tile)
+    overview_scintilla_draw_real (self, cr);
   return FALSE;
 }
+
+static cairo_surface_t *
+overview_scintilla_render_tile (OverviewScintilla *self,
+                                gint               tile,
+                                gint               lines_per_tile,
+                                gint               line_height,
+                                gint               width)
+{
+  cairo_surface_t *surface;
+  cairo_t         *cr;
+  gint             first_line = tile * lines_per_tile;
+  gint             top_line;
+  gint             doc_line, pos_start, pos_end;
+
+  surface = gdk_window_create_similar_surface (gtk_widget_get_window (self->canvas),
+                                               CAIRO_CONTENT_COLOR,
+                                               width,
+                                               lines_per_tile * line_height);
+
+  // scintilla doesn't paint lines which are not styled yet but queues another redraw
+  doc_line = sci_send (self, DOCLINEFROMVISIBLE, first_line, 0);
+  pos_start = sci_send (self, POSITIONFROMLINE, doc_line, 0);
+  pos_end = sci_send (self, POSITIONFROMLINE,
+                      sci_send (self, DOCLINEFROMVISIBLE, first_line + lines_per_tile, 0), 0);
+  if (pos_start >= 0)
+    sci_send (self, COLOURISE, pos_start, pos_end);
+
+  // scintilla only draws its view, so scroll it to the tile
+  sci_send (self, SETFIRSTVISIBLELINE, first_line, 0);
+  top_line = sci_send (self, GETFIRSTVISIBLELINE, 0, 0);
+
+  cr = cairo_create (surface);
+  // the view can't always be scrolled as far, e.g. at the end of the document
+  cairo_translate (cr, 0, (top_line - first_line) * line_height);
+
+  self->rendering_tile = TRUE;
+  g_signal_handler_unblock (self->canvas, self->sci_draw);
+  gtk_widget_draw (self->canvas, cr);
+  g_signal_handler_block (self->canvas, self->sci_draw);
+  self->rendering_tile = FALSE;
+
+  cairo_destroy (cr);
+
+  return surface;
+}
+
+static gboolean
+overview_scintilla_tile_is_far (gpointer key,
+                                gpointer value,
+                                gpointer user_data)
+{
+  gint  tile  = GPOINTER_TO_INT (key);
+  gint *range = user_data;
+  return tile < range[0] || tile > range[1];
+}
+
+// Paints the overview from tiles of rendered lines, rendering only the missing ones,
+// so scrolling just blits the tiles and the overlay.
+static gboolean
+overview_scintilla_draw_cached (GtkWidget *widget,
+                                cairo_t   *cr,
+                                gpointer   user_data)
+{
+  OverviewScintilla *self = OVERVIEW_SCINTILLA (user_data);
+  GtkAllocation      alloc;
+  gint               first_line, n_lines, line_height, lines_per_tile;
+  gint               range[2];
+  gboolean           rendered = FALSE;
+
+  if (! self->cached_rendering || self->rendering_tile)
+    return FALSE;
+
+  gtk_widget_get_allocation (widget, &alloc);
+
+  first_line = sci_send (self, GETFIRSTVISIBLELINE, 0, 0);
+  line_height = MAX (1, sci_send (self, TEXTHEIGHT, 0, 0));
+
+  if (alloc.width != self->tiles_width || line_height != self->tiles_line_height)
+    {
+      overview_scintilla_invalidate_tiles (self, 0, -1);
+      self->tiles_width = alloc.width;
+      self->tiles_line_height = line_height;
+    }
+
+  lines_per_tile = MAX (1, OVERVIEW_SCINTILLA_TILE_HEIGHT / line_height);
+  n_lines = alloc.height / line_height + 1;
+
+  range[0] = first_line / lines_per_tile;
+  range[1] = (first_line + n_lines) / lines_per_tile;
+  if (g_hash_table_size (self->tiles) > OVERVIEW_SCINTILLA_MAX_TILES)
+    g_hash_table_foreach_remove (self->tiles, overview_scintilla_tile_is_far, range);
+
+  for (gint tile = range[0]; tile <= range[1]; tile++)
+    {
+      cairo_surface_t *surface;
+
+      surface = g_hash_table_lookup (self->tiles, GINT_TO_POINTER (tile));
+      if (surface == NULL)
+        {
+          surface = overview_scintilla_render_tile (self, tile, lines_per_tile,
+                                                    line_height, alloc.width);
+          g_hash_table_insert (self->tiles, GINT_TO_POINTER (tile), surface);
+          rendered = TRUE;
+        }
+
+      cairo_set_source_surface (cr, surface, 0, (tile * lines_per_tile - first_line) * line_height);
+      cairo_paint (cr);
+    }
+
+  if (rendered)
+    sci_send (self, SETFIRSTVISIBLELINE, first_line, 0);
+
+  overview_scintilla_draw_real (self, cr);
+
+  // don't let scintilla or the overlay handler draw again
+  return TRUE;
+}
+
+static void
+overview_scintilla_update_sci_draw (OverviewScintilla *self)
+{
+  if (self->sci_draw == 0 || self->cached_rendering == self->sci_draw_blocked)
+    return;
+
+  if (self->cached_rendering)
+    g_signal_handler_block (self->canvas, self->sci_draw);
+  else
+    g_signal_handler_unblock (self->canvas, self->sci_draw);
+
+  self->sci_draw_blocked = self->cached_rendering;
+}
 #else
 static gboolean
 overview_scintilla_expose_event (GtkWidget      *widget,
@@ -575,10 +753,20 @@ overview_scintilla_setup_canvas (OverviewScintilla *self)
       gtk_widget_set_has_tooltip (self->canvas, self->show_tooltip);
 
 #if GTK_CHECK_VERSION (3, 0, 0)
+      // scintilla connects its draw handler when creating the canvas, so it's the first one
+      self->sci_draw = g_signal_handler_find (self->canvas,
+                                              G_SIGNAL_MATCH_ID,
+                                              g_signal_lookup ("draw", GTK_TYPE_WIDGET),
+                                              0, NULL, NULL, NULL);
+      g_signal_connect (self->canvas,
+                        "draw",
+                        G_CALLBACK (overview_scintilla_draw_cached),
+                        self);
       g_signal_connect_after (self->canvas,
                               "draw",
                               G_CALLBACK (overview_scintilla_draw),
                               self);
+      overview_scintilla_update_sci_draw (self);
 #else
       g_signal_connect_after (self->canvas,
                               "expose-event",
@@ -686,6 +874,16 @@ overview_scintilla_init (OverviewScintilla *self)
   self->scroll_lines    = OVERVIEW_SCINTILLA_SCROLL_LINES;
   self->show_scrollbar  = TRUE;
   self->overlay_inverted = TRUE;
+  self->cached_rendering = FALSE;
+  self->rendering_tile  = FALSE;
+  self->sci_draw        = 0;
+  self->sci_draw_blocked = FALSE;
+  self->tiles           = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                                 (GDestroyNotify) cairo_surface_destroy);
+  self->tiles_width     = 0;
+  self->tiles_line_height = 0;
+  self->styles_valid    = FALSE;
+  self->view_configured = FALSE;
 
   memset (&self->visible_rect, 0, sizeof (GdkRectangle));
   memcpy (&self->overlay_color, &def_overlay_color, sizeof (OverviewColor));
@@ -747,6 +945,9 @@ overview_scintilla_set_property (GObject      *object,
     case PROP_DOUBLE_BUFFERED:
       overview_scintilla_set_double_buffered (self, g_value_get_boolean (value));
       break;
+    case PROP_CACHED_RENDERING:
+      overview_scintilla_set_cached_rendering (self, g_value_get_boolean (value));
+      break;
     case PROP_SCROLL_LINES:
       overview_scintilla_set_scroll_lines (self, g_value_get_int (value));
       break;
@@ -814,6 +1015,9 @@ overview_scintilla_get_property (GObject      *object,
     case PROP_DOUBLE_BUFFERED:
       g_value_set_boolean (value, overview_scintilla_get_double_buffered (self));
       break;
+    case PROP_CACHED_RENDERING:
+      g_value_set_boolean (value, overview_scintilla_get_cached_rendering (self));
+      break;
     case PROP_SCROLL_LINES:
       g_value_set_int (value, overview_scintilla_get_scroll_lines (self));
       break;
@@ -884,56 +1088,202 @@ on_src_sci_notify (ScintillaObject   *sci,
       if (GTK_IS_WIDGET (self->canvas))
         gtk_widget_queue_draw (self->canvas);
     }
+  else if (nt->nmhdr.code == SCN_MODIFIED && self->cached_rendering &&
+           (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT |
+                                    SC_MOD_CHANGESTYLE | SC_MOD_CHANGEFOLD |
+                                    SC_MOD_CHANGEMARKER | SC_MOD_CHANGEINDICATOR)))
+    {
+      gint first_line, last_line;
+
+      if (nt->modificationType & (SC_MOD_CHANGEMARKER | SC_MOD_CHANGEFOLD))
+        first_line = last_line = nt->line;
+      else if (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
+        {
+          first_line = sci_send (self->sci, LINEFROMPOSITION, nt->position, 0);
+          // only added or removed lines move the following ones, restyling is
+          // reported separately
+          last_line = (nt->linesAdded != 0) ? -1 : first_line;
+        }
+      else
+        {
+          first_line = sci_send (self->sci, LINEFROMPOSITION, nt->position, 0);
+          last_line = sci_send (self->sci, LINEFROMPOSITION, nt->position + nt->length, 0);
+        }
+
+      overview_scintilla_invalidate_tiles (self, first_line, last_line);
+      if (GTK_IS_WIDGET (self->canvas))
+        gtk_widget_queue_draw (self->canvas);
+    }
+}
+
+typedef struct
+{
+  gint first;
+  gint last;
+}
+OverviewScintillaTileRange;
+
+static gboolean
+overview_scintilla_tile_is_in_range (gpointer key,
+                                     gpointer value,
+                                     gpointer user_data)
+{
+  const OverviewScintillaTileRange *range = user_data;
+  gint                              tile  = GPOINTER_TO_INT (key);
+
+  return tile >= range->first && (range->last < 0 || tile <= range->last);
 }
 
+// drops the cached tiles containing the document lines first_line to last_line,
+// or to the end of the document if last_line is negative
 static void
-overview_scintilla_clone_styles (OverviewScintilla *self)
+overview_scintilla_invalidate_tiles (OverviewScintilla *self,
+                                     gint               first_line,
+                                     gint               last_line)
 {
-  ScintillaObject *sci     = SCINTILLA (self);
-  ScintillaObject *src_sci = self->sci;
+  OverviewScintillaTileRange range;
+  gint                       lines_per_tile;
 
-  for (gint i = 0; i < STYLE_MAX; i++)
+  if ((first_line <= 0 && last_line < 0) || self->tiles_line_height <= 0)
     {
-      gchar   *font_name = sci_get_font (src_sci, i);
-      gint     font_size = sci_send (src_sci, STYLEGETSIZE, i, 0);
-      gint     weight    = sci_send (src_sci, STYLEGETWEIGHT, i, 0);
-      gboolean italic    = sci_send (src_sci, STYLEGETITALIC, i, 0);
-      gint     fg_color  = sci_send (src_sci, STYLEGETFORE, i, 0);
-      gint     bg_color  = sci_send (src_sci, STYLEGETBACK, i, 0);
-
-      sci_send (sci, STYLESETFONT, i, font_name);
-      sci_send (sci, STYLESETSIZE, i, font_size);
-      sci_send (sci, STYLESETWEIGHT, i, weight);
-      sci_send (sci, STYLESETITALIC, i, italic);
-      sci_send (sci, STYLESETFORE, i, fg_color);
-      sci_send (sci, STYLESETBACK, i, bg_color);
-      sci_send (sci, STYLESETCHANGEABLE, i, 0);
+      g_hash_table_remove_all (self->tiles);
+      return;
+    }
+
+  // tiles are made of visible lines, so folded lines take no room
+  lines_per_tile = MAX (1, OVERVIEW_SCINTILLA_TILE_HEIGHT / self->tiles_line_height);
+  range.first = sci_send (self, VISIBLEFROMDOCLINE, MAX (first_line, 0), 0) / lines_per_tile;
+  range.last = -1;
+  if (last_line >= 0)
+    range.last = (sci_send (self, VISIBLEFROMDOCLINE, last_line + 1, 0) - 1) / lines_per_tile;
+
+  g_hash_table_foreach_remove (self->tiles, overview_scintilla_tile_is_in_range, &range);
+}
+
+static GQuark
+sci_get_font_quark (ScintillaObject *sci,
+                    gint             style)
+{
+  gchar  buf[256];
+  gsize  len = sci_send (sci, STYLEGETFONT, style, 0);
+  GQuark quark;
 
+  if (len < sizeof (buf))
+    {
+      memset (buf, 0, sizeof (buf));
+      sci_send (sci, STYLEGETFONT, style, buf);
+      quark = g_quark_from_string (buf);
+    }
+  else
+    {
+      gchar *font_name = sci_get_font (sci, style);
+      quark = g_quark_from_string (font_name);
       g_free (font_name);
     }
+
+  return quark;
 }
 
 static void
-overview_scintilla_queue_draw (OverviewScintilla *self)
+sci_get_style (ScintillaObject *sci,
+               gint             index,
+               OverviewStyle   *style)
+{
+  memset (style, 0, sizeof (OverviewStyle));
+  style->font   = sci_get_font_quark (sci, index);
+  style->size   = sci_send (sci, STYLEGETSIZE, index, 0);
+  style->weight = sci_send (sci, STYLEGETWEIGHT, index, 0);
+  style->italic = sci_send (sci, STYLEGETITALIC, index, 0);
+  style->fore   = sci_send (sci, STYLEGETFORE, index, 0);
+  style->back   = sci_send (sci, STYLEGETBACK, index, 0);
+}
+
+// Cheap check whether the styles of the source scintilla may have changed since they
+// were last copied, comparing its lexer and a few key styles only.
+static gboolean
+overview_scintilla_styles_changed (OverviewScintilla *self)
 {
-  if (GTK_IS_WIDGET (self->canvas))
-    gtk_widget_queue_draw (self->canvas);
-  else
-    gtk_widget_queue_draw (GTK_WIDGET (self));
+  gint lexer = sci_send (self->sci, GETLEXER, 0, 0);
+
+  if (! self->styles_valid || self->styles_stale || lexer != self->styles_lexer)
+    return TRUE;
+
+  for (guint i = 0; i < G_N_ELEMENTS (overview_key_styles); i++)
+    {
+      OverviewStyle style;
+
+      sci_get_style (self->sci, overview_key_styles[i], &style);
+      if (memcmp (&style, &self->styles[overview_key_styles[i]], sizeof (OverviewStyle)) != 0)
+        return TRUE;
+    }
+
+  return FALSE;
 }
 
-void
-overview_scintilla_sync (OverviewScintilla *self)
+// Copies the styles of the source scintilla which changed since the last time. The
+// setters make scintilla re-layout everything, so they are what's expensive, but
+// getting all the styles still takes a few thousand messages, so they are only
+// compared when the fingerprint changed. Returns whether any style changed.
+static gboolean
+overview_scintilla_clone_styles (OverviewScintilla *self)
 {
-  sptr_t doc_ptr;
+  ScintillaObject *sci     = SCINTILLA (self);
+  ScintillaObject *src_sci = self->sci;
+  gboolean         changed = FALSE;
 
-  g_return_if_fail (OVERVIEW_IS_SCINTILLA (self));
+  if (! overview_scintilla_styles_changed (self))
+    return FALSE;
 
-  doc_ptr = sci_send (self->sci, GETDOCPOINTER, 0, 0);
-  sci_send (self, SETDOCPOINTER, 0, doc_ptr);
+  for (gint i = 0; i < STYLE_MAX; i++)
+    {
+      OverviewStyle  style;
+      OverviewStyle *old = &self->styles[i];
+      gboolean       force = ! self->styles_valid;
+
+      sci_get_style (src_sci, i, &style);
+
+      if (! force && memcmp (&style, old, sizeof (OverviewStyle)) == 0)
+        continue;
+
+      if (force || style.font != old->font)
+        sci_send (sci, STYLESETFONT, i, g_quark_to_string (style.font));
+      if (force || style.size != old->size)
+        sci_send (sci, STYLESETSIZE, i, style.size);
+      if (force || style.weight != old->weight)
+        sci_send (sci, STYLESETWEIGHT, i, style.weight);
+      if (force || style.italic != old->italic)
+        sci_send (sci, STYLESETITALIC, i, style.italic);
+      if (force || style.fore != old->fore)
+        sci_send (sci, STYLESETFORE, i, style.fore);
+      if (force || style.back != old->back)
+        sci_send (sci, STYLESETBACK, i, style.back);
+      if (force)
+        sci_send (sci, STYLESETCHANGEABLE, i, 0);
+
+      memcpy (old, &style, sizeof (OverviewStyle));
+      changed = TRUE;
+    }
 
-  overview_scintilla_clone_styles (self);
+  self->styles_valid = TRUE;
+  self->styles_stale = FALSE;
+  self->styles_lexer = sci_send (src_sci, GETLEXER, 0, 0);
+
+  return changed;
+}
 
+// Makes the next sync compare all the styles, for changes the fingerprint can miss.
+void
+overview_scintilla_invalidate_styles (OverviewScintilla *self)
+{
+  g_return_if_fail (OVERVIEW_IS_SCINTILLA (self));
+
+  self->styles_stale = TRUE;
+}
+
+// view settings which don't depend on the document, so they only need to be set once
+static void
+overview_scintilla_configure_view (OverviewScintilla *self)
+{
   for (gint i = 0; i < SC_MAX_MARGIN; i++)
     sci_send (self, SETMARGINWIDTHN, i, 0);
 
@@ -943,15 +1293,57 @@ overview_scintilla_sync (OverviewScintilla *self)
   sci_send (self, SETVSCROLLBAR, 0, 0);
   sci_send (self, SETZOOM, self->zoom, 0);
   sci_send (self, SETCURSOR, SC_CURSORARROW, 0);
-  sci_send (self, SETENDATLASTLINE, sci_send (self->sci, GETENDATLASTLINE, 0, 0), 0);
   sci_send (self, SETMOUSEDOWNCAPTURES, 0, 0);
   sci_send (self, SETCARETPERIOD, 0, 0);
   sci_send (self, SETCARETWIDTH, 0, 0);
   sci_send (self, SETEXTRAASCENT, 0, 0);
   sci_send (self, SETEXTRADESCENT, 0, 0);
 
+  self->view_configured = TRUE;
+}
+
+static void
+overview_scintilla_queue_draw (OverviewScintilla *self)
+{
+  if (GTK_IS_WIDGET (self->canvas))
+    gtk_widget_queue_draw (self->canvas);
+  else
+    gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+void
+overview_scintilla_sync (OverviewScintilla *self)
+{
+  sptr_t   doc_ptr;
+  gboolean end_at_last_line;
+  gboolean changed = FALSE;
+
+  g_return_if_fail (OVERVIEW_IS_SCINTILLA (self));
+
+  // setting the document pointer makes scintilla re-layout the whole document,
+  // even if it's the same one
+  doc_ptr = sci_send (self->sci, GETDOCPOINTER, 0, 0);
+  if (sci_send (self, GETDOCPOINTER, 0, 0) != doc_ptr)
+    {
+      sci_send (self, SETDOCPOINTER, 0, doc_ptr);
+      changed = TRUE;
+    }
+
+  if (overview_scintilla_clone_styles (self))
+    changed = TRUE;
+
+  if (! self->view_configured)
+    overview_scintilla_configure_view (self);
+
+  end_at_last_line = sci_send (self->sci, GETENDATLASTLINE, 0, 0);
+  if (sci_send (self, GETENDATLASTLINE, 0, 0) != end_at_last_line)
+    sci_send (self, SETENDATLASTLINE, end_at_last_line, 0);
+
   sci_send (self->sci, SETVSCROLLBAR, self->show_scrollbar, 0);
 
+  if (changed)
+    overview_scintilla_invalidate_tiles (self, 0, -1);
+
   overview_scintilla_update_cursor (self);
   overview_scintilla_update_rect (self);
   overview_scintilla_sync_center (self);
@@ -1256,6 +1648,31 @@ overview_scintilla_set_double_buffered (OverviewScintilla *self,
     }
 }
 
+gboolean
+overview_scintilla_get_cached_rendering (OverviewScintilla *self)
+{
+  g_return_val_if_fail (OVERVIEW_IS_SCINTILLA (self), FALSE);
+  return self->cached_rendering;
+}
+
+void
+overview_scintilla_set_cached_rendering (OverviewScintilla *self,
+                                         gboolean           enabled)
+{
+  g_return_if_fail (OVERVIEW_IS_SCINTILLA (self));
+
+  if (enabled != self->cached_rendering)
+    {
+      self->cached_rendering = enabled;
+      overview_scintilla_invalidate_tiles (self, 0, -1);
+#if GTK_CHECK_VERSION (3, 0, 0)
+      overview_scintilla_update_sci_draw (self);
+#endif
+      overview_scintilla_queue_draw (self);
+      g_object_notify (G_OBJECT (self), "cached-rendering");
+    }
+}
+
 gint
 overview_scintilla_get_scroll_lines (OverviewScintilla *self)
 {
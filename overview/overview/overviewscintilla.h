@@ -41,6 +41,7 @@ typedef struct OverviewScintillaClass_   OverviewScintillaClass;
 GType         overview_scintilla_get_type                  (void);
 GtkWidget    *overview_scintilla_new                       (ScintillaObject     *src_sci);
 void          overview_scintilla_sync                      (OverviewScintilla   *sci);
+void          overview_scintilla_invalidate_styles         (OverviewScintilla   *sci);
 GdkCursorType overview_scintilla_get_cursor                (OverviewScintilla   *sci);
 void          overview_scintilla_set_cursor                (OverviewScintilla   *sci,
                                                             GdkCursorType        cursor_type);
@@ -74,6 +75,9 @@ void          overview_scintilla_set_overlay_inverted      (OverviewScintilla
 gboolean      overview_scintilla_get_double_buffered       (OverviewScintilla   *sci);
 void          overview_scintilla_set_double_buffered       (OverviewScintilla   *sci,
                                                             gboolean             enabled);
+gboolean      overview_scintilla_get_cached_rendering      (OverviewScintilla   *sci);
+void          overview_scintilla_set_cached_rendering      (OverviewScintilla   *sci,
+                                                            gboolean             enabled);
 gint          overview_scintilla_get_scroll_lines          (OverviewScintilla   *sci);
 void          overview_scintilla_set_scroll_lines          (OverviewScintilla   *sci,
                                                             gint                 lines);
@@ -241,6 +241,19 @@ on_document_activate_reload (G_GNUC_UNUSED GObject       *unused,
   overview_ui_queue_update ();
 }
 
+static void
+on_document_filetype_set (G_GNUC_UNUSED GObject       *unused,
+                          GeanyDocument               *doc,
+                          G_GNUC_UNUSED GeanyFiletype *old_ft,
+                          G_GNUC_UNUSED gpointer       user_data)
+{
+  OverviewScintilla *overview;
+  overview = overview_scintilla_from_document (doc);
+  if (OVERVIEW_IS_SCINTILLA (overview))
+    overview_scintilla_invalidate_styles (overview);
+  overview_ui_queue_update ();
+}
+
 static void
 on_document_close (G_GNUC_UNUSED GObject *unused,
                    GeanyDocument         *doc,
@@ -337,6 +350,7 @@ overview_ui_init (OverviewPrefs *prefs)
   plugin_signal_connect (geany_plugin, NULL, "document-activate", TRUE, G_CALLBACK (on_document_activate_reload), NULL);
   plugin_signal_connect (geany_plugin, NULL, "document-reload", TRUE, G_CALLBACK (on_document_activate_reload), NULL);
   plugin_signal_connect (geany_plugin, NULL, "document-close", TRUE, G_CALLBACK (on_document_close), NULL);
+  plugin_signal_connect (geany_plugin, NULL, "document-filetype-set", TRUE, G_CALLBACK (on_document_filetype_set), NULL);
 
 }
 
@@ -19,6 +19,10 @@
 #include <sys/time.h>
 #include <gdk/gdkkeysyms.h>
 #include <glib/gstdio.h>
+#include <string.h>
+#ifndef G_OS_WIN32
+# include <dirent.h>
+#endif
 
 #ifdef HAVE_CONFIG_H
 	#include "config.h"
@@ -43,6 +47,90 @@ typedef struct
 	GtkWidget *generate_tag_prefs;
 } PropertyDialogElements;
 
+/* cached listing of a directory, valid as long as its mtime doesn't change */
+typedef struct
+{
+	gint64 mtime;
+	gchar **file_names;  /* locale encoding */
+	gchar **dir_names;  /* locale encoding */
+} DirCacheEntry;
+
+typedef struct ScanDir ScanDir;
+struct ScanDir
+{
+	ScanDir *parent;
+	gchar *locale_path;
+	gchar *utf8_path;
+	gint has_files;  /* whether there is any file in the subtree */
+};
+
+typedef struct
+{
+	GSList *patterns;
+	GSList *ignored_dirs_patterns;
+	GSList *ignored_file_patterns;
+	gboolean utf8_locale;
+	gint64 cache_time;
+	GThreadPool *pool;
+
+	GMutex lock;  /* protects the members below */
+	GCond done_cond;
+	gint pending;
+	GHashTable *old_cache;
+	GHashTable *new_cache;
+	GHashTable *visited_paths;
+	GPtrArray *files;  /* utf8 paths */
+	GPtrArray *dirs;  /* ScanDir */
+} ScanContext;
+
+typedef struct
+{
+	GPatternSpec *pattern;
+	guint index;
+} FiletypeGlob;
+
+/* Index of the filetype patterns used to detect filetypes from file names.
+ * Plain names and "*.ext" patterns, which are the vast majority, are looked up
+ * in hash tables and only the remaining real globs are matched one by one.
+ * The values are indices into filetypes + 1 because the first filetype with
+ * a matching pattern wins. Immutable once built so it can be shared with the
+ * detection thread. */
+typedef struct
+{
+	gint ref_count;
+	guint fingerprint;
+	GPtrArray *filetypes;  /* GeanyFiletype, snapshot of the filetypes array */
+	GHashTable *basenames;  /* exact name -> index + 1 */
+	GHashTable *extensions;  /* extension without the dot -> index + 1 */
+	GPtrArray *globs;  /* FiletypeGlob, sorted by index */
+} FiletypeMatcher;
+
+typedef struct
+{
+	PrjOrgRoot *root;
+	gchar *utf8_path;
+	GeanyFiletype *ft;  /* set by the detection thread, NULL if unknown from the name */
+} TagFile;
+
+/* Tag generation runs in two stages: a thread detects the filetypes of the
+ * files from their names (which needs a stat() for each of them), and a
+ * timeout on the main thread creates the source files and passes them to the
+ * tag manager in batches as soon as they are ready. */
+typedef struct
+{
+	GPtrArray *files;  /* TagFile */
+	FiletypeMatcher *matcher;
+	gchar **session_files;
+	GThread *thread;
+	gint cancelled;
+	gint detected;  /* number of files the detection thread is done with */
+	guint added;  /* number of files passed to the tag manager */
+	guint source_id;
+} TagGenerator;
+
+#define TAG_BATCH_SIZE 100
+#define TAG_BATCH_TIME_US 40000
+
 PrjOrg *prj_org = NULL;
 
 static PropertyDialogElements *e;
@@ -50,6 +138,9 @@ static PropertyDialogElements *e;
 static GSList *s_idle_add_funcs;
 static GSList *s_idle_remove_funcs;
 
+static TagGenerator *s_tag_generator = NULL;
+static FiletypeMatcher *s_filetype_matcher = NULL;
+
 
 static void clear_idle_queue(GSList **queue)
 {
@@ -71,75 +162,311 @@ static void collect_source_files(gchar *filename, TMSourceFile *sf, gpointer use
 }
 
 
-/* path - absolute path in locale, returned list in utf8 */
-static GSList *get_file_list(const gchar *utf8_path, GSList *patterns,
-		GSList *ignored_dirs_patterns, GSList *ignored_file_patterns, GHashTable *visited_paths)
+static void dir_cache_entry_free(DirCacheEntry *entry)
 {
-	GSList *list = NULL;
-	GDir *dir;
-	const gchar *child_name;
-	GSList *child = NULL;
-	GSList *children = NULL;
-	gchar *locale_path = utils_get_locale_from_utf8(utf8_path);
-	gchar *real_path = utils_get_real_path(locale_path);
+	g_strfreev(entry->file_names);
+	g_strfreev(entry->dir_names);
+	g_free(entry);
+}
+
+
+static GHashTable *dir_cache_new(void)
+{
+	return g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)dir_cache_entry_free);
+}
+
+
+/* Reads the names of the regular files and directories (following symlinks)
+ * in locale_path. Uses the file type from readdir() when available to avoid
+ * stat()ing every entry. */
+static DirCacheEntry *read_dir(const gchar *locale_path, gint64 mtime)
+{
+	DirCacheEntry *entry;
+	GPtrArray *file_names, *dir_names;
+#ifdef G_OS_WIN32
+	GDir *dir = g_dir_open(locale_path, 0, NULL);
+	const gchar *name;
+
+	if (!dir)
+		return NULL;
+#else
+	DIR *dir = opendir(locale_path);
+	struct dirent *ent;
 
-	dir = g_dir_open(locale_path, 0, NULL);
-	if (!dir || !real_path || g_hash_table_lookup(visited_paths, real_path))
+	if (!dir)
+		return NULL;
+#endif
+
+	file_names = g_ptr_array_new();
+	dir_names = g_ptr_array_new();
+
+#ifdef G_OS_WIN32
+	while ((name = g_dir_read_name(dir)))
 	{
-		g_free(locale_path);
-		g_free(real_path);
-		if (dir)
-			g_dir_close(dir);
+		gchar *locale_filename = g_build_filename(locale_path, name, NULL);
+
+		if (g_file_test(locale_filename, G_FILE_TEST_IS_DIR))
+			g_ptr_array_add(dir_names, g_strdup(name));
+		else if (g_file_test(locale_filename, G_FILE_TEST_IS_REGULAR))
+			g_ptr_array_add(file_names, g_strdup(name));
+		g_free(locale_filename);
+	}
+	g_dir_close(dir);
+#else
+	while ((ent = readdir(dir)))
+	{
+		const gchar *name = ent->d_name;
+		gboolean is_dir = FALSE;
+		gboolean is_regular = FALSE;
+
+		if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+			continue;
+
+#ifdef DT_DIR
+		if (ent->d_type == DT_DIR)
+			is_dir = TRUE;
+		else if (ent->d_type == DT_REG)
+			is_regular = TRUE;
+		else if (ent->d_type == DT_LNK || ent->d_type == DT_UNKNOWN)
+#endif
+		{
+			gchar *locale_filename = g_build_filename(locale_path, name, NULL);
+			GStatBuf st;
+
+			if (g_stat(locale_filename, &st) == 0)
+			{
+				is_dir = S_ISDIR(st.st_mode);
+				is_regular = S_ISREG(st.st_mode);
+			}
+			g_free(locale_filename);
+		}
+
+		if (is_dir)
+			g_ptr_array_add(dir_names, g_strdup(name));
+		else if (is_regular)
+			g_ptr_array_add(file_names, g_strdup(name));
+	}
+	closedir(dir);
+#endif
+
+	g_ptr_array_add(file_names, NULL);
+	g_ptr_array_add(dir_names, NULL);
+
+	entry = g_new(DirCacheEntry, 1);
+	entry->mtime = mtime;
+	entry->file_names = (gchar **) g_ptr_array_free(file_names, FALSE);
+	entry->dir_names = (gchar **) g_ptr_array_free(dir_names, FALSE);
+
+	return entry;
+}
+
+
+/* gets the listing of dir from the previous scan if it is still valid, or
+ * reads it, and moves it to the new cache */
+static DirCacheEntry *get_dir_listing(ScanContext *ctx, ScanDir *dir)
+{
+	DirCacheEntry *entry = NULL;
+	gpointer key = NULL, value = NULL;
+	GStatBuf st;
+
+	if (g_stat(dir->locale_path, &st) != 0)
 		return NULL;
+
+	g_mutex_lock(&ctx->lock);
+	if (g_hash_table_lookup_extended(ctx->old_cache, dir->locale_path, &key, &value))
+	{
+		g_hash_table_steal(ctx->old_cache, dir->locale_path);
+		entry = value;
 	}
+	g_mutex_unlock(&ctx->lock);
 
-	g_hash_table_insert(visited_paths, real_path, GINT_TO_POINTER(1));
+	/* an entry modified during the second the previous scan started may have
+	 * changed after it was read without its mtime changing */
+	if (entry && (entry->mtime != (gint64) st.st_mtime || entry->mtime >= ctx->cache_time))
+	{
+		dir_cache_entry_free(entry);
+		entry = NULL;
+	}
+	if (!entry)
+	{
+		g_free(key);
+		key = g_strdup(dir->locale_path);
+		entry = read_dir(dir->locale_path, st.st_mtime);
+	}
 
-	while ((child_name = g_dir_read_name(dir)))
-		children = g_slist_prepend(children, g_strdup(child_name));
+	g_mutex_lock(&ctx->lock);
+	if (entry)
+		g_hash_table_insert(ctx->new_cache, key, entry);
+	else
+		g_free(key);
+	g_mutex_unlock(&ctx->lock);
+
+	return entry;
+}
+
+
+static gchar *scan_get_utf8(ScanContext *ctx, const gchar *locale_str)
+{
+	if (ctx->utf8_locale)
+		return g_strdup(locale_str);
+	return utils_get_utf8_from_locale(locale_str);
+}
 
-	g_dir_close(dir);
 
-	foreach_slist(child, children)
+static void scan_push_dir(ScanContext *ctx, ScanDir *parent, gchar *locale_path, gchar *utf8_path)
+{
+	ScanDir *dir = g_new0(ScanDir, 1);
+
+	dir->parent = parent;
+	dir->locale_path = locale_path;
+	dir->utf8_path = utf8_path;
+
+	g_mutex_lock(&ctx->lock);
+	g_ptr_array_add(ctx->dirs, dir);
+	ctx->pending++;
+	g_mutex_unlock(&ctx->lock);
+
+	g_thread_pool_push(ctx->pool, dir, NULL);
+}
+
+
+/* runs in the scan thread pool, scans one directory and queues its subdirectories */
+static void scan_dir_func(gpointer data, gpointer user_data)
+{
+	ScanDir *dir = data;
+	ScanContext *ctx = user_data;
+	gchar *real_path = utils_get_real_path(dir->locale_path);
+	DirCacheEntry *entry = NULL;
+	gboolean visited = TRUE;
+	gchar **name;
+
+	if (real_path)
 	{
-		const gchar *locale_name;
-		gchar *locale_filename, *utf8_filename, *utf8_name;
+		g_mutex_lock(&ctx->lock);
+		visited = g_hash_table_lookup(ctx->visited_paths, real_path) != NULL;
+		if (!visited)
+			g_hash_table_insert(ctx->visited_paths, real_path, GINT_TO_POINTER(1));
+		g_mutex_unlock(&ctx->lock);
+		if (visited)
+			g_free(real_path);
+	}
 
-		locale_name = child->data;
+	if (!visited)
+		entry = get_dir_listing(ctx, dir);
 
-		utf8_name = utils_get_utf8_from_locale(locale_name);
-		locale_filename = g_build_filename(locale_path, locale_name, NULL);
-		utf8_filename = utils_get_utf8_from_locale(locale_filename);
+	if (entry)
+	{
+		GPtrArray *files = g_ptr_array_new();
 
-		if (g_file_test(locale_filename, G_FILE_TEST_IS_DIR))
+		foreach_strv(name, entry->file_names)
 		{
-			GSList *lst;
+			gchar *utf8_name = scan_get_utf8(ctx, *name);
 
-			if (!patterns_match(ignored_dirs_patterns, utf8_name))
-			{
-				lst = get_file_list(utf8_filename, patterns, ignored_dirs_patterns,
-						ignored_file_patterns, visited_paths);
-				if (lst)
-					list = g_slist_concat(list, lst);
-				else if (prj_org->show_empty_dirs)
-					list = g_slist_prepend(list, g_build_path(G_DIR_SEPARATOR_S, utf8_filename, PROJORG_DIR_ENTRY, NULL));
-			}
+			if (patterns_match(ctx->patterns, utf8_name) && !patterns_match(ctx->ignored_file_patterns, utf8_name))
+				g_ptr_array_add(files, g_build_filename(dir->utf8_path, utf8_name, NULL));
+			g_free(utf8_name);
 		}
-		else if (g_file_test(locale_filename, G_FILE_TEST_IS_REGULAR))
+
+		foreach_strv(name, entry->dir_names)
 		{
-			if (patterns_match(patterns, utf8_name) && !patterns_match(ignored_file_patterns, utf8_name))
-				list = g_slist_prepend(list, g_strdup(utf8_filename));
+			gchar *utf8_name = scan_get_utf8(ctx, *name);
+
+			if (!patterns_match(ctx->ignored_dirs_patterns, utf8_name))
+				scan_push_dir(ctx, dir, g_build_filename(dir->locale_path, *name, NULL),
+					g_build_filename(dir->utf8_path, utf8_name, NULL));
+			g_free(utf8_name);
 		}
 
-		g_free(utf8_filename);
-		g_free(locale_filename);
-		g_free(utf8_name);
+		if (files->len > 0)
+		{
+			ScanDir *d = dir;
+			guint i;
+
+			g_mutex_lock(&ctx->lock);
+			for (i = 0; i < files->len; i++)
+				g_ptr_array_add(ctx->files, g_ptr_array_index(files, i));
+			g_mutex_unlock(&ctx->lock);
+
+			/* whoever finds an ancestor already marked doesn't need to go further */
+			while (d && g_atomic_int_compare_and_exchange(&d->has_files, FALSE, TRUE))
+				d = d->parent;
+		}
+		g_ptr_array_free(files, TRUE);
 	}
 
-	g_slist_free_full(children, g_free);
-	g_free(locale_path);
+	g_mutex_lock(&ctx->lock);
+	if (--ctx->pending == 0)
+		g_cond_signal(&ctx->done_cond);
+	g_mutex_unlock(&ctx->lock);
+}
+
 
-	return list;
+static void scan_dir_free(ScanDir *dir)
+{
+	g_free(dir->locale_path);
+	g_free(dir->utf8_path);
+	g_free(dir);
+}
+
+
+/* Scans root on a thread pool where each directory is a separate task so that
+ * idle threads pick up subtrees as they are discovered. Returns a flat array
+ * of utf8 paths. The directory listings are kept in root's dir_cache so that
+ * the next scan only reads directories whose mtime changed. */
+static GPtrArray *get_file_list(PrjOrgRoot *root, GSList *patterns,
+		GSList *ignored_dirs_patterns, GSList *ignored_file_patterns)
+{
+	ScanContext ctx;
+	guint i;
+
+	ctx.patterns = patterns;
+	ctx.ignored_dirs_patterns = ignored_dirs_patterns;
+	ctx.ignored_file_patterns = ignored_file_patterns;
+	ctx.utf8_locale = g_get_charset(NULL);
+	ctx.cache_time = root->dir_cache_time;
+	ctx.pending = 0;
+	ctx.old_cache = root->dir_cache;
+	ctx.new_cache = dir_cache_new();
+	ctx.visited_paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	ctx.files = g_ptr_array_new_with_free_func(g_free);
+	ctx.dirs = g_ptr_array_new_with_free_func((GDestroyNotify)scan_dir_free);
+	g_mutex_init(&ctx.lock);
+	g_cond_init(&ctx.done_cond);
+	ctx.pool = g_thread_pool_new(scan_dir_func, &ctx, g_get_num_processors(), FALSE, NULL);
+
+	root->dir_cache_time = g_get_real_time() / G_USEC_PER_SEC;
+
+	scan_push_dir(&ctx, NULL, utils_get_locale_from_utf8(root->base_dir), g_strdup(root->base_dir));
+
+	g_mutex_lock(&ctx.lock);
+	while (ctx.pending > 0)
+		g_cond_wait(&ctx.done_cond, &ctx.lock);
+	g_mutex_unlock(&ctx.lock);
+
+	g_thread_pool_free(ctx.pool, FALSE, TRUE);
+
+	if (prj_org->show_empty_dirs)
+	{
+		/* the root directory itself is never listed */
+		for (i = 1; i < ctx.dirs->len; i++)
+		{
+			ScanDir *dir = g_ptr_array_index(ctx.dirs, i);
+
+			if (!dir->has_files)
+				g_ptr_array_add(ctx.files, g_build_path(G_DIR_SEPARATOR_S, dir->utf8_path, PROJORG_DIR_ENTRY, NULL));
+		}
+	}
+
+	/* drops the directories that disappeared since the previous scan */
+	g_hash_table_destroy(root->dir_cache);
+	root->dir_cache = ctx.new_cache;
+
+	g_hash_table_destroy(ctx.visited_paths);
+	g_ptr_array_free(ctx.dirs, TRUE);
+	g_mutex_clear(&ctx.lock);
+	g_cond_clear(&ctx.done_cond);
+
+	return ctx.files;
 }
 
 
@@ -149,10 +476,8 @@ static gint prjorg_project_rescan_root(PrjOrgRoot *root)
 	GSList *pattern_list = NULL;
 	GSList *ignored_dirs_list = NULL;
 	GSList *ignored_file_list = NULL;
-	GHashTable *visited_paths;
-	GSList *lst;
-	GSList *elem = NULL;
-	gint filenum = 0;
+	GPtrArray *files;
+	guint i;
 
 	source_files = g_ptr_array_new();
 	g_hash_table_foreach(root->file_table, (GHFunc)collect_source_files, source_files);
@@ -172,23 +497,12 @@ static gint prjorg_project_rescan_root(PrjOrgRoot *root)
 	ignored_dirs_list = get_precompiled_patterns(prj_org->ignored_dirs_patterns);
 	ignored_file_list = get_precompiled_patterns(prj_org->ignored_file_patterns);
 
-	visited_paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-	lst = get_file_list(root->base_dir, pattern_list, ignored_dirs_list, ignored_file_list, visited_paths);
-	g_hash_table_destroy(visited_paths);
-
-	foreach_slist(elem, lst)
-	{
-		char *path = elem->data;
-
-		if (path)
-		{
-			g_hash_table_insert(root->file_table, g_strdup(path), NULL);
-			filenum++;
-		}
-	}
+	files = get_file_list(root, pattern_list, ignored_dirs_list, ignored_file_list);
 
-	g_slist_foreach(lst, (GFunc) g_free, NULL);
-	g_slist_free(lst);
+	/* steal the paths from the array */
+	g_ptr_array_set_free_func(files, NULL);
+	for (i = 0; i < files->len; i++)
+		g_hash_table_insert(root->file_table, g_ptr_array_index(files, i), NULL);
 
 	g_slist_foreach(pattern_list, (GFunc) g_pattern_spec_free, NULL);
 	g_slist_free(pattern_list);
@@ -199,41 +513,172 @@ static gint prjorg_project_rescan_root(PrjOrgRoot *root)
 	g_slist_foreach(ignored_file_list, (GFunc) g_pattern_spec_free, NULL);
 	g_slist_free(ignored_file_list);
 
-	return filenum;
+	i = files->len;
+	g_ptr_array_free(files, TRUE);
+
+	return (gint) i;
 }
 
 
-static gboolean match_basename(gconstpointer pft, gconstpointer user_data)
+static void filetype_glob_free(FiletypeGlob *glob)
 {
-	const GeanyFiletype *ft = pft;
-	const gchar *utf8_base_filename = user_data;
-	gint j;
-	gboolean ret = FALSE;
+	g_pattern_spec_free(glob->pattern);
+	g_free(glob);
+}
 
-	if (G_UNLIKELY(ft->id == GEANY_FILETYPES_NONE))
-		return FALSE;
 
-	for (j = 0; ft->pattern[j] != NULL; j++)
+static guint filetypes_fingerprint(void)
+{
+	guint hash = geany_data->filetypes_array->len;
+	guint i, j;
+
+	for (i = 0; i < geany_data->filetypes_array->len; i++)
 	{
-		GPatternSpec *pattern = g_pattern_spec_new(ft->pattern[j]);
+		GeanyFiletype *ft = filetypes[i];
+
+		hash = hash * 31 + g_direct_hash(ft);
+		for (j = 0; ft->pattern && ft->pattern[j]; j++)
+			hash = hash * 31 + g_str_hash(ft->pattern[j]);
+	}
+
+	return hash;
+}
 
-		if (g_pattern_spec_match_string(pattern, utf8_base_filename))
+
+static void filetype_matcher_add(FiletypeMatcher *matcher, const gchar *pattern, guint index)
+{
+	GHashTable *table = NULL;
+
+	if (!strpbrk(pattern, "*?"))
+		table = matcher->basenames;
+	else if (g_str_has_prefix(pattern, "*.") && !strpbrk(pattern + 2, "*?"))
+	{
+		table = matcher->extensions;
+		pattern += 2;
+	}
+
+	if (table)
+	{
+		/* keep the first filetype using the pattern */
+		if (!g_hash_table_contains(table, pattern))
+			g_hash_table_insert(table, g_strdup(pattern), GUINT_TO_POINTER(index + 1));
+	}
+	else
+	{
+		FiletypeGlob *glob = g_new(FiletypeGlob, 1);
+
+		glob->pattern = g_pattern_spec_new(pattern);
+		glob->index = index;
+		g_ptr_array_add(matcher->globs, glob);
+	}
+}
+
+
+static FiletypeMatcher *filetype_matcher_new(guint fingerprint)
+{
+	FiletypeMatcher *matcher = g_new0(FiletypeMatcher, 1);
+	guint i, j;
+
+	matcher->ref_count = 1;
+	matcher->fingerprint = fingerprint;
+	matcher->filetypes = g_ptr_array_new();
+	matcher->basenames = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	matcher->extensions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	matcher->globs = g_ptr_array_new_with_free_func((GDestroyNotify) filetype_glob_free);
+
+	for (i = 0; i < geany_data->filetypes_array->len; i++)
+	{
+		GeanyFiletype *ft = filetypes[i];
+
+		g_ptr_array_add(matcher->filetypes, ft);
+		if (G_UNLIKELY(ft->id == GEANY_FILETYPES_NONE) || !ft->pattern)
+			continue;
+
+		for (j = 0; ft->pattern[j] != NULL; j++)
+			filetype_matcher_add(matcher, ft->pattern[j], i);
+	}
+
+	return matcher;
+}
+
+
+static FiletypeMatcher *filetype_matcher_ref(FiletypeMatcher *matcher)
+{
+	g_atomic_int_inc(&matcher->ref_count);
+	return matcher;
+}
+
+
+static void filetype_matcher_unref(FiletypeMatcher *matcher)
+{
+	if (matcher && g_atomic_int_dec_and_test(&matcher->ref_count))
+	{
+		g_ptr_array_free(matcher->filetypes, TRUE);
+		g_hash_table_destroy(matcher->basenames);
+		g_hash_table_destroy(matcher->extensions);
+		g_ptr_array_free(matcher->globs, TRUE);
+		g_free(matcher);
+	}
+}
+
+
+/* returns the matcher for the current filetypes, the index is only rebuilt
+ * when the filetype definitions changed, e.g. after reloading configuration */
+static FiletypeMatcher *filetype_matcher_get(void)
+{
+	guint fingerprint = filetypes_fingerprint();
+
+	if (!s_filetype_matcher || s_filetype_matcher->fingerprint != fingerprint)
+	{
+		filetype_matcher_unref(s_filetype_matcher);
+		s_filetype_matcher = filetype_matcher_new(fingerprint);
+	}
+
+	return filetype_matcher_ref(s_filetype_matcher);
+}
+
+
+static GeanyFiletype *filetype_matcher_lookup(FiletypeMatcher *matcher, const gchar *utf8_base_filename)
+{
+	guint best = GPOINTER_TO_UINT(g_hash_table_lookup(matcher->basenames, utf8_base_filename));
+	const gchar *dot;
+	guint i;
+
+	/* "*.ext" matches any name ending with ".ext", including "*.tar.gz"-like extensions */
+	for (dot = strchr(utf8_base_filename, '.'); dot; dot = strchr(dot + 1, '.'))
+	{
+		guint index = GPOINTER_TO_UINT(g_hash_table_lookup(matcher->extensions, dot + 1));
+
+		if (index && (!best || index < best))
+			best = index;
+	}
+
+	for (i = 0; i < matcher->globs->len; i++)
+	{
+		FiletypeGlob *glob = g_ptr_array_index(matcher->globs, i);
+
+		if (best && glob->index + 1 >= best)
+			break;
+		if (g_pattern_spec_match_string(glob->pattern, utf8_base_filename))
 		{
-			ret = TRUE;
-			g_pattern_spec_free(pattern);
+			best = glob->index + 1;
 			break;
 		}
-		g_pattern_spec_free(pattern);
 	}
-	return ret;
+
+	return best ? g_ptr_array_index(matcher->filetypes, best - 1) : NULL;
 }
 
 
 /* Stolen and modified version from Geany. The only difference is that Geany
  * first looks at shebang inside the file and then, if it fails, checks the
  * file extension. Opening every file is too expensive so instead check just
- * extension and only if this fails, look at the shebang */
-static GeanyFiletype *filetypes_detect(const gchar *utf8_filename)
+ * extension and only if this fails, look at the shebang.
+ *
+ * This is the part looking at the file name only, it doesn't use Geany's API
+ * so it can be called from another thread. Returns NULL if the contents should
+ * be looked at. */
+static GeanyFiletype *filetypes_detect_from_name(FiletypeMatcher *matcher, const gchar *utf8_filename)
 {
 	GStatBuf s;
 	GeanyFiletype *ft = NULL;
@@ -244,7 +689,6 @@ static GeanyFiletype *filetypes_detect(const gchar *utf8_filename)
 		ft = filetypes[GEANY_FILETYPES_NONE];
 	else
 	{
-		guint i;
 		gchar *utf8_base_filename;
 
 		/* to match against the basename of the file (because of Makefile*) */
@@ -254,20 +698,7 @@ static GeanyFiletype *filetypes_detect(const gchar *utf8_filename)
 		SETPTR(utf8_base_filename, g_utf8_strdown(utf8_base_filename, -1));
 #endif
 
-		for (i = 0; i < geany_data->filetypes_array->len; i++)
-		{
-			GeanyFiletype *ftype = filetypes[i];
-
-			if (match_basename(ftype, utf8_base_filename))
-			{
-				ft = ftype;
-				break;
-			}
-		}
-
-		if (ft == NULL)
-			ft = filetypes_detect_from_file(utf8_filename);
-
+		ft = filetype_matcher_lookup(matcher, utf8_base_filename);
 		g_free(utf8_base_filename);
 	}
 
@@ -277,40 +708,174 @@ static GeanyFiletype *filetypes_detect(const gchar *utf8_filename)
 }
 
 
-static void regenerate_tags(PrjOrgRoot *root, gpointer user_data)
+static gpointer detect_filetypes_thread(gpointer data)
+{
+	TagGenerator *gen = data;
+	guint i;
+
+	for (i = 0; i < gen->files->len && !g_atomic_int_get(&gen->cancelled); i++)
+	{
+		TagFile *file = g_ptr_array_index(gen->files, i);
+
+		file->ft = filetypes_detect_from_name(gen->matcher, file->utf8_path);
+		/* publishes file->ft to the main thread */
+		g_atomic_int_inc(&gen->detected);
+	}
+
+	return NULL;
+}
+
+
+static void tag_file_free(TagFile *file)
+{
+	g_free(file->utf8_path);
+	g_free(file);
+}
+
+
+static void tag_generator_free(TagGenerator *gen)
+{
+	g_atomic_int_set(&gen->cancelled, TRUE);
+	if (gen->thread)
+		g_thread_join(gen->thread);
+	if (gen->source_id)
+		g_source_remove(gen->source_id);
+
+	g_ptr_array_free(gen->files, TRUE);
+	filetype_matcher_unref(gen->matcher);
+	g_strfreev(gen->session_files);
+	g_free(gen);
+}
+
+
+static void stop_tag_generation(void)
+{
+	if (s_tag_generator)
+	{
+		tag_generator_free(s_tag_generator);
+		s_tag_generator = NULL;
+		prjorg_sidebar_set_progress(-1, NULL);
+	}
+}
+
+
+void prjorg_project_cancel_tag_generation(void)
+{
+	stop_tag_generation();
+}
+
+
+static void update_tag_progress(TagGenerator *gen)
+{
+	gchar *text;
+
+	text = g_strdup_printf(_("Indexing %u/%u files"), gen->added, gen->files->len);
+	prjorg_sidebar_set_progress((gdouble) gen->added / gen->files->len, text);
+	g_free(text);
+}
+
+
+static gboolean add_tags_timeout(gpointer user_data)
+{
+	TagGenerator *gen = s_tag_generator;
+	gint64 start_time = g_get_monotonic_time();
+
+	/* add batches until we used our time slice or need to wait for detection */
+	while (gen->added < (guint) g_atomic_int_get(&gen->detected) &&
+		g_get_monotonic_time() - start_time < TAG_BATCH_TIME_US)
+	{
+		GPtrArray *source_files = g_ptr_array_new();
+		guint end = MIN((guint) g_atomic_int_get(&gen->detected), gen->added + TAG_BATCH_SIZE);
+
+		for (; gen->added < end; gen->added++)
+		{
+			TagFile *file = g_ptr_array_index(gen->files, gen->added);
+			gchar *locale_path;
+			gboolean will_open;
+			GeanyFiletype *ft;
+			TMSourceFile *sf;
+
+			/* skip files removed or indexed in the meantime */
+			if (!g_hash_table_contains(file->root->file_table, file->utf8_path) ||
+				g_hash_table_lookup(file->root->file_table, file->utf8_path))
+				continue;
+
+			locale_path = utils_get_locale_from_utf8(file->utf8_path);
+			will_open = gen->session_files && g_strv_contains((const gchar * const *) gen->session_files, file->utf8_path);
+			ft = file->ft ? file->ft : filetypes_detect_from_file(file->utf8_path);
+			sf = tm_source_file_new(locale_path, ft->name);
+
+			if (sf && !will_open && !document_find_by_filename(file->utf8_path))
+				g_ptr_array_add(source_files, sf);
+
+			g_hash_table_insert(file->root->file_table, g_strdup(file->utf8_path), sf);
+			g_free(locale_path);
+		}
+
+		tm_workspace_add_source_files(source_files);
+		g_ptr_array_free(source_files, TRUE);
+	}
+
+	if (gen->added < gen->files->len)
+	{
+		update_tag_progress(gen);
+		return TRUE;
+	}
+
+	/* the source is removed by returning FALSE */
+	gen->source_id = 0;
+	stop_tag_generation();
+	return FALSE;
+}
+
+
+static void collect_tag_files(PrjOrgRoot *root, GPtrArray *files)
 {
 	GHashTableIter iter;
 	gpointer key, value;
-	GPtrArray *source_files;
-	GHashTable *file_table;
-	const gchar **session_files;
 
-	session_files = (const gchar **) user_data;
-	source_files = g_ptr_array_new();
-	file_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GFreeFunc)tm_source_file_free);
 	g_hash_table_iter_init(&iter, root->file_table);
 	while (g_hash_table_iter_next(&iter, &key, &value))
 	{
-		TMSourceFile *sf = NULL;
 		gchar *utf8_path = key;
-		gchar *locale_path = utils_get_locale_from_utf8(utf8_path);
-		gchar *basename = g_path_get_basename(locale_path);
-		gboolean will_open = session_files && g_strv_contains(session_files, utf8_path);
+		gchar *basename = g_path_get_basename(utf8_path);
 
 		if (g_strcmp0(PROJORG_DIR_ENTRY, basename) != 0)
-			sf = tm_source_file_new(locale_path, filetypes_detect(utf8_path)->name);
-		if (sf && !will_open && !document_find_by_filename(utf8_path))
-			g_ptr_array_add(source_files, sf);
+		{
+			TagFile *file = g_new(TagFile, 1);
 
-		g_hash_table_insert(file_table, g_strdup(utf8_path), sf);
-		g_free(locale_path);
+			file->root = root;
+			file->utf8_path = g_strdup(utf8_path);
+			file->ft = NULL;
+			g_ptr_array_add(files, file);
+		}
 		g_free(basename);
 	}
-	g_hash_table_destroy(root->file_table);
-	root->file_table = file_table;
+}
 
-	tm_workspace_add_source_files(source_files);
-	g_ptr_array_free(source_files, TRUE);
+
+static void regenerate_tags(gchar **session_files)
+{
+	TagGenerator *gen;
+
+	stop_tag_generation();
+
+	gen = g_new0(TagGenerator, 1);
+	gen->files = g_ptr_array_new_with_free_func((GDestroyNotify) tag_file_free);
+	g_slist_foreach(prj_org->roots, (GFunc)collect_tag_files, gen->files);
+	if (gen->files->len == 0)
+	{
+		tag_generator_free(gen);
+		return;
+	}
+
+	gen->matcher = filetype_matcher_get();
+	gen->session_files = g_strdupv(session_files);
+	gen->thread = g_thread_new("prjorg-filetypes", detect_filetypes_thread, gen);
+	gen->source_id = plugin_timeout_add(geany_plugin, 10, add_tags_timeout, NULL);
+	s_tag_generator = gen;
+
+	update_tag_progress(gen);
 }
 
 
@@ -324,12 +889,13 @@ void rescan_project(gchar **session_files)
 
 	clear_idle_queue(&s_idle_add_funcs);
 	clear_idle_queue(&s_idle_remove_funcs);
+	stop_tag_generation();
 
 	foreach_slist(elem, prj_org->roots)
 		filenum += prjorg_project_rescan_root(elem->data);
 
 	if (prj_org->generate_tag_prefs == PrjOrgTagYes || (prj_org->generate_tag_prefs == PrjOrgTagAuto && filenum < 1000))
-		g_slist_foreach(prj_org->roots, (GFunc)regenerate_tags, session_files);
+		regenerate_tags(session_files);
 }
 
 
@@ -342,6 +908,8 @@ static PrjOrgRoot *create_root(const gchar *utf8_base_dir)
 	PrjOrgRoot *root = (PrjOrgRoot *) g_new0(PrjOrgRoot, 1);
 	root->base_dir = g_strdup(utf8_base_dir);
 	root->file_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GFreeFunc)tm_source_file_free);
+	root->dir_cache = dir_cache_new();
+	root->dir_cache_time = 0;
 	return root;
 }
 
@@ -355,8 +923,12 @@ static void update_project(
 	PrjOrgTagPrefs generate_tag_prefs,
 	gboolean show_empty_dirs)
 {
+	PrjOrgRoot *old_root, *new_root;
 	gchar *utf8_base_path;
 
+	/* the files being indexed belong to the roots we are about to replace */
+	stop_tag_generation();
+
 	if (prj_org->source_patterns)
 		g_strfreev(prj_org->source_patterns);
 	prj_org->source_patterns = g_strdupv(source_patterns);
@@ -377,11 +949,23 @@ static void update_project(
 	prj_org->show_empty_dirs = show_empty_dirs;
 
 	/* re-read the base path in case it was changed in project settings */
-	g_free(prj_org->roots->data);
+	old_root = prj_org->roots->data;
 	prj_org->roots = g_slist_delete_link(prj_org->roots, prj_org->roots);
 	utf8_base_path = get_project_base_path();
-	prj_org->roots = g_slist_prepend(prj_org->roots, create_root(utf8_base_path));
+	new_root = create_root(utf8_base_path);
+	if (g_strcmp0(old_root->base_dir, new_root->base_dir) == 0)
+	{
+		/* keep the directory listings of the previous scan */
+		GHashTable *dir_cache = new_root->dir_cache;
+
+		new_root->dir_cache = old_root->dir_cache;
+		new_root->dir_cache_time = old_root->dir_cache_time;
+		old_root->dir_cache = dir_cache;
+	}
+	prj_org->roots = g_slist_prepend(prj_org->roots, new_root);
 	g_free(utf8_base_path);
+	g_hash_table_destroy(old_root->dir_cache);
+	g_free(old_root);
 
 	rescan_project(session_files);
 }
@@ -440,6 +1024,7 @@ static void close_root(PrjOrgRoot *root, gpointer user_data)
 	g_ptr_array_free(source_files, TRUE);
 
 	g_hash_table_destroy(root->file_table);
+	g_hash_table_destroy(root->dir_cache);
 	g_free(root->base_dir);
 	g_free(root);
 }
@@ -492,6 +1077,7 @@ void prjorg_project_remove_external_dir(const gchar *utf8_dirname)
 	{
 		PrjOrgRoot *found_root = found->data;
 
+		stop_tag_generation();
 		prj_org->roots = g_slist_remove(prj_org->roots, found_root);
 		close_root(found_root, NULL);
 		prjorg_project_rescan();
@@ -803,6 +1389,9 @@ void prjorg_project_close(void)
 
 	clear_idle_queue(&s_idle_add_funcs);
 	clear_idle_queue(&s_idle_remove_funcs);
+	stop_tag_generation();
+	filetype_matcher_unref(s_filetype_matcher);
+	s_filetype_matcher = NULL;
 
 	g_slist_foreach(prj_org->roots, (GFunc)close_root, NULL);
 	g_slist_free(prj_org->roots);
@@ -30,6 +30,8 @@ typedef struct
 {
 	gchar *base_dir;
 	GHashTable *file_table; /* contains all file names within base_dir, maps file_name->TMSourceFile */
+	GHashTable *dir_cache; /* directory listings from the last scan, maps locale dir path->listing */
+	gint64 dir_cache_time; /* time the last scan started, in seconds */
 } PrjOrgRoot;
 
 typedef enum
@@ -63,6 +65,7 @@ void prjorg_project_close(void);
 void prjorg_project_save(GKeyFile * key_file);
 void prjorg_project_read_properties_tab(void);
 void prjorg_project_rescan(void);
+void prjorg_project_cancel_tag_generation(void);
 
 void prjorg_project_add_external_dir(const gchar *utf8_dirname);
 void prjorg_project_remove_external_dir(const gchar *utf8_dirname);
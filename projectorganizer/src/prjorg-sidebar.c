@@ -62,6 +62,8 @@ static gboolean s_pending_reload = FALSE;
 
 static GtkWidget *s_file_view_vbox = NULL;
 static GtkWidget *s_file_view = NULL;
+static GtkWidget *s_progress_box = NULL;
+static GtkWidget *s_progress_bar = NULL;
 static GtkTreeStore *s_file_store = NULL;
 static gboolean s_follow_editor = TRUE;
 
@@ -1669,6 +1671,30 @@ static void sidebar_realized_cb (GtkWidget *widget) {
 }
 
 
+static void on_stop_indexing(G_GNUC_UNUSED GtkButton *button, G_GNUC_UNUSED gpointer user_data)
+{
+	prjorg_project_cancel_tag_generation();
+}
+
+
+/* negative fraction hides the progress bar */
+void prjorg_sidebar_set_progress(gdouble fraction, const gchar *text)
+{
+	if (!s_progress_box)
+		return;
+
+	if (fraction < 0)
+	{
+		gtk_widget_hide(s_progress_box);
+		return;
+	}
+
+	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(s_progress_bar), MIN(fraction, 1.0));
+	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(s_progress_bar), text);
+	gtk_widget_show_all(s_progress_box);
+}
+
+
 void prjorg_sidebar_init(void)
 {
 	GtkWidget *scrollwin, *item, *image;
@@ -1869,7 +1895,26 @@ void prjorg_sidebar_init(void)
 	gtk_container_add(GTK_CONTAINER(scrollwin), s_file_view);
 	gtk_box_pack_start(GTK_BOX(s_file_view_vbox), scrollwin, TRUE, TRUE, 0);
 
+	/**** indexing progress ****/
+
+	s_progress_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+	s_progress_bar = gtk_progress_bar_new();
+	gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(s_progress_bar), TRUE);
+	gtk_progress_bar_set_ellipsize(GTK_PROGRESS_BAR(s_progress_bar), PANGO_ELLIPSIZE_END);
+	gtk_widget_set_valign(s_progress_bar, GTK_ALIGN_CENTER);
+	gtk_box_pack_start(GTK_BOX(s_progress_box), s_progress_bar, TRUE, TRUE, 2);
+
+	item = gtk_button_new();
+	gtk_button_set_relief(GTK_BUTTON(item), GTK_RELIEF_NONE);
+	gtk_button_set_image(GTK_BUTTON(item), gtk_image_new_from_icon_name("process-stop", GTK_ICON_SIZE_MENU));
+	gtk_widget_set_tooltip_text(item, _("Stop indexing"));
+	g_signal_connect(item, "clicked", G_CALLBACK(on_stop_indexing), NULL);
+	gtk_box_pack_start(GTK_BOX(s_progress_box), item, FALSE, FALSE, 0);
+
+	gtk_box_pack_start(GTK_BOX(s_file_view_vbox), s_progress_box, FALSE, FALSE, 0);
+
 	gtk_widget_show_all(s_file_view_vbox);
+	gtk_widget_hide(s_progress_box);
 	gtk_notebook_append_page(GTK_NOTEBOOK(geany->main_widgets->sidebar_notebook),
 				 s_file_view_vbox, gtk_label_new(_("Project")));
 }
@@ -1884,4 +1929,6 @@ void prjorg_sidebar_activate(gboolean activate)
 void prjorg_sidebar_cleanup(void)
 {
 	gtk_widget_destroy(s_file_view_vbox);
+	s_progress_box = NULL;
+	s_progress_bar = NULL;
 }
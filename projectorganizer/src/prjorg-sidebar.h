@@ -35,6 +35,8 @@ void prjorg_sidebar_focus_project_tab(void);
 
 gchar **prjorg_sidebar_get_expanded_paths(void);
 
+void prjorg_sidebar_set_progress(gdouble fraction, const gchar *text);
+
 void on_open_file_manager(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer user_data);
 void on_open_terminal(G_GNUC_UNUSED GtkMenuItem * menuitem, G_GNUC_UNUSED gpointer user_data);
 
@@ -371,6 +371,9 @@ static void gdb_exit_cb(G_GNUC_UNUSED GPid pid, gint status, G_GNUC_UNUSED gpoin
 	else if (thread_count)
 		ui_set_statusbar(FALSE, _("Program terminated."));
 
+	if (pref_parse_statistics)
+		parse_statistics_show();
+
 	views_clear();
 	utils_lock_all(FALSE);
 	update_state(DS_INACTIVE);
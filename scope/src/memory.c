@@ -35,7 +35,8 @@ enum
 	MEMORY_ASCII
 };
 
-static ScpTreeStore *store;
+static GtkTreeView *memory_tree;
+static GtkTreeModel *memory_model;
 static GtkTreeSelection *selection;
 
 static void on_memory_bytes_edited(G_GNUC_UNUSED GtkCellRendererText *renderer, gchar *path_str,
@@ -44,11 +45,13 @@ static void on_memory_bytes_edited(G_GNUC_UNUSED GtkCellRendererText *renderer,
 	if (*new_text && (debug_state() & DS_VARIABLE))
 	{
 		GtkTreeIter iter;
-		const char *addr, *bytes;
+		gchar *addr, *bytes;
 		guint i;
 
-		scp_tree_store_get_iter_from_string(store, &iter, path_str);
-		scp_tree_store_get(store, &iter, MEMORY_ADDR, &addr, MEMORY_BYTES, &bytes, -1);
+		if (!gtk_tree_model_get_iter_from_string(memory_model, &iter, path_str))
+			return;
+
+		gtk_tree_model_get(memory_model, &iter, MEMORY_ADDR, &addr, MEMORY_BYTES, &bytes, -1);
 
 		for (i = 0; bytes[i]; i++)
 			if (!(isxdigit(bytes[i]) ? isxdigit(new_text[i]) : new_text[i] == ' '))
@@ -61,6 +64,9 @@ static void on_memory_bytes_edited(G_GNUC_UNUSED GtkCellRendererText *renderer,
 			utils_strchrepl(new_text, ' ', '\0');
 			debug_send_format(T, "07-data-write-memory-bytes 0x%s%s", addr, new_text);
 		}
+
+		g_free(addr);
+		g_free(bytes);
 	}
 	else
 		plugin_blink();
@@ -137,78 +143,319 @@ static void memory_configure(void)
 }
 
 static guint64 memory_start;
-static guint memory_count = 0;
-#define MAX_BYTES (124 * MAX_BYTES_PER_LINE)
+static guint memory_count = 0;  /* bytes in the range */
+static guint memory_shown = 0;  /* bytes received */
+static GByteArray *memory_data;
+static GByteArray *memory_valid;
+#define MAX_BYTES 0x1000000
+#define MEMORY_CHUNK 0x8000
+
+static guint memory_rows(void)
+{
+	return (memory_shown + bytes_per_line - 1) / bytes_per_line;
+}
+
+static gchar *memory_ascii[0x100];
+static const char memory_hex[] = "0123456789abcdef";
 
-static void write_block(guint64 start, const char *contents, guint count, const char *maddr)
+static gchar *memory_format(guint row, gint column)
 {
-	if (!memory_count)
-		memory_start = start;
-	else if (memory_count < MAX_BYTES)
-		memory_count = start - memory_start;
+	guint offset = row * bytes_per_line;
+	GString *text;
+	gint n;
 
-	while (memory_count < MAX_BYTES)
-	{
-		GtkTreeIter iter;
-		char *addr = g_strdup_printf(addr_format, start);
-		GString *bytes = g_string_sized_new(bytes_per_line * 3);
-		GString *ascii = g_string_new(" ");
-		gint n = 0;
+	if (column == MEMORY_ADDR)
+		return g_strdup_printf(addr_format, memory_start + offset);
 
-		while (n < bytes_per_line)
-		{
-			char locale;
-			gchar *utf8;
+	text = g_string_sized_new(bytes_per_line * 3);
 
-			g_string_append_len(bytes, contents, 2);
-			contents += 2;
-			memory_count++;
-			locale = strtol(bytes->str + bytes->len - 2, NULL, 16);
-			utf8 = locale >= 0x20 ? g_locale_to_utf8(&locale, 1, NULL, NULL, NULL) : NULL;
+	if (column == MEMORY_ASCII)
+		g_string_append_c(text, ' ');
 
-			if (utf8)
+	for (n = 0; n < bytes_per_line; offset++)
+	{
+		gboolean valid = offset < memory_shown && memory_valid->data[offset];
+		guint8 byte = valid ? memory_data->data[offset] : 0;
+
+		if (column == MEMORY_BYTES)
+		{
+			if (valid)
 			{
-				g_string_append(ascii, utf8);
-				g_free(utf8);
+				g_string_append_c(text, memory_hex[byte >> 4]);
+				g_string_append_c(text, memory_hex[byte & 0x0F]);
 			}
 			else
-				g_string_append_c(ascii, '.');  /* 0xfffd? */
+				g_string_append(text, offset < memory_shown ? "??" : "  ");
 
 			if (++n % bytes_per_group == 0)
-				g_string_append_c(bytes, ' ');
-
-			if (!--count)
-				break;
+				g_string_append_c(text, ' ');
 		}
+		else
+		{
+			if (offset < memory_shown)
+				g_string_append(text, valid ? memory_ascii[byte] : ".");
+			n++;
+		}
+	}
+
+	return g_string_free(text, FALSE);
+}
+
+/* a flat list model over the raw bytes, formatting only the rows that are displayed */
+static gint memory_stamp = 1;
+
+#define MEMORY_ROW(iter) GPOINTER_TO_UINT((iter)->user_data)
+
+static gboolean memory_model_set_iter(GtkTreeIter *iter, guint row)
+{
+	if (row < memory_rows())
+	{
+		iter->stamp = memory_stamp;
+		iter->user_data = GUINT_TO_POINTER(row);
+		return TRUE;
+	}
+
+	iter->stamp = 0;
+	return FALSE;
+}
+
+static GtkTreeModelFlags memory_model_get_flags(G_GNUC_UNUSED GtkTreeModel *model)
+{
+	return GTK_TREE_MODEL_ITERS_PERSIST | GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint memory_model_get_n_columns(G_GNUC_UNUSED GtkTreeModel *model)
+{
+	return MEMORY_ASCII + 1;
+}
+
+static GType memory_model_get_column_type(G_GNUC_UNUSED GtkTreeModel *model,
+	G_GNUC_UNUSED gint index)
+{
+	return G_TYPE_STRING;
+}
+
+static gboolean memory_model_get_iter(G_GNUC_UNUSED GtkTreeModel *model, GtkTreeIter *iter,
+	GtkTreePath *path)
+{
+	return gtk_tree_path_get_depth(path) == 1 &&
+		memory_model_set_iter(iter, gtk_tree_path_get_indices(path)[0]);
+}
+
+static GtkTreePath *memory_model_get_path(G_GNUC_UNUSED GtkTreeModel *model,
+	GtkTreeIter *iter)
+{
+	g_return_val_if_fail(iter->stamp == memory_stamp, NULL);
+	return gtk_tree_path_new_from_indices(MEMORY_ROW(iter), -1);
+}
+
+static void memory_model_get_value(G_GNUC_UNUSED GtkTreeModel *model, GtkTreeIter *iter,
+	gint column, GValue *value)
+{
+	g_return_if_fail(iter->stamp == memory_stamp);
+	g_value_init(value, G_TYPE_STRING);
+	g_value_take_string(value, memory_format(MEMORY_ROW(iter), column));
+}
+
+static gboolean memory_model_iter_next(G_GNUC_UNUSED GtkTreeModel *model, GtkTreeIter *iter)
+{
+	g_return_val_if_fail(iter->stamp == memory_stamp, FALSE);
+	return memory_model_set_iter(iter, MEMORY_ROW(iter) + 1);
+}
+
+static gboolean memory_model_iter_nth_child(G_GNUC_UNUSED GtkTreeModel *model,
+	GtkTreeIter *iter, GtkTreeIter *parent, gint n)
+{
+	if (parent)
+	{
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	return memory_model_set_iter(iter, n);
+}
+
+static gboolean memory_model_iter_children(GtkTreeModel *model, GtkTreeIter *iter,
+	GtkTreeIter *parent)
+{
+	return memory_model_iter_nth_child(model, iter, parent, 0);
+}
+
+static gboolean memory_model_iter_has_child(G_GNUC_UNUSED GtkTreeModel *model,
+	G_GNUC_UNUSED GtkTreeIter *iter)
+{
+	return FALSE;
+}
+
+static gint memory_model_iter_n_children(G_GNUC_UNUSED GtkTreeModel *model,
+	GtkTreeIter *iter)
+{
+	return iter ? 0 : (gint) memory_rows();
+}
+
+static gboolean memory_model_iter_parent(G_GNUC_UNUSED GtkTreeModel *model,
+	GtkTreeIter *iter, G_GNUC_UNUSED GtkTreeIter *child)
+{
+	iter->stamp = 0;
+	return FALSE;
+}
+
+static void memory_model_tree_model_init(GtkTreeModelIface *iface)
+{
+	iface->get_flags = memory_model_get_flags;
+	iface->get_n_columns = memory_model_get_n_columns;
+	iface->get_column_type = memory_model_get_column_type;
+	iface->get_iter = memory_model_get_iter;
+	iface->get_path = memory_model_get_path;
+	iface->get_value = memory_model_get_value;
+	iface->iter_next = memory_model_iter_next;
+	iface->iter_children = memory_model_iter_children;
+	iface->iter_has_child = memory_model_iter_has_child;
+	iface->iter_n_children = memory_model_iter_n_children;
+	iface->iter_nth_child = memory_model_iter_nth_child;
+	iface->iter_parent = memory_model_iter_parent;
+}
+
+static GType memory_model_register(void)
+{
+	GType type = g_type_from_name("ScpMemoryModel");
+
+	if (!type)
+	{
+		GInterfaceInfo iface_info = { (GInterfaceInitFunc) memory_model_tree_model_init,
+			NULL, NULL };
+
+		type = g_type_register_static_simple(G_TYPE_OBJECT, g_intern_string("ScpMemoryModel"),
+			sizeof(GObjectClass), NULL, sizeof(GObject), NULL, 0);
+		g_type_add_interface_static(type, GTK_TYPE_TREE_MODEL, &iface_info);
+		g_type_class_unref(g_type_class_ref(type));  /* force class creation */
+	}
+	else
+	{
+		/* registered by a previous load of the plugin, repair */
+		gpointer class = g_type_class_peek(type);
+
+		memory_model_tree_model_init((GtkTreeModelIface *)
+			g_type_interface_peek(class, GTK_TYPE_TREE_MODEL));
+	}
+
+	return type;
+}
 
-		while (n < bytes_per_line)
+static void memory_columns_resize(void)
+{
+	static const char *const columns[] = { "memory_addr_column", "memory_bytes_column",
+		"memory_ascii_column" };
+	gchar *sample = g_strdup_printf(addr_format, (guint64) 0);
+	gint column;
+
+	for (column = MEMORY_ADDR; column <= MEMORY_ASCII; column++)
+	{
+		PangoLayout *layout;
+		gint width;
+
+		if (column != MEMORY_ADDR)
 		{
-			g_string_append(bytes, "  ");
+			g_free(sample);
+			sample = g_strnfill(column == MEMORY_BYTES ? bytes_per_line * 2 +
+				bytes_per_line / bytes_per_group : bytes_per_line + 1, '0');
+		}
 
-			if (++n % bytes_per_group == 0)
-				g_string_append_c(bytes, ' ');
+		layout = gtk_widget_create_pango_layout(GTK_WIDGET(memory_tree), sample);
+		pango_layout_get_pixel_size(layout, &width, NULL);
+		g_object_unref(layout);
+		/* the cell padding is not known until realize, 8 is plenty */
+		gtk_tree_view_column_set_fixed_width(get_column(columns[column]), width + 8);
+	}
+
+	g_free(sample);
+}
+
+static void memory_model_reset(void)
+{
+	GtkTreeIter iter;
+	guint offset = G_MAXUINT;
+
+	if (gtk_tree_selection_get_selected(selection, NULL, &iter))
+		offset = MEMORY_ROW(&iter) * bytes_per_line;
+
+	gtk_tree_view_set_model(memory_tree, NULL);
+	memory_stamp++;
+
+	if (pref_memory_bytes_per_line != back_bytes_per_line)
+		memory_configure();
+
+	memory_columns_resize();
+	gtk_tree_view_set_model(memory_tree, memory_model);
+
+	if (memory_model_set_iter(&iter, offset / bytes_per_line))
+		gtk_tree_selection_select_iter(selection, &iter);
+}
+
+static void memory_rows_inserted(guint row)
+{
+	if (gtk_tree_view_get_model(memory_tree))
+	{
+		GtkTreePath *path = gtk_tree_path_new_from_indices(row, -1);
+		GtkTreeIter iter;
+
+		while (memory_model_set_iter(&iter, row++))
+		{
+			gtk_tree_model_row_inserted(memory_model, path, &iter);
+			gtk_tree_path_next(path);
 		}
 
-		scp_tree_store_append_with_values(store, &iter, NULL, MEMORY_ADDR, addr,
-			MEMORY_BYTES, bytes->str, MEMORY_ASCII, ascii->str, -1);
-		if (!g_strcmp0(addr, maddr))
-			gtk_tree_selection_select_iter(selection, &iter);
+		gtk_tree_path_free(path);
+	}
+}
 
-		g_free(addr);
-		g_string_free(bytes, TRUE);
-		g_string_free(ascii, TRUE);
+static void memory_store_block(guint64 start, const char *contents, guint count)
+{
+	guint rows = memory_rows();
+	guint offset, end, i;
 
-		if (!count)
-			break;
+	if (!memory_count)
+		memory_start = start;
 
-		start += bytes_per_line;
+	if (start < memory_start || start - memory_start >= MAX_BYTES)
+	{
+		dc_error("memory: too much data");
+		return;
 	}
 
-	if (count)
+	offset = start - memory_start;
+	if (count > MAX_BYTES - offset)
+	{
+		count = MAX_BYTES - offset;
 		dc_error("memory: too much data");
+	}
+
+	end = offset + count;
+	if (end > memory_data->len)
+	{
+		guint len = memory_data->len;
+
+		g_byte_array_set_size(memory_data, end);
+		g_byte_array_set_size(memory_valid, end);
+		memset(memory_valid->data + len, FALSE, end - len);
+	}
+
+	for (i = offset; i < end; i++, contents += 2)
+	{
+		memory_data->data[i] = (g_ascii_xdigit_value(contents[0]) << 4) |
+			g_ascii_xdigit_value(contents[1]);
+		memory_valid->data[i] = TRUE;
+	}
+
+	memory_count = MAX(memory_count, end);
+	if (end > memory_shown)
+	{
+		memory_shown = end;
+		memory_rows_inserted(rows);
+	}
 }
 
-static void memory_node_read(const ParseNode *node, const char *maddr)
+static void memory_node_read(const ParseNode *node, G_GNUC_UNUSED gpointer gdata)
 {
 	iff (node->type == PT_ARRAY, "memory: contains value")
 	{
@@ -226,55 +473,124 @@ static void memory_node_read(const ParseNode *node, const char *maddr)
 				start += g_ascii_strtoull(offset, NULL, 0);
 
 			iff (count, "memory: contents too short")
-				write_block(start, contents, count, maddr);
+				memory_store_block(start, contents, MIN(count, MAX_BYTES));
 		}
 	}
 }
 
+/* chunked reads of the current range, stale generations are ignored */
+static guint memory_generation = 0;
+static guint memory_next;
+static guint memory_end;
+static gboolean memory_pending = FALSE;
+static gboolean memory_loud;
+
+static void memory_send_chunk(void)
+{
+	guint count = MIN(memory_end - memory_next, MEMORY_CHUNK);
+
+	debug_send_format(T, "09%u-data-read-memory-bytes 0x%" G_GINT64_MODIFIER "x %u",
+		memory_generation, memory_start + memory_next, count);
+	memory_next += count;
+	memory_pending = TRUE;
+}
+
+static void memory_read(guint next, guint end, gboolean loud)
+{
+	memory_generation++;
+	memory_next = next;
+	memory_end = MIN(end, MAX_BYTES);
+	memory_loud = loud;
+
+	if (memory_next < memory_end)
+		memory_send_chunk();
+}
+
+static gboolean memory_token_current(GArray *nodes)
+{
+	const char *token = parse_grab_token(nodes);
+	return token && strtoul(token, NULL, 10) == memory_generation;
+}
+
 void on_memory_read_bytes(GArray *nodes)
 {
 	if (pointer_size <= MAX_POINTER_SIZE)
 	{
-		GtkTreeIter iter;
-		char *maddr = NULL;
+		if (parse_find_node(nodes, "=token"))
+		{
+			if (!memory_token_current(nodes))
+				return;
 
-		if (gtk_tree_selection_get_selected(selection, NULL, &iter))
-			gtk_tree_model_get((GtkTreeModel *) store, &iter, MEMORY_ADDR, &maddr, -1);
+			memory_pending = FALSE;
+			if (pref_memory_bytes_per_line != back_bytes_per_line)
+				memory_model_reset();
 
-		store_clear(store);
-		memory_count = 0;
+			parse_foreach(parse_lead_array(nodes), (GFunc) memory_node_read, NULL);
+			gtk_widget_queue_draw(GTK_WIDGET(memory_tree));
 
-		if (pref_memory_bytes_per_line != back_bytes_per_line)
+			if (memory_next < memory_end)
+				memory_send_chunk();
+		}
+		else
 		{
-			memory_configure();
-			gtk_tree_view_column_queue_resize(get_column("memory_bytes_column"));
-			gtk_tree_view_column_queue_resize(get_column("memory_ascii_column"));
+			/* a read typed by the user, replaces the range */
+			memory_generation++;
+			memory_pending = FALSE;
+			memory_count = memory_shown = 0;
+			g_byte_array_set_size(memory_data, 0);
+			g_byte_array_set_size(memory_valid, 0);
+			gtk_tree_view_set_model(memory_tree, NULL);
+			parse_foreach(parse_lead_array(nodes), (GFunc) memory_node_read, NULL);
+			memory_model_reset();
 		}
+	}
+}
+
+void on_memory_read_error(GArray *nodes)
+{
+	if (memory_token_current(nodes))
+	{
+		memory_pending = FALSE;
+		memory_next = memory_end;
 
-		parse_foreach(parse_lead_array(nodes), (GFunc) memory_node_read, maddr);
-		g_free(maddr);
+		if (memory_loud)
+			on_error(nodes);
+		else
+			plugin_blink();
+	}
+}
+
+static void on_memory_scroll(GtkAdjustment *adjustment, G_GNUC_UNUSED gpointer gdata)
+{
+	if (memory_count && !memory_pending && memory_count < MAX_BYTES &&
+		(debug_state() & DS_VARIABLE) && gtk_adjustment_get_value(adjustment) +
+		2 * gtk_adjustment_get_page_size(adjustment) >= gtk_adjustment_get_upper(adjustment))
+	{
+		memory_read(memory_count, memory_count + MEMORY_CHUNK, FALSE);
 	}
 }
 
 void memory_clear(void)
 {
-	store_clear(store);
+	memory_generation++;
+	memory_pending = FALSE;
+	memory_shown = 0;
+	g_byte_array_set_size(memory_data, 0);
+	g_byte_array_set_size(memory_valid, 0);
+	memory_model_reset();
 }
 
 gboolean memory_update(void)
 {
 	if (memory_count)
-	{
-		debug_send_format(T, "04-data-read-memory-bytes 0x%" G_GINT64_MODIFIER "x %u",
-			memory_start, memory_count);
-	}
+		memory_read(0, memory_count, FALSE);
+
 	return TRUE;
 }
 
 static void on_memory_refresh(G_GNUC_UNUSED const MenuItem *menu_item)
 {
-	debug_send_format(T, "-data-read-memory-bytes 0x%" G_GINT64_MODIFIER "x %u",
-		memory_start, memory_count);
+	memory_read(0, memory_count, TRUE);
 }
 
 static void on_memory_read(G_GNUC_UNUSED const MenuItem *menu_item)
@@ -300,25 +616,27 @@ static void on_memory_read(G_GNUC_UNUSED const MenuItem *menu_item)
 static void on_memory_copy(G_GNUC_UNUSED const MenuItem *menu_item)
 {
 	GtkTreeIter iter;
-	const char *addr, *bytes;
-	const gchar *ascii;
+	gchar *addr, *bytes, *ascii;
 	gchar *string;
 
 	if (gtk_tree_selection_get_selected(selection, NULL, &iter))
 	{
-		scp_tree_store_get(store, &iter, MEMORY_ADDR, &addr, MEMORY_BYTES, &bytes,
+		gtk_tree_model_get(memory_model, &iter, MEMORY_ADDR, &addr, MEMORY_BYTES, &bytes,
 			MEMORY_ASCII, &ascii, -1);
 		string = g_strdup_printf("%s%s%s", addr, bytes, ascii);
 		gtk_clipboard_set_text(gtk_widget_get_clipboard(menu_item->widget,
 			GDK_SELECTION_CLIPBOARD), string, -1);
 		g_free(string);
+		g_free(addr);
+		g_free(bytes);
+		g_free(ascii);
 	}
 }
 
 static void on_memory_clear(G_GNUC_UNUSED const MenuItem *menu_item)
 {
-	store_clear(store);
 	memory_count = 0;
+	memory_clear();
 }
 
 static void on_memory_group_display(const MenuItem *menu_item)
@@ -333,9 +651,7 @@ static void on_memory_group_update(const MenuItem *menu_item)
 {
 	bytes_per_group = 1 << GPOINTER_TO_INT(menu_item->gdata);
 	back_bytes_per_line = 0;
-
-	if (memory_count)
-		on_memory_refresh(menu_item);
+	memory_model_reset();
 }
 
 #define DS_FRESHABLE (DS_VRIABLE | DS_EXTRA_2)
@@ -382,8 +698,21 @@ static gboolean on_memory_key_press(G_GNUC_UNUSED GtkWidget *widget, GdkEventKey
 
 void memory_init(void)
 {
-	GtkWidget *tree = GTK_WIDGET(view_connect("memory_view", &store, &selection,
+	GtkWidget *tree = GTK_WIDGET(view_connect("memory_view", NULL, &selection,
 		memory_cells, "memory_window", NULL));
+	guint i;
+
+	memory_tree = GTK_TREE_VIEW(tree);
+	memory_model = g_object_new(memory_model_register(), NULL);
+	memory_data = g_byte_array_new();
+	memory_valid = g_byte_array_new();
+
+	for (i = 0; i < G_N_ELEMENTS(memory_ascii); i++)
+	{
+		char locale = i;
+		gchar *utf8 = locale >= 0x20 ? g_locale_to_utf8(&locale, 1, NULL, NULL, NULL) : NULL;
+		memory_ascii[i] = utf8 ? utf8 : g_strdup(".");  /* 0xfffd? */
+	}
 
 	memory_font = *pref_memory_font ? pref_memory_font : pref_vte_font;
 	ui_widget_modify_font_from_string(tree, memory_font);
@@ -391,10 +720,15 @@ void memory_init(void)
 		G_CALLBACK(on_memory_bytes_editing_started), NULL);
 	g_signal_connect(tree, "key-press-event", G_CALLBACK(on_memory_key_press),
 		(gpointer) menu_item_find(memory_menu_items, "memory_read"));
+	g_signal_connect(gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(
+		get_widget("memory_window"))), "value-changed", G_CALLBACK(on_memory_scroll), NULL);
 
 	pointer_size = MAX(sizeof(void *), sizeof(&memory_init));
 	addr_format = g_strdup_printf("%%0%u" G_GINT64_MODIFIER "x  ", pointer_size * 2);
 	memory_configure();
+	memory_columns_resize();
+	gtk_tree_view_set_fixed_height_mode(memory_tree, TRUE);
+	gtk_tree_view_set_model(memory_tree, memory_model);
 
 	if (pointer_size > MAX_POINTER_SIZE)
 	{
@@ -407,5 +741,14 @@ void memory_init(void)
 
 void memory_finalize(void)
 {
+	guint i;
+
+	g_object_unref(memory_model);
+	g_byte_array_free(memory_data, TRUE);
+	g_byte_array_free(memory_valid, TRUE);
+
+	for (i = 0; i < G_N_ELEMENTS(memory_ascii); i++)
+		g_free(memory_ascii[i]);
+
 	g_free(addr_format);
 }
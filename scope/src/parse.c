@@ -132,12 +132,141 @@ static const ParseRoute parse_routes[] =
 	{ "^error,",                      on_debug_load_error,     '1',  '\n', 0 },
 	{ "^error,",                      on_tooltip_error,        '3',  '\0', 0 },
 	{ "^error",                       on_quiet_error,          '4',  '\0', 0 },
+	{ "^error,",                      on_memory_read_error,    '9',  '\n', 0 },
 	{ "^error,",                      on_watch_error,          '6',  '\t', 0 },
 	{ "^error,",                      on_debug_error,          '\0', '\n', 0 },
 	{ "^exit",                        on_debug_exit,           '\0', '\0', 0 },
 	{ NULL, NULL, '\0', '\0', 0 }
 };
 
+#define ROUTE_COUNT G_N_ELEMENTS(parse_routes)
+
+/* prefix trie of the routes, built at init */
+typedef struct _ParseTrie ParseTrie;
+
+struct _ParseTrie
+{
+	char c;
+	ParseTrie *child;
+	ParseTrie *next;
+	GArray *routes;  /* indexes of the routes with this prefix, in table order */
+};
+
+static ParseTrie parse_trie;
+
+static void parse_trie_insert(guint index)
+{
+	const char *s;
+	ParseTrie *node = &parse_trie;
+
+	for (s = parse_routes[index].prefix; *s; s++)
+	{
+		ParseTrie *child;
+
+		for (child = node->child; child && child->c != *s; child = child->next);
+
+		if (!child)
+		{
+			child = g_new0(ParseTrie, 1);
+			child->c = *s;
+			child->next = node->child;
+			node->child = child;
+		}
+
+		node = child;
+	}
+
+	if (!node->routes)
+		node->routes = g_array_new(FALSE, FALSE, sizeof(guint));
+	g_array_append_val(node->routes, index);
+}
+
+static void parse_trie_free(ParseTrie *node)
+{
+	while (node)
+	{
+		ParseTrie *next = node->next;
+
+		parse_trie_free(node->child);
+		if (node->routes)
+			g_array_free(node->routes, TRUE);
+		g_free(node);
+		node = next;
+	}
+}
+
+/* the first route in table order whose prefix and mark match, or the terminator */
+static const ParseRoute *parse_route_find(const char *message, const char *token)
+{
+	const ParseTrie *node = &parse_trie;
+	guint best = ROUTE_COUNT - 1;
+
+	for (;;)
+	{
+		guint i;
+
+		for (i = 0; node->routes && i < node->routes->len; i++)
+		{
+			guint index = g_array_index(node->routes, guint, i);
+			char mark = parse_routes[index].mark;
+
+			if (index >= best)
+				break;
+
+			if (!mark || (token && (mark == '*' || mark == *token)))
+			{
+				best = index;
+				break;
+			}
+		}
+
+		if (!*message)
+			break;
+
+		for (node = node->child; node && node->c != *message; node = node->next);
+
+		if (!node)
+			break;
+
+		message++;
+	}
+
+	return parse_routes + best;
+}
+
+typedef struct _ParseStatistics
+{
+	guint count;
+	gint64 time;  /* in the callback, microseconds */
+} ParseStatistics;
+
+static ParseStatistics parse_statistics[ROUTE_COUNT];
+
+void parse_statistics_show(void)
+{
+	guint i;
+
+	dc_output_nl(1, "route statistics (messages, callback ms):", -1);
+
+	for (i = 0; i < ROUTE_COUNT; i++)
+	{
+		const ParseRoute *route = parse_routes + i;
+		const ParseStatistics *stats = parse_statistics + i;
+
+		if (stats->count)
+		{
+			char *line = g_strdup_printf("%-30s %c %8u %10.3f",
+				route->prefix ? route->prefix : "(none)", route->mark ? route->mark : ' ',
+				stats->count, stats->time / 1000.0);
+
+			dc_output_nl(1, line, -1);
+			g_free(line);
+		}
+	}
+
+	memset(parse_statistics, 0, sizeof parse_statistics);
+}
+
 static char *parse_error(const char *text)
 {
 	dc_error("%s", text);
@@ -241,12 +370,11 @@ static char *parse_text(GArray *nodes, char *text, char end, char newline)
 
 void parse_message(char *message, const char *token)
 {
-	const ParseRoute *route;
+	const ParseRoute *route = parse_route_find(message, token);
+	ParseStatistics *stats = parse_statistics + (route - parse_routes);
 
-	for (route = parse_routes; route->prefix; route++)
-		if (g_str_has_prefix(message, route->prefix))
-			if (!route->mark || (token && (route->mark == '*' || route->mark == *token)))
-				break;
+	if (pref_parse_statistics)
+		stats->count++;
 
 	if (route->callback)
 	{
@@ -264,7 +392,14 @@ void parse_message(char *message, const char *token)
 				g_array_append_val(nodes, node);
 			}
 
-			route->callback(nodes);
+			if (pref_parse_statistics)
+			{
+				gint64 start = g_get_monotonic_time();
+				route->callback(nodes);
+				stats->time += g_get_monotonic_time() - start;
+			}
+			else
+				route->callback(nodes);
 		}
 
 		parse_foreach(nodes, (GFunc) parse_node_free, NULL);
@@ -625,6 +760,11 @@ void parse_save(GKeyFile *config)
 
 void parse_init(void)
 {
+	guint i;
+
+	for (i = 0; parse_routes[i].prefix; i++)
+		parse_trie_insert(i);
+
 	errors = g_string_sized_new(MAXLEN);
 	parse_modes = SCP_TREE_STORE(get_object("parse_mode_store"));
 	scp_tree_store_set_sort_column_id(parse_modes, MODE_NAME, GTK_SORT_ASCENDING);
@@ -632,5 +772,7 @@ void parse_init(void)
 
 void parse_finalize(void)
 {
+	parse_trie_free(parse_trie.child);
+	parse_trie.child = NULL;
 	g_string_free(errors, TRUE);
 }
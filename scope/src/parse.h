@@ -35,6 +35,7 @@ typedef struct _ParseNode
 void parse_foreach(GArray *nodes, GFunc func, gpointer gdata);
 char *parse_string(char *text, char newline);
 void parse_message(char *message, const char *token);
+void parse_statistics_show(void);
 gchar *parse_get_display_from_7bit(const char *text, gint hb_mode, gint mr_mode);
 
 const ParseNode *parse_find_node(GArray *nodes, const char *name);
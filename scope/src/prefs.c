@@ -32,6 +32,7 @@ gboolean pref_gdb_async_mode;
 gboolean pref_async_break_bugs;
 #endif
 gboolean pref_var_update_bug;
+gboolean pref_parse_statistics;
 
 gboolean pref_auto_view_source;
 gboolean pref_keep_exec_point;
@@ -241,6 +242,7 @@ void prefs_init(void)
 	stash_group_add_boolean(group, &pref_async_break_bugs, "async_break_bugs", TRUE);
 #endif
 	stash_group_add_boolean(group, &pref_var_update_bug, "var_update_bug", TRUE);
+	stash_group_add_boolean(group, &pref_parse_statistics, "parse_statistics", FALSE);
 	stash_group_add_boolean(group, &pref_auto_view_source, "auto_view_source", FALSE);
 	stash_group_add_boolean(group, &pref_keep_exec_point, "keep_exec_point", FALSE);
 	stash_group_add_integer(group, &pref_visual_beep_length, "visual_beep_length", 25);
@@ -25,6 +25,7 @@ extern gboolean pref_gdb_async_mode;
 extern gboolean pref_async_break_bugs;
 #endif
 extern gboolean pref_var_update_bug;
+extern gboolean pref_parse_statistics;
 
 extern gboolean pref_auto_view_source;
 extern gboolean pref_keep_exec_point;
@@ -36,7 +36,12 @@ enum
 static ScpTreeStore *store;
 static GtkTreeSelection *selection;
 
-static void stack_node_location(const ParseNode *node, const char *fid)
+/* the columns set for each frame, the arguments are filled later */
+static gint stack_columns[] = { STACK_ID, STACK_FILE, STACK_LINE, STACK_BASE_NAME,
+	STACK_FUNC, STACK_ADDR, STACK_ENTRY };
+#define STACK_N_VALUES G_N_ELEMENTS(stack_columns)
+
+static void stack_node_location(const ParseNode *node, GArray *values)
 {
 	iff (node->type == PT_ARRAY, "stack: contains value")
 	{
@@ -46,18 +51,20 @@ static void stack_node_location(const ParseNode *node, const char *fid)
 		iff (id, "no level")
 		{
 			ParseLocation loc;
-			GtkTreeIter iter;
+			GValue *value;
 
 			parse_location(nodes, &loc);
-			scp_tree_store_append_with_values(store, &iter, NULL, STACK_ID, id,
-				STACK_FILE, loc.file, STACK_LINE, loc.line, STACK_BASE_NAME,
-				loc.base_name, STACK_FUNC, loc.func, STACK_ARGS, NULL, STACK_ADDR,
-				loc.addr, STACK_ENTRY, !loc.func ||
-				parse_mode_get(loc.func, MODE_ENTRY), -1);
+			g_array_set_size(values, values->len + STACK_N_VALUES);
+			value = &g_array_index(values, GValue, values->len - STACK_N_VALUES);
+			g_value_set_string(g_value_init(value++, G_TYPE_STRING), id);
+			g_value_set_string(g_value_init(value++, G_TYPE_STRING), loc.file);
+			g_value_set_int(g_value_init(value++, G_TYPE_INT), loc.line);
+			g_value_set_string(g_value_init(value++, G_TYPE_STRING), loc.base_name);
+			g_value_set_string(g_value_init(value++, G_TYPE_STRING), loc.func);
+			g_value_set_string(g_value_init(value++, G_TYPE_STRING), loc.addr);
+			g_value_set_boolean(g_value_init(value, G_TYPE_BOOLEAN), !loc.func ||
+				parse_mode_get(loc.func, MODE_ENTRY));
 			parse_location_free(&loc);
-
-			if (!g_strcmp0(id, fid))
-				gtk_tree_selection_select_iter(selection, &iter);
 		}
 	}
 }
@@ -69,15 +76,25 @@ void on_stack_frames(GArray *nodes)
 	if (!g_strcmp0(parse_grab_token(nodes), thread_id))
 	{
 		char *fid = g_strdup(frame_id);
+		GArray *values = g_array_new(FALSE, TRUE, sizeof(GValue));
+		GtkTreeIter iter;
+		guint i;
 
 		stack_clear();
-		parse_foreach(parse_lead_array(nodes), (GFunc) stack_node_location, fid);
+		parse_foreach(parse_lead_array(nodes), (GFunc) stack_node_location, values);
+		/* deep stacks are inserted and sorted at once */
+		scp_tree_store_append_rowsv(store, NULL, values->len / STACK_N_VALUES, stack_columns,
+			(GValue *) values->data, STACK_N_VALUES);
+		for (i = 0; i < values->len; i++)
+			g_value_unset(&g_array_index(values, GValue, i));
+		g_array_free(values, TRUE);
+
+		if (fid && store_find(store, &iter, STACK_ID, fid))
+			gtk_tree_selection_select_iter(selection, &iter);
 		g_free(fid);
 
 		if (!frame_id)
 		{
-			GtkTreeIter iter;
-
 			if (store_find(store, &iter, STACK_ID, "0"))
 				utils_tree_set_cursor(selection, &iter, -1);
 		}
@@ -53,6 +53,7 @@ typedef struct _AElem AElem;
 struct _AElem
 {
 	AElem *parent;
+	guint index;  /* in parent->children */
 	GPtrArray *children;
 	ScpTreeData data[1];
 };
@@ -95,6 +96,12 @@ static void scp_ptr_array_insert_val(GPtrArray *array, guint index, gpointer dat
 	array->pdata[index] = data;
 }
 
+static void scp_reindex_array(GPtrArray *array, guint start, guint end)
+{
+	for (; start < end; start++)
+		((AElem *) array->pdata[start])->index = start;
+}
+
 static void scp_free_element(ScpTreeStore *store, AElem *elem);
 
 static void scp_free_array(ScpTreeStore *store, GPtrArray *array)
@@ -219,6 +226,7 @@ static void scp_move_element(ScpTreeStore *store, GPtrArray *array, GtkTreeIter
 		}
 
 		array->pdata[new_pos] = data;
+		scp_reindex_array(array, MIN(old_pos, new_pos), MAX(old_pos, new_pos) + 1);
 		iter->user_data2 = GINT_TO_POINTER(new_pos);
 
 		if (emit_reordered)
@@ -478,6 +486,7 @@ gboolean scp_tree_store_remove(ScpTreeStore *store, GtkTreeIter *iter)
 	path = scp_tree_store_get_path(store, iter);
 	scp_free_element(store, elem);
 	g_ptr_array_remove_index(array, index);
+	scp_reindex_array(array, index, array->len);
 	gtk_tree_model_row_deleted(SCP_TREE_MODEL(store), path);
 
 	if (index == array->len)
@@ -508,6 +517,7 @@ static void validate_elem(AElem *parent, AElem *elem)
 {
 	GPtrArray *array = elem->children;
 	g_assert(elem->parent == parent);
+	g_assert(!parent || parent->children->pdata[elem->index] == elem);
 
 	if (array)
 	{
@@ -557,6 +567,7 @@ static gboolean scp_insert_element(ScpTreeStore *store, GtkTreeIter *iter, AElem
 
 	elem->parent = parent;
 	scp_ptr_array_insert_val(array, position, elem);
+	scp_reindex_array(array, position, array->len);
 	iter->stamp = priv->stamp;
 	iter->user_data = array;
 	iter->user_data2 = GINT_TO_POINTER(position);
@@ -624,6 +635,88 @@ void scp_tree_store_insert_with_values(ScpTreeStore *store, GtkTreeIter *iter,
 	va_end(ap);
 }
 
+static void scp_sort_array(ScpTreeStore *store, GtkTreeIter *parent, GPtrArray *array);
+
+void scp_tree_store_insert_rowsv(ScpTreeStore *store, GtkTreeIter *parent_iter, gint position,
+	gint n_rows, gint *columns, GValue *values, gint n_values)
+{
+	ScpTreeStorePrivate *priv;
+	AElem *parent;
+	GPtrArray *array;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	guint len;
+	gint i;
+
+	g_return_if_fail(SCP_IS_TREE_STORE(store));
+	priv = store->priv;
+	g_return_if_fail(priv->sublevels == TRUE || parent_iter == NULL);
+	g_return_if_fail(VALID_ITER_OR_NULL(parent_iter, store));
+	g_return_if_fail(n_rows >= 0);
+
+	parent = parent_iter ? ITER_ELEM(parent_iter) : priv->root;
+	array = parent->children;
+	len = array ? array->len : 0;
+
+	if (position == -1)
+		position = len;
+	else
+		g_return_if_fail((guint) position <= len);
+
+	if (!n_rows)
+		return;
+
+	if (!array)
+	{
+		parent->children = array = g_ptr_array_sized_new(MAX((guint) n_rows, parent_iter ?
+			priv->sublevel_reserved : priv->toplevel_reserved));
+	}
+
+	g_ptr_array_set_size(array, len + n_rows);
+	memmove(array->pdata + position + n_rows, array->pdata + position,
+		(len - position) * sizeof(gpointer));
+
+	for (i = 0; i < n_rows; i++)
+	{
+		AElem *elem = g_slice_alloc0(ELEM_SIZE(priv->n_columns));
+		gboolean changed = FALSE, sort_changed = FALSE;
+
+		scp_set_vector(store, elem, &changed, &sort_changed, columns, values + i * n_values,
+			n_values);
+		elem->parent = parent;
+		array->pdata[position + i] = elem;
+	}
+
+	scp_reindex_array(array, position, array->len);
+	priv->columns_dirty = TRUE;
+
+	/* the rows are sorted once, after all of them are inserted */
+	iter.stamp = priv->stamp;
+	iter.user_data = array;
+	iter.user_data2 = GINT_TO_POINTER(position);
+	path = scp_tree_store_get_path(store, &iter);
+
+	for (i = 0; i < n_rows; i++)
+	{
+		iter.user_data2 = GINT_TO_POINTER(position + i);
+		gtk_tree_model_row_inserted(SCP_TREE_MODEL(store), path, &iter);
+		gtk_tree_path_next(path);
+	}
+
+	if (parent_iter && len == 0)
+	{
+		gtk_tree_path_up(path);
+		gtk_tree_model_row_has_child_toggled(SCP_TREE_MODEL(store), path, parent_iter);
+	}
+
+	gtk_tree_path_free(path);
+
+	if (priv->sort_func)
+		scp_sort_array(store, parent_iter, array);
+
+	validate_store(store);
+}
+
 void scp_tree_store_get_valist(ScpTreeStore *store, GtkTreeIter *iter, va_list ap)
 {
 	ScpTreeStorePrivate *priv = store->priv;
@@ -659,19 +752,11 @@ void scp_tree_store_get(ScpTreeStore *store, GtkTreeIter *iter, ...)
 	va_end(ap);
 }
 
-static gboolean scp_tree_contains(GPtrArray *array, AElem *elem)
+static gboolean scp_elem_is_ancestor(AElem *ancestor, AElem *elem)
 {
-	if (array)
-	{
-		guint i;
-
-		for (i = 0; i < array->len; i++)
-		{
-			AElem *elem1 = (AElem *) array->pdata[i];
-			if (elem1 == elem || scp_tree_contains(elem1->children, elem))
-				return TRUE;
-		}
-	}
+	while ((elem = elem->parent) != NULL)
+		if (elem == ancestor)
+			return TRUE;
 
 	return FALSE;
 }
@@ -683,7 +768,7 @@ gboolean scp_tree_store_is_ancestor(VALIDATE_ONLY ScpTreeStore *store, GtkTreeIt
 	g_return_val_if_fail(VALID_ITER(iter, store), FALSE);
 	g_return_val_if_fail(VALID_ITER(descendant, store), FALSE);
 
-	return scp_tree_contains(ITER_ELEM(iter)->children, ITER_ELEM(descendant));
+	return scp_elem_is_ancestor(ITER_ELEM(iter), ITER_ELEM(descendant));
 }
 
 gint scp_tree_store_iter_depth(VALIDATE_ONLY ScpTreeStore *store, GtkTreeIter *iter)
@@ -736,9 +821,25 @@ void scp_tree_store_clear_children(ScpTreeStore *store, GtkTreeIter *parent,
 
 gboolean scp_tree_store_iter_is_valid(ScpTreeStore *store, GtkTreeIter *iter)
 {
+	GPtrArray *array;
+	AElem *elem;
+
 	g_return_val_if_fail(SCP_IS_TREE_STORE(store), FALSE);
 	g_return_val_if_fail(VALID_ITER(iter, store), FALSE);
-	return scp_tree_contains(store->priv->root->children, ITER_ELEM(iter));
+
+	array = ITER_ARRAY(iter);
+	if ((guint) ITER_INDEX(iter) >= array->len)
+		return FALSE;
+
+	for (elem = ITER_ELEM(iter); elem->parent; elem = elem->parent)
+	{
+		array = elem->parent->children;
+
+		if (!array || elem->index >= array->len || array->pdata[elem->index] != elem)
+			return FALSE;
+	}
+
+	return elem == store->priv->root;
 }
 
 static void scp_reorder_array(ScpTreeStore *store, GtkTreeIter *parent, GPtrArray *array,
@@ -752,6 +853,7 @@ static void scp_reorder_array(ScpTreeStore *store, GtkTreeIter *parent, GPtrArra
 		pdata[i] = array->pdata[new_order[i]];
 
 	memcpy(array->pdata, pdata, array->len * sizeof(gpointer));
+	scp_reindex_array(array, 0, array->len);
 	g_free(pdata);
 	/* emit signal */
 	path = parent ? scp_tree_store_get_path(store, parent) : gtk_tree_path_new();
@@ -796,6 +898,8 @@ void scp_tree_store_swap(ScpTreeStore *store, GtkTreeIter *a, GtkTreeIter *b)
 
 		array->pdata[index_a] = array->pdata[index_b];
 		array->pdata[index_b] = swap;
+		((AElem *) array->pdata[index_a])->index = index_a;
+		swap->index = index_b;
 
 		for (i = 0; i < array->len; i++)
 			new_order[i] = i == index_a ? index_b : i == index_b ? index_a : i;
@@ -829,23 +933,13 @@ gint scp_tree_store_iter_tell(VALIDATE_ONLY ScpTreeStore *store, GtkTreeIter *it
 	g_return_val_if_fail(SCP_IS_TREE_STORE(store), -1);
 	g_return_val_if_fail(VALID_ITER(iter, store), -1);
 	g_return_val_if_fail((guint) ITER_INDEX(iter) < ITER_ARRAY(iter)->len, -1);
+	g_return_val_if_fail(ITER_ELEM(iter)->index == (guint) ITER_INDEX(iter), -1);
 
 	return ITER_INDEX(iter);
 }
 
 /* Model */
 
-static gint scp_ptr_array_find(GPtrArray *array, AElem *elem)
-{
-	guint i;
-
-	for (i = 0; i < array->len; i++)
-		if (array->pdata[i] == elem)
-			return i;
-
-	return -1;
-}
-
 GtkTreeModelFlags scp_tree_store_get_flags(ScpTreeStore *store)
 {
 	return store->priv->sublevels ? 0 : GTK_TREE_MODEL_LIST_ONLY;
@@ -912,19 +1006,7 @@ GtkTreePath *scp_tree_store_get_path(VALIDATE_ONLY ScpTreeStore *store, GtkTreeI
 		gtk_tree_path_append_index(path, ITER_INDEX(iter));
 
 		for (elem = elem->parent; elem->parent; elem = elem->parent)
-		{
-			gint index = scp_ptr_array_find(elem->parent->children, elem);
-
-			if (index == -1)
-			{
-				/* We couldn't find node, meaning it's prolly not ours */
-				/* Perhaps I should do a g_return_if_fail here. */
-				gtk_tree_path_free(path);
-				return NULL;
-			}
-
-			gtk_tree_path_prepend_index(path, index);
-		}
+			gtk_tree_path_prepend_index(path, elem->index);
 	}
 
 	return path;
@@ -1042,15 +1124,10 @@ gboolean scp_tree_store_iter_parent(ScpTreeStore *store, GtkTreeIter *iter,
 
 	if (parent->parent)
 	{
-		gint index = scp_ptr_array_find(parent->parent->children, parent);
-
-		if (index != -1)
-		{
-			iter->stamp = priv->stamp;
-			iter->user_data = parent->parent->children;
-			iter->user_data2 = GINT_TO_POINTER(index);
-			return TRUE;
-		}
+		iter->stamp = priv->stamp;
+		iter->user_data = parent->parent->children;
+		iter->user_data2 = GINT_TO_POINTER(parent->index);
+		return TRUE;
 	}
 
 	iter->stamp = 0;
@@ -1279,25 +1356,31 @@ static gint scp_index_compare(gint *a, gint *b, ScpSortData *sort_data)
 		priv->headers[priv->sort_column_id].data);
 }
 
+static void scp_sort_array(ScpTreeStore *store, GtkTreeIter *parent, GPtrArray *array)
+{
+	gint *new_order = g_new(gint, array->len);
+	ScpSortData sort_data = { store, array };
+	guint i;
+
+	for (i = 0; i < array->len; i++)
+		new_order[i] = i;
+
+	g_qsort_with_data(new_order, array->len, sizeof(gint),
+		(GCompareDataFunc) scp_index_compare, &sort_data);
+	scp_reorder_array(store, parent, array, new_order);
+	g_free(new_order);
+}
+
 static void scp_sort_children(ScpTreeStore *store, GtkTreeIter *parent)
 {
 	GPtrArray *array = (parent ? ITER_ELEM(parent) : store->priv->root)->children;
 
 	if (array && array->len)
 	{
-		gint *new_order = g_new(gint, array->len);
-		ScpSortData sort_data = { store, array };
 		GtkTreeIter iter;
 		guint i;
 
-		for (i = 0; i < array->len; i++)
-			new_order[i] = i;
-
-		g_qsort_with_data(new_order, array->len, sizeof(gint),
-			(GCompareDataFunc) scp_index_compare, &sort_data);
-		scp_reorder_array(store, parent, array, new_order);
-		g_free(new_order);
-
+		scp_sort_array(store, parent, array);
 		iter.stamp = store->priv->stamp;
 		iter.user_data = array;
 
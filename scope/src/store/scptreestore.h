@@ -86,6 +86,10 @@ void scp_tree_store_insert_with_values(ScpTreeStore *store, GtkTreeIter *iter,
 	scp_tree_store_insert_with_values(store, iter, parent, 0, __VA_ARGS__)
 #define scp_tree_store_append_with_values(store, iter, parent, ...) \
 	scp_tree_store_insert_with_values(store, iter, parent, -1, __VA_ARGS__)
+void scp_tree_store_insert_rowsv(ScpTreeStore *store, GtkTreeIter *parent, gint position,
+	gint n_rows, gint *columns, GValue *values, gint n_values);
+#define scp_tree_store_append_rowsv(store, parent, n_rows, columns, values, n_values) \
+	scp_tree_store_insert_rowsv(store, parent, -1, n_rows, columns, values, n_values)
 void scp_tree_store_get_valist(ScpTreeStore *store, GtkTreeIter *iter, va_list var_args);
 void scp_tree_store_get(ScpTreeStore *store, GtkTreeIter *iter, ...);
 gboolean scp_tree_store_is_ancestor(ScpTreeStore *store, GtkTreeIter *iter,
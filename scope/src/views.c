@@ -270,7 +270,8 @@ GtkTreeView *view_create(const char *name, ScpTreeStore **store, GtkTreeSelectio
 {
 	GtkTreeView *tree = GTK_TREE_VIEW(get_widget(name));
 
-	*store = SCP_TREE_STORE(gtk_tree_view_get_model(tree));
+	if (store)
+		*store = SCP_TREE_STORE(gtk_tree_view_get_model(tree));
 	*selection = gtk_tree_view_get_selection(tree);
 	return tree;
 }
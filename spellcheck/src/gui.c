@@ -47,26 +47,56 @@ typedef struct
 } SpellClickInfo;
 static SpellClickInfo clickinfo;
 
+/* state of a line when it was last checked while typing */
 typedef struct
 {
-	GeanyDocument *doc;
-	gint line_number;
-	gint line_count;
-	guint check_while_typing_idle_source_id;
+	guint hash; /* of the line's text and styles, 0 if not checked yet */
+	gboolean has_errors;
+	gboolean modified; /* whether the line changed since it was checked */
+} LineInfo;
+
+/* lines of a document checked while typing */
+typedef struct
+{
+	GArray *lines; /* LineInfo */
+	gint modified_start; /* range containing the modified lines, -1 if none */
+	gint modified_end;
+	gboolean check_all; /* whether to check all the lines which weren't checked yet */
+} LineInfos;
+
+/* Lines to check while typing: the visible lines first, then the modified ones and if
+ * the whole document is to be checked the lines around the visible ones, alternately
+ * below and above */
+typedef struct
+{
+	guint doc_id;
+	guint source_id;
+	gint visible_line; /* next visible line to check */
+	gint visible_end;
+	gint below;
+	gint above;
+	gboolean down;
 } CheckLineData;
 static CheckLineData check_line_data;
 
+#define LINE_INFOS_KEY "spellcheck-line-infos"
+/* time spent checking lines in one idle callback, in microseconds */
+#define CHECK_LINES_SLICE 10000
+
 /* Flag to indicate that a callback function will be triggered by generating the appropriate event
  * but the callback should be ignored. */
 static gboolean sc_ignore_callback = FALSE;
 
 
 static void perform_check(GeanyDocument *doc);
+static void check_on_reload(GeanyDocument *doc);
 
 
 static void clear_spellcheck_error_markers(GeanyDocument *doc)
 {
 	editor_indicator_clear(doc->editor, GEANY_INDICATOR_ERROR);
+	/* the lines have to be checked again to get their markers back */
+	g_object_set_data(G_OBJECT(doc->editor->sci), LINE_INFOS_KEY, NULL);
 }
 
 
@@ -287,6 +317,8 @@ void sc_gui_document_open_cb(GObject *obj, GeanyDocument *doc, gpointer user_dat
 {
 	if (sc_info->check_on_document_open && main_is_realized())
 		g_idle_add(perform_check_delayed_cb, doc);
+	else if (sc_info->check_while_typing)
+		check_on_reload(doc);
 }
 
 
@@ -488,97 +520,322 @@ static void indicator_clear_on_line(GeanyDocument *doc, gint line_number)
 }
 
 
-static gboolean check_lines(gpointer data)
+static void line_infos_free(LineInfos *line_infos)
+{
+	g_array_unref(line_infos->lines);
+	g_free(line_infos);
+}
+
+
+static LineInfos *get_line_infos(GeanyDocument *doc, gboolean create)
 {
-	GeanyDocument *doc = check_line_data.doc;
+	LineInfos *line_infos = g_object_get_data(G_OBJECT(doc->editor->sci), LINE_INFOS_KEY);
 
-	/* since we're in an timeout callback, the document may have been closed */
-	if (DOC_VALID (doc))
+	if (line_infos == NULL && create)
 	{
-		gint line_number = check_line_data.line_number;
-		gint line_count = check_line_data.line_count;
-		gint i;
+		line_infos = g_new0(LineInfos, 1);
+		line_infos->lines = g_array_new(FALSE, TRUE, sizeof(LineInfo));
+		g_array_set_size(line_infos->lines, sci_get_line_count(doc->editor->sci));
+		line_infos->modified_start = -1;
+		line_infos->modified_end = -1;
+		g_object_set_data_full(G_OBJECT(doc->editor->sci), LINE_INFOS_KEY, line_infos,
+			(GDestroyNotify) line_infos_free);
+	}
+	return line_infos;
+}
 
-		for (i = 0; i < line_count; i++)
-		{
-			indicator_clear_on_line(doc, line_number);
-			if (sc_speller_process_line(doc, line_number) != 0)
-			{
-				if (sc_info->use_msgwin)
-					msgwin_switch_tab(MSG_MESSAGE, FALSE);
-			}
-			line_number++;
-		}
+
+/* keep the line infos in line with the document when lines are added or removed */
+static void update_line_infos(LineInfos *line_infos, gint line, gint lines_added)
+{
+	GArray *lines = line_infos->lines;
+
+	if (lines_added == 0 || line > (gint) lines->len)
+		return;
+
+	if (lines_added > 0)
+	{
+		LineInfo *new_infos = g_new0(LineInfo, lines_added);
+
+		g_array_insert_vals(lines, line, new_infos, lines_added);
+		g_free(new_infos);
+	}
+	else
+		g_array_remove_range(lines, line, MIN(-lines_added, (gint) lines->len - line));
+
+	if (line_infos->modified_start < 0)
+		return;
+	if (line_infos->modified_end >= line)
+		line_infos->modified_end = MAX(line - 1, line_infos->modified_end + lines_added);
+	if (line_infos->modified_start >= line)
+		line_infos->modified_start = MAX(line, line_infos->modified_start + lines_added);
+	if (line_infos->modified_start > line_infos->modified_end)
+		line_infos->modified_start = line_infos->modified_end = -1;
+}
+
+
+static void mark_lines_modified(LineInfos *line_infos, gint first_line, gint last_line)
+{
+	gint i;
+
+	last_line = MIN(last_line, (gint) line_infos->lines->len - 1);
+	if (first_line > last_line)
+		return;
+
+	for (i = first_line; i <= last_line; i++)
+		g_array_index(line_infos->lines, LineInfo, i).modified = TRUE;
+
+	if (line_infos->modified_start < 0)
+	{
+		line_infos->modified_start = first_line;
+		line_infos->modified_end = last_line;
+	}
+	else
+	{
+		line_infos->modified_start = MIN(line_infos->modified_start, first_line);
+		line_infos->modified_end = MAX(line_infos->modified_end, last_line);
 	}
-	check_line_data.check_while_typing_idle_source_id = 0;
-	return FALSE;
 }
 
 
-static gboolean need_delay(void)
+static guint line_hash(ScintillaObject *sci, gint line_number)
 {
-	static gint64 time_prev = 0; /* time in microseconds */
-	gint64 time_now;
-	GTimeVal t;
-	const gint timeout = 500; /* delay in milliseconds */
-	gboolean ret = FALSE;
+	struct Sci_TextRange tr;
+	gint start = sci_get_position_from_line(sci, line_number);
+	gint end = sci_get_line_end_position(sci, line_number);
+	guint hash = 5381;
+	gchar *styled_text;
+	gint i;
+
+	/* the styles decide which words are checked, so they have to be valid */
+	scintilla_send_message(sci, SCI_COLOURISE, start, end);
+
+	styled_text = g_malloc(2 * (end - start) + 2);
+	tr.chrg.cpMin = start;
+	tr.chrg.cpMax = end;
+	tr.lpstrText = styled_text;
+	scintilla_send_message(sci, SCI_GETSTYLEDTEXT, 0, (sptr_t) &tr);
+	for (i = 0; i < 2 * (end - start); i++)
+		hash = (hash << 5) + hash + (guchar) styled_text[i];
+	g_free(styled_text);
+
+	/* 0 is reserved for unchecked lines */
+	return (hash != 0) ? hash : 1;
+}
 
-	g_get_current_time(&t);
 
-	time_now = ((gint64) t.tv_sec * G_USEC_PER_SEC) + t.tv_usec;
+static gboolean line_has_errors(ScintillaObject *sci, gint line_number)
+{
+	gint start = sci_get_position_from_line(sci, line_number);
+	gint end = sci_get_line_end_position(sci, line_number);
 
-	/* delay keypresses for 0.5 seconds */
-	if (time_now < (time_prev + (timeout * 1000)))
-		return TRUE;
+	return scintilla_send_message(sci, SCI_INDICATORVALUEAT, GEANY_INDICATOR_ERROR, start) != 0 ||
+		   scintilla_send_message(sci, SCI_INDICATOREND, GEANY_INDICATOR_ERROR, start) < end;
+}
 
-	if (check_line_data.check_while_typing_idle_source_id == 0)
+
+/* Only the visible lines and the modified ones are hashed to find out whether they
+ * changed, the others are checked only if they weren't yet */
+static gint next_line_to_check(LineInfos *line_infos, gint line_count)
+{
+	GArray *lines = line_infos->lines;
+
+	if (check_line_data.visible_line < MIN(check_line_data.visible_end, line_count))
+		return check_line_data.visible_line++;
+
+	while (line_infos->modified_start >= 0 && line_infos->modified_start <= line_infos->modified_end &&
+		   line_infos->modified_start < line_count)
 	{
-		check_line_data.check_while_typing_idle_source_id =
-			plugin_timeout_add(geany_plugin, timeout, check_lines, NULL);
-		ret = TRUE;
+		gint line = line_infos->modified_start++;
+
+		if (g_array_index(lines, LineInfo, line).modified)
+			return line;
 	}
+	line_infos->modified_start = line_infos->modified_end = -1;
 
-	/* set current time for the next key press */
-	time_prev = time_now;
+	while (line_infos->check_all)
+	{
+		gint line = -1;
 
-	return ret;
+		if (check_line_data.below < line_count && (check_line_data.down || check_line_data.above < 0))
+		{
+			check_line_data.down = FALSE;
+			line = check_line_data.below++;
+		}
+		else if (check_line_data.above >= 0)
+		{
+			check_line_data.down = TRUE;
+			line = check_line_data.above--;
+		}
+		else
+			line_infos->check_all = FALSE;
+
+		if (line >= 0 && g_array_index(lines, LineInfo, line).hash == 0)
+			return line;
+	}
+	return -1;
 }
 
 
-static void check_on_text_changed(GeanyDocument *doc, gint position, gint lines_added)
+static gboolean check_lines(gpointer data)
 {
-	gint line_number;
+	/* since we're in an idle callback, the document may have been closed */
+	GeanyDocument *doc = document_find_by_id(check_line_data.doc_id);
+	gint64 start_time = g_get_monotonic_time();
+	ScintillaObject *sci;
+	LineInfos *line_infos;
 	gint line_count;
 
-	/* Iterating over all lines which changed as indicated by lines_added. lines_added is 0
-	 * if only one line has changed, in this case set line_count to 1. Otherwise, iterating over all
-	 * new lines makes spell checking work for pasted text. */
-	line_count = MAX(1, lines_added);
+	if (doc == NULL || ! sc_info->check_while_typing)
+	{
+		check_line_data.source_id = 0;
+		return FALSE;
+	}
+
+	sci = doc->editor->sci;
+	line_count = sci_get_line_count(sci);
+	line_infos = get_line_infos(doc, TRUE);
+	g_array_set_size(line_infos->lines, line_count);
+
+	while (g_get_monotonic_time() - start_time < CHECK_LINES_SLICE)
+	{
+		gint line_number = next_line_to_check(line_infos, line_count);
+		LineInfo *info;
+		guint hash;
+
+		if (line_number < 0)
+		{	/* all lines are up to date */
+			check_line_data.source_id = 0;
+			return FALSE;
+		}
 
-	line_number = sci_get_line_from_position(doc->editor->sci, position);
-	/* TODO: storing these information in the global check_line_data struct isn't that good.
-	 * The data gets overwritten when a new line is inserted and so there is a chance that the
-	 * previous line is not checked to the end. One solution could be to simple maintain a list
-	 * of line numbers which needs to be checked and do this in the timeout handler. */
-	check_line_data.doc = doc;
-	check_line_data.line_number = line_number;
-	check_line_data.line_count = line_count;
+		hash = line_hash(sci, line_number);
+		/* hashing restyles the line, which may have marked it as modified again */
+		info = &g_array_index(line_infos->lines, LineInfo, line_number);
+		info->modified = FALSE;
+		/* unchanged lines keep their markers */
+		if (hash == info->hash)
+			continue;
 
-	/* check only once in a while */
-	if (! need_delay())
-		check_lines(NULL);
+		indicator_clear_on_line(doc, line_number);
+		if (sc_speller_process_line(doc, line_number) != 0)
+		{
+			if (sc_info->use_msgwin)
+				msgwin_switch_tab(MSG_MESSAGE, FALSE);
+		}
+		info = &g_array_index(line_infos->lines, LineInfo, line_number);
+		info->hash = hash;
+		info->has_errors = line_has_errors(sci, line_number);
+	}
+	return TRUE;
+}
+
+
+static gboolean check_lines_delayed(gpointer data)
+{
+	check_line_data.source_id = plugin_idle_add(geany_plugin, check_lines, NULL);
+	return FALSE;
+}
+
+
+/* (Re)start checking the lines of doc from the visible ones */
+static void schedule_check_lines(GeanyDocument *doc, guint delay)
+{
+	ScintillaObject *sci = doc->editor->sci;
+	gint first_line, lines_on_screen;
+
+	first_line = scintilla_send_message(sci, SCI_DOCLINEFROMVISIBLE,
+		scintilla_send_message(sci, SCI_GETFIRSTVISIBLELINE, 0, 0), 0);
+	lines_on_screen = scintilla_send_message(sci, SCI_LINESONSCREEN, 0, 0);
+
+	check_line_data.doc_id = doc->id;
+	check_line_data.visible_line = first_line;
+	/* one more for a partially visible line at the bottom */
+	check_line_data.visible_end = first_line + lines_on_screen + 1;
+	check_line_data.below = check_line_data.visible_end;
+	check_line_data.above = first_line - 1;
+	check_line_data.down = TRUE;
+
+	if (check_line_data.source_id == 0)
+	{
+		if (delay > 0)
+			check_line_data.source_id = plugin_timeout_add(geany_plugin, delay,
+				check_lines_delayed, NULL);
+		else
+			check_line_data.source_id = plugin_idle_add(geany_plugin, check_lines, NULL);
+	}
+}
+
+
+/* text was inserted or deleted, or restyled, between position and position + length */
+static void check_on_text_changed(GeanyDocument *doc, gint position, gint length,
+								  gint lines_added, gboolean restyled)
+{
+	const guint timeout = 500; /* delay in milliseconds */
+	ScintillaObject *sci = doc->editor->sci;
+	LineInfos *line_infos = get_line_infos(doc, FALSE);
+	gint first_line = sci_get_line_from_position(sci, position);
+	gint last_line;
+
+	/* new line infos already match the modified document */
+	if (line_infos != NULL)
+		update_line_infos(line_infos, first_line + 1, lines_added);
+	else
+		line_infos = get_line_infos(doc, TRUE);
+
+	if (restyled)
+		last_line = sci_get_line_from_position(sci, position + length);
+	else
+		last_line = first_line + MAX(lines_added, 0);
+	mark_lines_modified(line_infos, first_line, last_line);
+
+	/* check only once in a while, and let checks in progress go on when they restyle
+	 * lines */
+	if (! restyled || check_line_data.source_id == 0 || check_line_data.doc_id != doc->id)
+		schedule_check_lines(doc, timeout);
+}
+
+
+static void check_on_reload(GeanyDocument *doc)
+{
+	LineInfos *line_infos = get_line_infos(doc, TRUE);
+	guint i;
+
+	/* reloading removes the markers, so check the lines which had some again */
+	for (i = 0; i < line_infos->lines->len; i++)
+	{
+		LineInfo *info = &g_array_index(line_infos->lines, LineInfo, i);
+
+		if (info->has_errors)
+			info->hash = 0;
+	}
+	line_infos->check_all = TRUE;
+	schedule_check_lines(doc, 0);
 }
 
 
 gboolean sc_gui_editor_notify(GObject *object, GeanyEditor *editor,
 							  SCNotification *nt, gpointer data)
 {
+	if (nt->nmhdr.code == SCN_MODIFIED && (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)))
+		sc_speller_document_modified(editor->document, nt->position, nt->length,
+			(nt->modificationType & SC_MOD_INSERTTEXT) != 0);
+
 	if (! sc_info->check_while_typing)
 		return FALSE;
 
-	if (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
+	if (nt->nmhdr.code == SCN_UPDATEUI)
+	{
+		/* check the newly visible lines first */
+		if ((nt->updated & SC_UPDATE_V_SCROLL) && editor->document == document_get_current())
+			schedule_check_lines(editor->document, 0);
+	}
+	else if (nt->nmhdr.code == SCN_MODIFIED &&
+			 (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT | SC_MOD_CHANGESTYLE)))
 	{
-		check_on_text_changed(editor->document, nt->position, nt->linesAdded);
+		/* the styles decide which words are checked, so restyled lines are checked again */
+		check_on_text_changed(editor->document, nt->position, nt->length, nt->linesAdded,
+			(nt->modificationType & SC_MOD_CHANGESTYLE) != 0);
 	}
 
 	return FALSE;
@@ -749,9 +1006,13 @@ void sc_gui_init(void)
 
 void sc_gui_free(void)
 {
+	guint i;
+
 	g_free(clickinfo.word);
-	if (check_line_data.check_while_typing_idle_source_id != 0)
-		g_source_remove(check_line_data.check_while_typing_idle_source_id);
+	if (check_line_data.source_id != 0)
+		g_source_remove(check_line_data.source_id);
+	foreach_document(i)
+		g_object_set_data(G_OBJECT(documents[i]->editor->sci), LINE_INFOS_KEY, NULL);
 	if (sc_info->toolbar_button != NULL)
 		gtk_widget_destroy(GTK_WIDGET(sc_info->toolbar_button));
 	free_editor_menu_items();
@@ -38,9 +38,118 @@
 
 
 
+/* flush found misspellings to the main thread after this many or this time (in microseconds) */
+#define CHECK_BATCH_SIZE 200
+#define CHECK_BATCH_INTERVAL 100000
+/* the word cache is emptied when it grows larger than this */
+#define WORD_CACHE_MAX_SIZE 100000
+
+#define WORD_CORRECT GINT_TO_POINTER(1)
+#define WORD_MISSPELLED GINT_TO_POINTER(2)
+
+
+typedef struct
+{
+	gint start;
+	gboolean is_text;
+} StyleRun;
+
+typedef struct
+{
+	gint start;
+	gint end;
+	gint line_number;
+	gchar *message; /* message window text or NULL */
+} Misspelling;
+
+typedef struct
+{
+	gint position;
+	gint length; /* negative for deletions */
+} TextEdit;
+
+/* A document check running on a worker thread. The thread only works on a snapshot of the
+ * text and of its style runs, the found misspellings are sent back in batches. */
+typedef struct
+{
+	guint serial;
+	guint doc_id;
+	gchar *text;
+	gint text_len;
+	gint start_pos;
+	gint first_line;
+	GArray *style_runs;
+	gboolean wordchars[256];
+	gboolean use_msgwin;
+	gint cancelled;
+	GThread *thread;
+	/* main thread only */
+	GArray *edits; /* edits done to the document since the snapshot */
+	gint misspellings_found;
+} CheckJob;
+
+typedef struct
+{
+	guint serial;
+	GArray *misspellings;
+	gboolean done;
+} CheckBatch;
+
+
 static EnchantBroker *sc_speller_broker = NULL;
 static EnchantDict *sc_speller_dict = NULL;
+/* protects sc_speller_dict which is also used by the check thread */
+static GMutex sc_speller_dict_lock;
+/* verdicts for the words already checked with sc_speller_dict, also protected by the lock */
+static GHashTable *sc_speller_word_cache = NULL;
+static guint sc_speller_cache_hits = 0;
+static guint sc_speller_cache_misses = 0;
+static CheckJob *sc_check_job = NULL;
+static guint sc_check_job_serial = 0;
+
 
+static gboolean is_text_style(gint lexer, gint style);
+
+
+
+/* Same as enchant_dict_check() but remembers the verdicts,
+ * must be called with sc_speller_dict_lock held */
+static gint dict_check_cached(const gchar *word)
+{
+	gpointer verdict = g_hash_table_lookup(sc_speller_word_cache, word);
+	gint result;
+
+	if (verdict != NULL)
+	{
+		sc_speller_cache_hits++;
+		return (verdict == WORD_CORRECT) ? 0 : 1;
+	}
+
+	sc_speller_cache_misses++;
+	result = enchant_dict_check(sc_speller_dict, word, -1);
+	/* don't remember errors */
+	if (result >= 0)
+	{
+		if (g_hash_table_size(sc_speller_word_cache) >= WORD_CACHE_MAX_SIZE)
+			g_hash_table_remove_all(sc_speller_word_cache);
+		g_hash_table_insert(sc_speller_word_cache, g_strdup(word),
+			(result == 0) ? WORD_CORRECT : WORD_MISSPELLED);
+	}
+	return result;
+}
+
+
+static void word_cache_clear(gboolean reset_stats)
+{
+	g_mutex_lock(&sc_speller_dict_lock);
+	g_hash_table_remove_all(sc_speller_word_cache);
+	if (reset_stats)
+	{
+		sc_speller_cache_hits = 0;
+		sc_speller_cache_misses = 0;
+	}
+	g_mutex_unlock(&sc_speller_dict_lock);
+}
 
 
 static void dict_describe(const gchar* const lang, const gchar* const name,
@@ -156,7 +265,7 @@ static gint sc_speller_check_word(GeanyDocument *doc, gint line_number, const gc
 	end_pos = start_pos + strlen(word_to_check);
 
 	/* early out if the word is spelled correctly */
-	if (enchant_dict_check(sc_speller_dict, word_to_check, -1) == 0)
+	if (sc_speller_dict_check(word_to_check) == 0)
 	{
 		g_free(word_to_check);
 		return 0;
@@ -171,7 +280,7 @@ static gint sc_speller_check_word(GeanyDocument *doc, gint line_number, const gc
 		GString *str;
 
 		str = g_string_sized_new(256);
-		suggs = enchant_dict_suggest(sc_speller_dict, word_to_check, -1, &n_suggs);
+		suggs = sc_speller_dict_suggest(word_to_check, &n_suggs);
 		if (suggs != NULL)
 		{
 			g_string_append_printf(str, "line %d: %s | ",  line_number + 1, word_to_check);
@@ -188,7 +297,7 @@ static gint sc_speller_check_word(GeanyDocument *doc, gint line_number, const gc
 			msgwin_msg_add(COLOR_RED, line_number + 1, doc, "%s", str->str);
 
 			if (suggs != NULL && n_suggs > 0)
-				enchant_dict_free_string_list(sc_speller_dict, suggs);
+				sc_speller_dict_free_string_list(suggs);
 		}
 		g_string_free(str, TRUE);
 	}
@@ -273,16 +382,371 @@ gint sc_speller_process_line(GeanyDocument *doc, gint line_number)
 }
 
 
-void sc_speller_check_document(GeanyDocument *doc)
+static void misspelling_clear(gpointer data)
+{
+	Misspelling *misspelling = data;
+
+	g_free(misspelling->message);
+}
+
+
+static CheckBatch *check_batch_new(guint serial)
+{
+	CheckBatch *batch = g_new0(CheckBatch, 1);
+
+	batch->serial = serial;
+	batch->misspellings = g_array_sized_new(FALSE, FALSE, sizeof(Misspelling), CHECK_BATCH_SIZE);
+	g_array_set_clear_func(batch->misspellings, misspelling_clear);
+
+	return batch;
+}
+
+
+static void check_batch_free(CheckBatch *batch)
+{
+	g_array_free(batch->misspellings, TRUE);
+	g_free(batch);
+}
+
+
+static void check_job_free(CheckJob *job)
+{
+	g_free(job->text);
+	g_array_free(job->style_runs, TRUE);
+	g_array_free(job->edits, TRUE);
+	g_free(job);
+}
+
+
+/* Stop the running document check, if any. Batches already queued are dropped
+ * when they arrive because their serial doesn't match any more. */
+static void cancel_check(void)
+{
+	if (sc_check_job != NULL)
+	{
+		g_atomic_int_set(&sc_check_job->cancelled, TRUE);
+		g_thread_join(sc_check_job->thread);
+		check_job_free(sc_check_job);
+		sc_check_job = NULL;
+		ui_progress_bar_stop();
+	}
+}
+
+
+/* Move a range found in the snapshot to where it is now, returns FALSE if
+ * the range has been edited in the meantime */
+static gboolean map_range_through_edits(GArray *edits, gint *start, gint *end)
+{
+	guint i;
+
+	for (i = 0; i < edits->len; i++)
+	{
+		TextEdit *edit = &g_array_index(edits, TextEdit, i);
+		/* the end of the changed range in the text before the edit */
+		gint edit_end = edit->length < 0 ? edit->position - edit->length : edit->position;
+
+		if (edit_end <= *start)
+		{
+			*start += edit->length;
+			*end += edit->length;
+		}
+		else if (edit->position < *end)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+
+static gboolean apply_check_batch(gpointer data)
+{
+	CheckBatch *batch = data;
+	CheckJob *job = sc_check_job;
+	GeanyDocument *doc;
+	ScintillaObject *sci;
+	guint i;
+
+	if (job == NULL || job->serial != batch->serial)
+	{	/* the check has been cancelled or restarted */
+		check_batch_free(batch);
+		return FALSE;
+	}
+
+	doc = document_find_by_id(job->doc_id);
+	if (doc == NULL)
+	{	/* document has been closed while checking */
+		cancel_check();
+		check_batch_free(batch);
+		return FALSE;
+	}
+
+	sci = doc->editor->sci;
+	sci_indicator_set(sci, GEANY_INDICATOR_ERROR);
+	for (i = 0; i < batch->misspellings->len; i++)
+	{
+		Misspelling *misspelling = &g_array_index(batch->misspellings, Misspelling, i);
+		gint start = misspelling->start;
+		gint end = misspelling->end;
+
+		if (map_range_through_edits(job->edits, &start, &end))
+			scintilla_send_message(sci, SCI_INDICATORFILLRANGE, start, end - start);
+
+		if (misspelling->message != NULL)
+			msgwin_msg_add(COLOR_RED, misspelling->line_number + 1, doc, "%s", misspelling->message);
+	}
+	job->misspellings_found += batch->misspellings->len;
+
+	if (batch->done)
+	{
+		if (job->misspellings_found == 0 && job->use_msgwin)
+			msgwin_msg_add(COLOR_BLUE, -1, NULL, _("The checked text is spelled correctly."));
+
+		g_mutex_lock(&sc_speller_dict_lock);
+		g_debug("Word cache: %u hits, %u misses", sc_speller_cache_hits, sc_speller_cache_misses);
+		g_mutex_unlock(&sc_speller_dict_lock);
+		cancel_check();
+	}
+
+	check_batch_free(batch);
+	return FALSE;
+}
+
+
+static void add_misspelling(CheckJob *job, CheckBatch *batch, const gchar *word,
+							gint start_pos, gint line_number)
+{
+	Misspelling misspelling;
+
+	misspelling.start = start_pos;
+	misspelling.end = start_pos + strlen(word);
+	misspelling.line_number = line_number;
+	misspelling.message = NULL;
+
+	if (job->use_msgwin)
+	{
+		gsize j, n_suggs = 0;
+		gchar **suggs;
+
+		g_mutex_lock(&sc_speller_dict_lock);
+		suggs = enchant_dict_suggest(sc_speller_dict, word, -1, &n_suggs);
+		if (suggs != NULL)
+		{
+			GString *str = g_string_sized_new(256);
+
+			g_string_append_printf(str, "line %d: %s | ",  line_number + 1, word);
+			g_string_append(str, _("Try: "));
+			/* limit suggestions to a maximum of 15 (for now) */
+			for (j = 0; j < MIN(n_suggs, 15); j++)
+			{
+				g_string_append(str, suggs[j]);
+				g_string_append_c(str, ' ');
+			}
+			misspelling.message = g_string_free(str, FALSE);
+			enchant_dict_free_string_list(sc_speller_dict, suggs);
+		}
+		g_mutex_unlock(&sc_speller_dict_lock);
+	}
+
+	g_array_append_val(batch->misspellings, misspelling);
+}
+
+
+/* Returns the byte length of the word character at pos, or 0 if it is none. Geany's word
+ * chars are ASCII only, other letters count like in Scintilla's UTF-8 word navigation. */
+static gint word_char_length(const gboolean *wordchars, const gchar *text, gint text_len, gint pos)
 {
+	guchar c = text[pos];
+	gunichar ch;
+
+	if (c < 0x80)
+		return wordchars[c] ? 1 : 0;
+
+	ch = g_utf8_get_char_validated(text + pos, text_len - pos);
+	if (ch == (gunichar) -1 || ch == (gunichar) -2)
+		return 0;
+	if (g_unichar_isalnum(ch) || g_unichar_ismark(ch))
+		return g_utf8_skip[c];
+	return 0;
+}
+
+
+/* Returns the start of the next word at or after *pos and sets *pos to its end, or returns -1.
+ * Line ends passed on the way are counted in *line_number. */
+static gint find_next_word(const gboolean *wordchars, const gchar *text, gint text_len,
+						   gint *pos, gint *line_number)
+{
+	gint word_start;
+	gint len;
+
+	while (*pos < text_len && word_char_length(wordchars, text, text_len, *pos) == 0)
+	{
+		if (text[*pos] == '\n' || (text[*pos] == '\r' && text[*pos + 1] != '\n'))
+			(*line_number)++;
+		(*pos)++;
+	}
+	if (*pos >= text_len)
+		return -1;
+
+	word_start = *pos;
+	while (*pos < text_len && (len = word_char_length(wordchars, text, text_len, *pos)) > 0)
+		*pos += len;
+
+	return word_start;
+}
+
+
+static gpointer check_document_thread(gpointer data)
+{
+	CheckJob *job = data;
+	CheckBatch *batch = check_batch_new(job->serial);
+	gint64 last_flush = g_get_monotonic_time();
+	gint line_number = job->first_line;
+	guint run = 0;
+	gint pos = 0;
+
+	while (pos < job->text_len && ! g_atomic_int_get(&job->cancelled))
+	{
+		const gchar *text = job->text;
+		gint word_start;
+		gboolean is_text;
+
+		word_start = find_next_word(job->wordchars, text, job->text_len, &pos, &line_number);
+		if (word_start < 0)
+			break;
+
+		/* style runs are sorted, so just follow the words */
+		while (run + 1 < job->style_runs->len &&
+			   g_array_index(job->style_runs, StyleRun, run + 1).start <= word_start)
+			run++;
+		is_text = job->style_runs->len == 0 ||
+				  g_array_index(job->style_runs, StyleRun, run).is_text;
+
+		/* ignore non-text and numbers or words starting with digits */
+		if (is_text && ! g_ascii_isdigit(text[word_start]))
+		{
+			gchar *word = g_strndup(text + word_start, pos - word_start);
+			gint offset;
+			gchar *word_to_check = strip_word(word, &offset);
+
+			if (! EMPTY(word_to_check))
+			{
+				gboolean correct;
+
+				g_mutex_lock(&sc_speller_dict_lock);
+				correct = dict_check_cached(word_to_check) == 0;
+				g_mutex_unlock(&sc_speller_dict_lock);
+
+				if (! correct)
+					add_misspelling(job, batch, word_to_check,
+						job->start_pos + word_start + offset, line_number);
+			}
+			g_free(word_to_check);
+			g_free(word);
+		}
+
+		if (batch->misspellings->len >= CHECK_BATCH_SIZE ||
+			(batch->misspellings->len > 0 &&
+			 g_get_monotonic_time() - last_flush >= CHECK_BATCH_INTERVAL))
+		{
+			g_idle_add(apply_check_batch, batch);
+			batch = check_batch_new(job->serial);
+			last_flush = g_get_monotonic_time();
+		}
+	}
+
+	batch->done = TRUE;
+	g_idle_add(apply_check_batch, batch);
+
+	return NULL;
+}
+
+
+/* Collect the text and whether its styles are checked while on the main thread */
+static CheckJob *check_job_new(GeanyDocument *doc, gint first_line, gint start_pos, gint end_pos)
+{
+	ScintillaObject *sci = doc->editor->sci;
+	CheckJob *job = g_new0(CheckJob, 1);
+	gboolean text_styles[256];
+	struct Sci_TextRange tr;
+	gchar *styled_text;
+	gint wordchars_len;
+	gchar *wordchars;
+	gint lexer;
 	gint i;
+
+	job->serial = ++sc_check_job_serial;
+	job->doc_id = doc->id;
+	job->first_line = first_line;
+	job->start_pos = start_pos;
+	job->text_len = end_pos - start_pos;
+	job->use_msgwin = sc_info->use_msgwin;
+	job->style_runs = g_array_new(FALSE, FALSE, sizeof(StyleRun));
+	job->edits = g_array_new(FALSE, FALSE, sizeof(TextEdit));
+
+	/* make sure the styles are up to date for the whole range */
+	scintilla_send_message(sci, SCI_COLOURISE, start_pos, end_pos);
+
+	lexer = scintilla_send_message(sci, SCI_GETLEXER, 0, 0);
+	for (i = 0; i < 256; i++)
+		text_styles[i] = is_text_style(lexer, i);
+
+	/* each character is followed by its style */
+	styled_text = g_malloc(2 * job->text_len + 2);
+	tr.chrg.cpMin = start_pos;
+	tr.chrg.cpMax = end_pos;
+	tr.lpstrText = styled_text;
+	scintilla_send_message(sci, SCI_GETSTYLEDTEXT, 0, (sptr_t) &tr);
+
+	job->text = g_malloc(job->text_len + 1);
+	for (i = 0; i < job->text_len; i++)
+	{
+		gboolean is_text = text_styles[(guchar) styled_text[2 * i + 1]];
+
+		job->text[i] = styled_text[2 * i];
+		if (job->style_runs->len == 0 ||
+			g_array_index(job->style_runs, StyleRun, job->style_runs->len - 1).is_text != is_text)
+		{
+			StyleRun style_run = { i, is_text };
+			g_array_append_val(job->style_runs, style_run);
+		}
+	}
+	job->text[job->text_len] = '\0';
+	g_free(styled_text);
+
+	/* same word characters as in sc_speller_process_line(): with "'" and without "_" */
+	wordchars_len = scintilla_send_message(sci, SCI_GETWORDCHARS, 0, 0);
+	wordchars = g_malloc0(wordchars_len + 1);
+	scintilla_send_message(sci, SCI_GETWORDCHARS, 0, (sptr_t) wordchars);
+	for (i = 0; i < wordchars_len; i++)
+		job->wordchars[(guchar) wordchars[i]] = TRUE;
+	job->wordchars['\''] = TRUE;
+	job->wordchars['_'] = FALSE;
+	g_free(wordchars);
+
+	return job;
+}
+
+
+void sc_speller_document_modified(GeanyDocument *doc, gint position, gint length, gboolean inserted)
+{
+	if (sc_check_job != NULL && sc_check_job->doc_id == doc->id)
+	{
+		TextEdit edit = { position, inserted ? length : -length };
+		g_array_append_val(sc_check_job->edits, edit);
+	}
+}
+
+
+void sc_speller_check_document(GeanyDocument *doc)
+{
 	gint first_line, last_line;
+	gint start_pos, end_pos;
 	gchar *dict_string = NULL;
-	gint suggestions_found = 0;
 
 	g_return_if_fail(sc_speller_dict != NULL);
 	g_return_if_fail(doc != NULL);
 
+	cancel_check();
+
 	ui_progress_bar_start(_("Checking"));
 
 	enchant_dict_describe(sc_speller_dict, dict_describe, &dict_string);
@@ -312,29 +776,19 @@ void sc_speller_check_document(GeanyDocument *doc)
 	}
 	g_free(dict_string);
 
+	/* the last line of a selection is only checked if it's the only one */
 	if (first_line == last_line)
-	{
-		suggestions_found += sc_speller_process_line(doc, first_line);
-	}
+		last_line++;
+	start_pos = sci_get_position_from_line(doc->editor->sci, first_line);
+	if (last_line >= sci_get_line_count(doc->editor->sci))
+		end_pos = sci_get_length(doc->editor->sci);
 	else
-	{
-		for (i = first_line; i < last_line; i++)
-		{
-			if (! DOC_VALID(doc))
-			{	/* current document has been closed (might happen while checking large files) */
-				ui_progress_bar_stop();
-				return;
-			}
-			suggestions_found += sc_speller_process_line(doc, i);
+		end_pos = sci_get_position_from_line(doc->editor->sci, last_line);
 
-			/* process other GTK events to keep the GUI being responsive */
-			while (g_main_context_iteration(NULL, FALSE));
-		}
-	}
-	if (suggestions_found == 0 && sc_info->use_msgwin)
-		msgwin_msg_add(COLOR_BLUE, -1, NULL, _("The checked text is spelled correctly."));
-
-	ui_progress_bar_stop();
+	/* tokenizing and checking the words is done on a worker thread, the found misspellings
+	 * are marked in batches from apply_check_batch() */
+	sc_check_job = check_job_new(doc, first_line, start_pos, end_pos);
+	sc_check_job->thread = g_thread_new("spellcheck", check_document_thread, sc_check_job);
 }
 
 
@@ -461,7 +915,9 @@ void sc_speller_dict_free_string_list(gchar **tmp_suggs)
 {
 	g_return_if_fail(sc_speller_dict != NULL);
 
+	g_mutex_lock(&sc_speller_dict_lock);
 	enchant_dict_free_string_list(sc_speller_dict, tmp_suggs);
+	g_mutex_unlock(&sc_speller_dict_lock);
 }
 
 
@@ -470,29 +926,45 @@ void sc_speller_add_word(const gchar *word)
 	g_return_if_fail(sc_speller_dict != NULL);
 	g_return_if_fail(word != NULL);
 
+	g_mutex_lock(&sc_speller_dict_lock);
 #ifdef HAVE_ENCHANT_1_5
 	/* enchant_dict_add() is available since Enchant 1.4 */
 	enchant_dict_add(sc_speller_dict, word, -1);
 #else
 	enchant_dict_add_to_pwl(sc_speller_dict, word, -1);
 #endif
+	g_mutex_unlock(&sc_speller_dict_lock);
+
+	word_cache_clear(FALSE);
 }
 
 gboolean sc_speller_dict_check(const gchar *word)
 {
+	gint result;
+
 	g_return_val_if_fail(sc_speller_dict != NULL, FALSE);
 	g_return_val_if_fail(word != NULL, FALSE);
 
-	return enchant_dict_check(sc_speller_dict, word, -1);
+	g_mutex_lock(&sc_speller_dict_lock);
+	result = dict_check_cached(word);
+	g_mutex_unlock(&sc_speller_dict_lock);
+
+	return result;
 }
 
 
 gchar **sc_speller_dict_suggest(const gchar *word, gsize *n_suggs)
 {
+	gchar **suggs;
+
 	g_return_val_if_fail(sc_speller_dict != NULL, NULL);
 	g_return_val_if_fail(word != NULL, NULL);
 
-	return enchant_dict_suggest(sc_speller_dict, word, -1, n_suggs);
+	g_mutex_lock(&sc_speller_dict_lock);
+	suggs = enchant_dict_suggest(sc_speller_dict, word, -1, n_suggs);
+	g_mutex_unlock(&sc_speller_dict_lock);
+
+	return suggs;
 }
 
 
@@ -501,7 +973,11 @@ void sc_speller_add_word_to_session(const gchar *word)
 	g_return_if_fail(sc_speller_dict != NULL);
 	g_return_if_fail(word != NULL);
 
+	g_mutex_lock(&sc_speller_dict_lock);
 	enchant_dict_add_to_session(sc_speller_dict, word, -1);
+	g_mutex_unlock(&sc_speller_dict_lock);
+
+	word_cache_clear(FALSE);
 }
 
 
@@ -511,7 +987,9 @@ void sc_speller_store_replacement(const gchar *old_word, const gchar *new_word)
 	g_return_if_fail(old_word != NULL);
 	g_return_if_fail(new_word != NULL);
 
+	g_mutex_lock(&sc_speller_dict_lock);
 	enchant_dict_store_replacement(sc_speller_dict, old_word, -1, new_word, -1);
+	g_mutex_unlock(&sc_speller_dict_lock);
 }
 
 
@@ -519,6 +997,9 @@ void sc_speller_reinit_enchant_dict(void)
 {
 	const gchar *lang = sc_info->default_language;
 
+	/* the check thread uses the dict object */
+	cancel_check();
+
 	/* Release a previous dict object */
 	if (sc_speller_dict != NULL)
 		enchant_broker_free_dict(sc_speller_broker, sc_speller_dict);
@@ -573,6 +1054,9 @@ void sc_speller_reinit_enchant_dict(void)
 		sc_speller_dict = enchant_broker_request_dict(sc_speller_broker, lang);
 	else
 		sc_speller_dict = NULL;
+	/* the verdicts are per dictionary */
+	word_cache_clear(TRUE);
+
 	if (sc_speller_dict == NULL)
 	{
 		broker_init_failed();
@@ -601,6 +1085,7 @@ void sc_speller_init(void)
 {
 	log_enchant_version();
 	sc_speller_broker = enchant_broker_init();
+	sc_speller_word_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 
 	sc_speller_reinit_enchant_dict();
 }
@@ -608,10 +1093,12 @@ void sc_speller_init(void)
 
 void sc_speller_free(void)
 {
+	cancel_check();
 	sc_speller_dicts_free();
 	if (sc_speller_dict != NULL)
 		enchant_broker_free_dict(sc_speller_broker, sc_speller_dict);
 	enchant_broker_free(sc_speller_broker);
+	g_hash_table_destroy(sc_speller_word_cache);
 }
 
 
@@ -623,11 +1110,18 @@ gboolean sc_speller_is_text(GeanyDocument *doc, gint pos)
 	g_return_val_if_fail(pos >= 0, FALSE);
 
 	style = sci_get_style_at(doc->editor->sci, pos);
+	lexer = scintilla_send_message(doc->editor->sci, SCI_GETLEXER, 0, 0);
+
+	return is_text_style(lexer, style);
+}
+
+
+static gboolean is_text_style(gint lexer, gint style)
+{
 	/* early out for the default style */
 	if (style == STYLE_DEFAULT)
 		return TRUE;
 
-	lexer = scintilla_send_message(doc->editor->sci, SCI_GETLEXER, 0, 0);
 	switch (lexer)
 	{
 		case SCLEX_ABAQUS:
@@ -1398,3 +1892,66 @@ gboolean sc_speller_is_text(GeanyDocument *doc, gint pos)
 	 * valid text to not ignore more than we want */
 	return TRUE;
 }
+
+
+#ifdef UNITTESTS
+#include <check.h>
+
+static gchar *split_words(const gchar *text)
+{
+	gboolean wordchars[256] = { FALSE };
+	GString *words = g_string_new(NULL);
+	gint text_len = strlen(text);
+	gint line_number = 0;
+	gint pos = 0;
+	gint start;
+	gint i;
+
+	/* Geany's default word chars, prepared like in check_job_new() */
+	for (i = 0; i < 128; i++)
+		wordchars[i] = g_ascii_isalnum(i);
+	wordchars['\''] = TRUE;
+
+	while ((start = find_next_word(wordchars, text, text_len, &pos, &line_number)) >= 0)
+	{
+		if (words->len > 0)
+			g_string_append_c(words, '|');
+		g_string_append_len(words, text + start, pos - start);
+	}
+	g_string_append_printf(words, "|%d", line_number);
+
+	return g_string_free(words, FALSE);
+}
+
+START_TEST(test_find_next_word_ascii)
+{
+	gchar *words = split_words("Don't split_words,\nplease.\r\n");
+
+	ck_assert_str_eq(words, "Don't|split|words|please|2");
+	g_free(words);
+}
+END_TEST
+
+START_TEST(test_find_next_word_accented)
+{
+	gchar *words;
+
+	words = split_words("café naïve Ærøskøbing Straße");
+	ck_assert_str_eq(words, "café|naïve|Ærøskøbing|Straße|0");
+	g_free(words);
+
+	/* decomposed accents and non-letters */
+	words = split_words("cafe\xcc\x81 \xe2\x80\x94 déjà\xe2\x80\x94vu \xff");
+	ck_assert_str_eq(words, "cafe\xcc\x81|déjà|vu|0");
+	g_free(words);
+}
+END_TEST
+
+TCase *speller_test_case_create(void)
+{
+	TCase *tc_speller = tcase_create("speller");
+	tcase_add_test(tc_speller, test_find_next_word_ascii);
+	tcase_add_test(tc_speller, test_find_next_word_accented);
+	return tc_speller;
+}
+#endif
@@ -31,6 +31,8 @@ gint sc_speller_process_line(GeanyDocument *doc, gint line_number);
 
 void sc_speller_check_document(GeanyDocument *doc);
 
+void sc_speller_document_modified(GeanyDocument *doc, gint position, gint length, gboolean inserted);
+
 void sc_speller_reinit_enchant_dict(void);
 
 gchar *sc_speller_get_default_lang(void);
@@ -0,0 +1,30 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <check.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+#include "geany.h"
+
+extern TCase *speller_test_case_create(void);
+
+Suite *
+my_suite(void)
+{
+	Suite *s = suite_create("SpellCheck");
+	TCase *tc_speller = speller_test_case_create();
+	suite_add_tcase(s, tc_speller);
+	return s;
+}
+
+int
+main(void)
+{
+	int nf;
+	Suite *s = my_suite();
+	SRunner *sr = srunner_create(s);
+	srunner_run_all(sr, CK_NORMAL);
+	nf = srunner_ntests_failed(sr);
+	srunner_free(sr);
+	return (nf == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -22,10 +22,6 @@
 
 #include <gio/gio.h>
 
-#ifdef G_OS_WIN32
-# include <windows.h>
-#endif
-
 /* These items are set by Geany before plugin_init() is called. */
 GeanyPlugin 				*geany_plugin;
 GeanyData 					*geany_data;
@@ -42,6 +38,21 @@ static gchar 				*addressbar_last_address 	= NULL;
 static GtkTreeIter 			bookmarks_iter;
 static gboolean 			bookmarks_expanded = FALSE;
 
+static GSList 				*browse_jobs 				= NULL;
+static gchar 				*reveal_uri 				= NULL;
+static gboolean 			reveal_rename 				= FALSE;
+static GHashTable 			*icon_cache 				= NULL;
+
+/* the filter entry text, see filter_compile() */
+static struct
+{
+	gboolean 	active;
+	gboolean 	reverse;
+	GPtrArray 	*suffixes;
+	GHashTable 	*names;
+	GSList 		*specs;
+} file_filter;
+
 static GtkTreeViewColumn 	*treeview_column_text;
 static GtkCellRenderer 		*render_icon, *render_text;
 
@@ -50,6 +61,8 @@ static GtkCellRenderer 		*render_icon, *render_text;
  * ------------------ */
 
 static gboolean 			flag_on_expand_refresh 		= FALSE;
+/* expand all was requested, expand the rows loaded until all listings are done */
+static gboolean 			flag_expand_all_pending 	= FALSE;
 
 /* ------------------
  *  CONFIG VARS
@@ -136,6 +149,21 @@ PLUGIN_SET_TRANSLATABLE_INFO(
 
 #define foreach_slist_free(node, list) for (node = list, list = NULL; g_slist_free_1(list), node != NULL; list = node, node = node->next)
 
+#if ! GLIB_CHECK_VERSION(2, 70, 0)
+# define g_pattern_spec_match_string g_pattern_match_string
+#endif
+
+/* directory entries are read BROWSE_BATCH_SIZE at a time and put into the tree
+ * BROWSE_CHUNK_SIZE at a time from idle, so big directories don't block the UI */
+#define BROWSE_BATCH_SIZE 	256
+#define BROWSE_CHUNK_SIZE 	200
+
+#define BROWSE_ATTRIBUTES 	G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+							G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+							G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+							G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+							G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE
+
 
 /* ------------------
  * PROTOTYPES
@@ -147,6 +175,8 @@ static void 	treebrowser_bookmarks_set_state(void);
 static void 	treebrowser_load_bookmarks(void);
 static void 	treebrowser_tree_store_iter_clear_nodes(gpointer iter, gboolean delete_root);
 static void 	treebrowser_rename_current(void);
+static gboolean treebrowser_search(gchar *uri, gpointer parent);
+static gboolean treebrowser_expand_to_path(gchar* root, gchar* find);
 static void 	on_menu_create_new_object(GtkMenuItem *menuitem, const gchar *type);
 static void 	load_settings(void);
 static gboolean save_settings(void);
@@ -216,18 +246,29 @@ utils_pixbuf_from_stock(const gchar *stock_id)
 }
 #endif
 
+static void
+utils_pixbuf_unref(gpointer pixbuf)
+{
+	if (pixbuf)
+		g_object_unref(pixbuf);
+}
+
 static GdkPixbuf *
-utils_pixbuf_from_path(gchar *path)
+utils_pixbuf_from_content_type(const gchar *ctype)
 {
 	GIcon 		*icon;
 	GdkPixbuf 	*ret = NULL;
 	GtkIconInfo *info;
-	gchar 		*ctype;
+	gpointer 	cached;
 	gint 		width;
 
-	ctype = g_content_type_guess(path, NULL, 0, NULL);
+	/* the icons only depend on the content type, so look each one up just once */
+	if (icon_cache == NULL)
+		icon_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) utils_pixbuf_unref);
+	else if (g_hash_table_lookup_extended(icon_cache, ctype, NULL, &cached))
+		return cached ? g_object_ref(cached) : NULL;
+
 	icon = g_content_type_get_icon(ctype);
-	g_free(ctype);
 
 	if (icon != NULL)
 	{
@@ -243,14 +284,24 @@ utils_pixbuf_from_path(gchar *path)
 				g_object_unref(icon);
 			}
 		}
-		if (!info)
-			return NULL;
-		ret = gtk_icon_info_load_icon (info, NULL);
-		gtk_icon_info_free(info);
+		if (info)
+		{
+			ret = gtk_icon_info_load_icon (info, NULL);
+			gtk_icon_info_free(info);
+		}
 	}
+
+	g_hash_table_insert(icon_cache, g_strdup(ctype), ret ? g_object_ref(ret) : NULL);
 	return ret;
 }
 
+static void
+on_icon_theme_changed(GtkIconTheme *icon_theme, gpointer user_data)
+{
+	if (icon_cache != NULL)
+		g_hash_table_remove_all(icon_cache);
+}
+
 
 /* result must be freed */
 static gchar*
@@ -289,113 +340,113 @@ path_is_in_dir(gchar* src, gchar* find)
 	return diffed_path;
 }
 
-/* Return: FALSE - if file is filtered and not shown, and TRUE - if file isn`t filtered, and have to be shown */
-static gboolean
-check_filtered(const gchar *base_name)
+static void
+filter_clear(void)
 {
-	gchar		**filters;
-	guint 		i;
-	gboolean 	temporary_reverse 	= FALSE;
-	const gchar *exts[] 			= {".o", ".obj", ".so", ".dll", ".a", ".lib", ".la", ".lo", ".pyc"};
-	guint exts_len;
-	const gchar *ext;
-	gboolean	filtered;
+	if (file_filter.suffixes != NULL)
+		g_ptr_array_free(file_filter.suffixes, TRUE);
+	if (file_filter.names != NULL)
+		g_hash_table_destroy(file_filter.names);
+	g_slist_free_full(file_filter.specs, (GDestroyNotify) g_pattern_spec_free);
+	memset(&file_filter, 0, sizeof(file_filter));
+}
 
-	if (CONFIG_HIDE_OBJECT_FILES)
-	{
-		exts_len = G_N_ELEMENTS(exts);
-		for (i = 0; i < exts_len; i++)
-		{
-			ext = exts[i];
-			if (g_str_has_suffix(base_name, ext))
-				return FALSE;
-		}
-	}
+/* Splits the filter entry text once, so check_filtered() only has to match:
+ * "*.ext" filters become suffix checks, filters without wildcards exact name
+ * lookups, and only the remaining ones get a GPatternSpec */
+static void
+filter_compile(const gchar *text)
+{
+	gchar 	**filters;
+	guint 	i;
 
-	if (EMPTY(gtk_entry_get_text(GTK_ENTRY(filter))))
-		return TRUE;
+	filter_clear();
 
-	filters = g_strsplit(gtk_entry_get_text(GTK_ENTRY(filter)), ";", 0);
+	if (EMPTY(text))
+		return;
+
+	file_filter.active 		= TRUE;
+	file_filter.suffixes 	= g_ptr_array_new_with_free_func(g_free);
+	file_filter.names 		= g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	filters = g_strsplit(text, ";", 0);
 
 	if (utils_str_equal(filters[0], "!") == TRUE)
 	{
-		temporary_reverse = TRUE;
+		file_filter.reverse = TRUE;
 		i = 1;
 	}
 	else
 		i = 0;
 
-	filtered = CONFIG_REVERSE_FILTER || temporary_reverse ? TRUE : FALSE;
+	/* a file literally called "*" matches any filter */
+	if (filters[i])
+		g_hash_table_add(file_filter.names, g_strdup("*"));
+
 	for (; filters[i]; i++)
 	{
-		if (utils_str_equal(base_name, "*") || g_pattern_match_simple(filters[i], base_name))
-		{
-			filtered = CONFIG_REVERSE_FILTER || temporary_reverse ? FALSE : TRUE;
-			break;
-		}
+		const gchar *pattern = filters[i];
+
+		if (pattern[0] == '*' && strpbrk(pattern + 1, "*?") == NULL)
+			g_ptr_array_add(file_filter.suffixes, g_strdup(pattern + 1));
+		else if (strpbrk(pattern, "*?") == NULL)
+			g_hash_table_add(file_filter.names, g_strdup(pattern));
+		else
+			file_filter.specs = g_slist_prepend(file_filter.specs, g_pattern_spec_new(pattern));
 	}
 	g_strfreev(filters);
-
-	return filtered;
 }
 
-#ifdef G_OS_WIN32
+/* Return: FALSE - if file is filtered and not shown, and TRUE - if file isn`t filtered, and have to be shown */
 static gboolean
-win32_check_hidden(const gchar *filename)
+check_filtered(const gchar *base_name)
 {
-	DWORD attrs;
-	static wchar_t w_filename[MAX_PATH];
-	MultiByteToWideChar(CP_UTF8, 0, filename, -1, w_filename, sizeof(w_filename));
-	attrs = GetFileAttributesW(w_filename);
-	if (attrs != INVALID_FILE_ATTRIBUTES && attrs & FILE_ATTRIBUTE_HIDDEN)
+	static const gchar *exts[] 	= {".o", ".obj", ".so", ".dll", ".a", ".lib", ".la", ".lo", ".pyc"};
+	const gchar *ext;
+	gboolean 	matched 		= FALSE;
+	gboolean 	reverse;
+	guint 		i;
+	GSList 		*node;
+
+	if (CONFIG_HIDE_OBJECT_FILES)
+	{
+		/* all of them are single extensions, so comparing the last one is enough */
+		ext = strrchr(base_name, '.');
+		if (ext != NULL)
+		{
+			for (i = 0; i < G_N_ELEMENTS(exts); i++)
+			{
+				if (utils_str_equal(ext, exts[i]))
+					return FALSE;
+			}
+		}
+	}
+
+	if (! file_filter.active)
 		return TRUE;
-	return FALSE;
+
+	if (g_hash_table_contains(file_filter.names, base_name))
+		matched = TRUE;
+
+	for (i = 0; !matched && i < file_filter.suffixes->len; i++)
+		matched = g_str_has_suffix(base_name, g_ptr_array_index(file_filter.suffixes, i));
+
+	for (node = file_filter.specs; !matched && node != NULL; node = node->next)
+		matched = g_pattern_spec_match_string(node->data, base_name);
+
+	reverse = CONFIG_REVERSE_FILTER || file_filter.reverse;
+	return reverse ? !matched : matched;
 }
-#endif
 
-/* Returns: whether name should be hidden. */
+/* Returns: whether the file should be hidden. */
 static gboolean
-check_hidden(const gchar *filename)
+check_hidden(GFileInfo *info)
 {
-	gsize len;
-	const gchar *base_name = NULL;
-	base_name = g_path_get_basename(filename);
-
-	if (EMPTY(base_name))
-	{
-		g_free(base_name);
-		return FALSE;
-	}
-
 	if (CONFIG_SHOW_HIDDEN_FILES)
-	{
-		g_free(base_name);
 		return FALSE;
-	}
-
-#ifdef G_OS_WIN32
-	if (win32_check_hidden(filename))
-	{
-		g_free(base_name);
-		return TRUE;
-	}
-#else
-	if (base_name[0] == '.')
-	{
-		g_free(base_name);
-		return TRUE;
-	}
-#endif
 
-	len = strlen(base_name);
-	if (base_name[len - 1] == '~')
-	{
-		g_free(base_name);
-		return TRUE;
-	}
-
-	g_free(base_name);
-	return FALSE;
+	/* dot files (hidden attribute on Windows) and backups ending with '~' */
+	return g_file_info_get_is_hidden(info) || g_file_info_get_is_backup(info);
 }
 
 static gchar*
@@ -500,131 +551,402 @@ treebrowser_chroot(const gchar *dir)
 	treebrowser_load_bookmarks();
 }
 
+typedef struct
+{
+	GCancellable 		*cancellable;
+	gchar 				*directory;		/* with a trailing separator */
+	GtkTreeRowReference *parent;		/* NULL when listing the root */
+	GPtrArray 			*infos;			/* GFileInfo of the entries to show */
+	guint 				pos;			/* next entry to put into the tree */
+	guint 				idle_id;
+} BrowseJob;
+
 static void
-treebrowser_browse(gchar *directory, gpointer parent)
+browse_job_free(BrowseJob *job)
 {
-	GtkTreeIter 	iter, iter_empty, *last_dir_iter = NULL;
-	gboolean 		is_dir;
-	gboolean 		expanded = FALSE, has_parent;
-	gchar 			*utf8_name;
-	GSList 			*list, *node;
+	browse_jobs = g_slist_remove(browse_jobs, job);
+	if (job->idle_id)
+		g_source_remove(job->idle_id);
+	if (job->parent)
+		gtk_tree_row_reference_free(job->parent);
+	g_ptr_array_foreach(job->infos, (GFunc) g_object_unref, NULL);
+	g_ptr_array_free(job->infos, TRUE);
+	g_object_unref(job->cancellable);
+	g_free(job->directory);
+	g_free(job);
+}
 
-	gchar 			*fname;
-	gchar 			*uri;
+/* jobs waiting for GIO are freed by their callback, the others right away */
+static void
+browse_job_cancel(BrowseJob *job)
+{
+	g_cancellable_cancel(job->cancellable);
+	if (job->idle_id)
+		browse_job_free(job);
+	else if (job->parent)
+	{
+		gtk_tree_row_reference_free(job->parent);
+		job->parent = NULL;
+	}
+}
+
+static void
+browse_cancel_jobs(GtkTreePath *parent)
+{
+	GSList *node, *jobs = g_slist_copy(browse_jobs);
 
-	directory 		= g_strconcat(directory, G_DIR_SEPARATOR_S, NULL);
+	for (node = jobs; node != NULL; node = node->next)
+	{
+		BrowseJob 	*job = node->data;
+		GtkTreePath *path;
 
-	has_parent = parent ? gtk_tree_store_iter_is_valid(treestore, parent) : FALSE;
-	if (has_parent)
+		if (g_cancellable_is_cancelled(job->cancellable))
+			continue;
+		if (parent == NULL)
+		{
+			browse_job_cancel(job);
+			continue;
+		}
+		path = job->parent ? gtk_tree_row_reference_get_path(job->parent) : NULL;
+		if (path && gtk_tree_path_compare(path, parent) == 0)
+			browse_job_cancel(job);
+		gtk_tree_path_free(path);
+	}
+	g_slist_free(jobs);
+}
+
+/* Selects reveal_uri once the listings it depends on are loaded, expanding
+ * one more directory level towards it each time all of them are done */
+static void
+treebrowser_reveal_pending(void)
+{
+	if (reveal_uri == NULL)
+		return;
+
+	if (treebrowser_search(reveal_uri, NULL))
 	{
-		if (parent == &bookmarks_iter)
-			treebrowser_load_bookmarks();
+		if (reveal_rename)
+			treebrowser_rename_current();
 	}
+	else if (browse_jobs != NULL)
+		return;
 	else
-		parent = NULL;
-
-	if (has_parent && tree_view_row_expanded_iter(GTK_TREE_VIEW(treeview), parent))
 	{
-		expanded = TRUE;
-		treebrowser_bookmarks_set_state();
+		treebrowser_expand_to_path(addressbar_last_address, reveal_uri);
+		if (browse_jobs != NULL)
+			return;
 	}
+	SETPTR(reveal_uri, NULL);
+}
 
-	if (parent)
-		treebrowser_tree_store_iter_clear_nodes(parent, FALSE);
-	else
-		gtk_tree_store_clear(treestore);
+static void
+treebrowser_reveal(const gchar *uri, gboolean rename)
+{
+	SETPTR(reveal_uri, g_strdup(uri));
+	reveal_rename = rename;
+	treebrowser_reveal_pending();
+}
+
+static gint
+browse_compare_infos(gconstpointer a, gconstpointer b)
+{
+	GFileInfo *info_a = *(GFileInfo **) a;
+	GFileInfo *info_b = *(GFileInfo **) b;
+	gboolean is_dir_a = g_file_info_get_file_type(info_a) == G_FILE_TYPE_DIRECTORY;
+	gboolean is_dir_b = g_file_info_get_file_type(info_b) == G_FILE_TYPE_DIRECTORY;
+
+	/* directories first, like they have always been shown */
+	if (is_dir_a != is_dir_b)
+		return is_dir_a ? -1 : 1;
+	return utils_str_casecmp(g_file_info_get_name(info_a), g_file_info_get_name(info_b));
+}
 
-	list = utils_get_file_list(directory, NULL, NULL);
-	if (list != NULL)
+static gboolean
+browse_insert_idle(gpointer data)
+{
+	BrowseJob 		*job = data;
+	GtkTreeIter 	iter, iter_empty, parent_iter, *parent = NULL;
+	gboolean 		expanded = FALSE;
+	GdkPixbuf 		*dir_icon = NULL, *file_icon = NULL;
+	guint 			end;
+
+	if (job->parent)
 	{
-		foreach_slist_free(node, list)
+		GtkTreePath *path = gtk_tree_row_reference_get_path(job->parent);
+
+		/* the row went away while we were reading the directory */
+		if (path == NULL)
 		{
-			fname 		= node->data;
-			uri 		= g_strconcat(directory, fname, NULL);
-			is_dir 		= g_file_test (uri, G_FILE_TEST_IS_DIR);
-			utf8_name 	= utils_get_utf8_from_locale(fname);
+			job->idle_id = 0;
+			browse_job_free(job);
+			return FALSE;
+		}
+		gtk_tree_model_get_iter(GTK_TREE_MODEL(treestore), &parent_iter, path);
+		gtk_tree_path_free(path);
+		parent = &parent_iter;
+	}
 
-			if (!check_hidden(uri))
+	if (job->pos == 0)
+	{
+		/* replace the old children only now, so the row doesn't stay empty while loading */
+		if (parent)
+		{
+			if (tree_view_row_expanded_iter(GTK_TREE_VIEW(treeview), parent))
 			{
-				GdkPixbuf *icon = NULL;
+				expanded = TRUE;
+				treebrowser_bookmarks_set_state();
+			}
+			treebrowser_tree_store_iter_clear_nodes(parent, FALSE);
+		}
 
-				if (is_dir)
-				{
-					if (last_dir_iter == NULL)
-						gtk_tree_store_prepend(treestore, &iter, parent);
-					else
-					{
-						gtk_tree_store_insert_after(treestore, &iter, parent, last_dir_iter);
-						gtk_tree_iter_free(last_dir_iter);
-					}
-					last_dir_iter = gtk_tree_iter_copy(&iter);
+		if (job->infos->len == 0)
+		{
+			gtk_tree_store_prepend(treestore, &iter_empty, parent);
+			gtk_tree_store_set(treestore, &iter_empty,
+							TREEBROWSER_COLUMN_ICON, 	NULL,
+							TREEBROWSER_COLUMN_NAME, 	_("(Empty)"),
+							TREEBROWSER_COLUMN_URI, 	NULL,
+							-1);
+		}
+	}
+
+	if (CONFIG_SHOW_ICONS)
+	{
 #if GTK_CHECK_VERSION(3, 10, 0)
-					icon = CONFIG_SHOW_ICONS ? utils_pixbuf_from_name("folder") : NULL;
+		dir_icon = utils_pixbuf_from_name("folder");
+		if (CONFIG_SHOW_ICONS != 2)
+			file_icon = utils_pixbuf_from_name("text-x-generic");
 #else
-					icon = CONFIG_SHOW_ICONS ? utils_pixbuf_from_stock(GTK_STOCK_DIRECTORY) : NULL;
+		dir_icon = utils_pixbuf_from_stock(GTK_STOCK_DIRECTORY);
+		if (CONFIG_SHOW_ICONS != 2)
+			file_icon = utils_pixbuf_from_stock(GTK_STOCK_FILE);
 #endif
-					gtk_tree_store_set(treestore, &iter,
-										TREEBROWSER_COLUMN_ICON, 	icon,
-										TREEBROWSER_COLUMN_NAME, 	fname,
-										TREEBROWSER_COLUMN_URI, 	uri,
-										-1);
-					gtk_tree_store_prepend(treestore, &iter_empty, &iter);
-					gtk_tree_store_set(treestore, &iter_empty,
-									TREEBROWSER_COLUMN_ICON, 	NULL,
-									TREEBROWSER_COLUMN_NAME, 	_("(Empty)"),
-									TREEBROWSER_COLUMN_URI, 	NULL,
-									-1);
-				}
+	}
+
+	end = MIN(job->pos + BROWSE_CHUNK_SIZE, job->infos->len);
+	for (; job->pos < end; job->pos++)
+	{
+		GFileInfo 	*info 	= g_ptr_array_index(job->infos, job->pos);
+		const gchar *fname 	= g_file_info_get_name(info);
+		gchar 		*uri 	= g_strconcat(job->directory, fname, NULL);
+
+		gtk_tree_store_append(treestore, &iter, parent);
+		if (g_file_info_get_file_type(info) == G_FILE_TYPE_DIRECTORY)
+		{
+			gtk_tree_store_set(treestore, &iter,
+								TREEBROWSER_COLUMN_ICON, 	dir_icon,
+								TREEBROWSER_COLUMN_NAME, 	fname,
+								TREEBROWSER_COLUMN_URI, 	uri,
+								-1);
+			gtk_tree_store_prepend(treestore, &iter_empty, &iter);
+			gtk_tree_store_set(treestore, &iter_empty,
+							TREEBROWSER_COLUMN_ICON, 	NULL,
+							TREEBROWSER_COLUMN_NAME, 	_("(Empty)"),
+							TREEBROWSER_COLUMN_URI, 	NULL,
+							-1);
+		}
+		else
+		{
+			GdkPixbuf *icon = file_icon ? g_object_ref(file_icon) : NULL;
+
+			if (CONFIG_SHOW_ICONS == 2)
+			{
+				const gchar *ctype = g_file_info_get_attribute_string(info,
+											G_FILE_ATTRIBUTE_STANDARD_FAST_CONTENT_TYPE);
+
+				if (ctype)
+					icon = utils_pixbuf_from_content_type(ctype);
 				else
 				{
-					if (check_filtered(utf8_name))
-					{
-						icon = CONFIG_SHOW_ICONS == 2
-									? utils_pixbuf_from_path(uri)
-									: CONFIG_SHOW_ICONS
-#if GTK_CHECK_VERSION(3, 10, 0)
-										? utils_pixbuf_from_name("text-x-generic")
-#else
-										? utils_pixbuf_from_stock(GTK_STOCK_FILE)
-#endif
-										: NULL;
-						gtk_tree_store_append(treestore, &iter, parent);
-						gtk_tree_store_set(treestore, &iter,
-										TREEBROWSER_COLUMN_ICON, 	icon,
-										TREEBROWSER_COLUMN_NAME, 	fname,
-										TREEBROWSER_COLUMN_URI, 	uri,
-										-1);
-					}
+					gchar *guessed = g_content_type_guess(fname, NULL, 0, NULL);
+
+					icon = utils_pixbuf_from_content_type(guessed);
+					g_free(guessed);
 				}
+			}
+			gtk_tree_store_set(treestore, &iter,
+							TREEBROWSER_COLUMN_ICON, 	icon,
+							TREEBROWSER_COLUMN_NAME, 	fname,
+							TREEBROWSER_COLUMN_URI, 	uri,
+							-1);
+			if (icon)
+				g_object_unref(icon);
+		}
+		g_free(uri);
+	}
+
+	if (dir_icon)
+		g_object_unref(dir_icon);
+	if (file_icon)
+		g_object_unref(file_icon);
+
+	if (expanded)
+	{
+		GtkTreePath *path = gtk_tree_model_get_path(GTK_TREE_MODEL(treestore), parent);
+
+		/* we are refreshing the row, don't let on_treeview_row_expanded() browse it again */
+		flag_on_expand_refresh = TRUE;
+		gtk_tree_view_expand_row(GTK_TREE_VIEW(treeview), path, FALSE);
+		flag_on_expand_refresh = FALSE;
+		gtk_tree_path_free(path);
+	}
 
-				if (icon)
-					g_object_unref(icon);
+	if (job->pos < job->infos->len)
+		return TRUE;
+
+	/* the directories just listed weren't there to be expanded yet, their
+	 * listings are started from on_treeview_row_expanded() */
+	if (flag_expand_all_pending)
+	{
+		if (parent == NULL)
+			gtk_tree_view_expand_all(GTK_TREE_VIEW(treeview));
+		else if (tree_view_row_expanded_iter(GTK_TREE_VIEW(treeview), parent))
+		{
+			GtkTreePath *path = gtk_tree_model_get_path(GTK_TREE_MODEL(treestore), parent);
+
+			gtk_tree_view_expand_row(GTK_TREE_VIEW(treeview), path, TRUE);
+			gtk_tree_path_free(path);
+		}
+	}
+
+	if (parent == NULL)
+		treebrowser_load_bookmarks();
+
+	job->idle_id = 0;
+	browse_job_free(job);
+	if (browse_jobs == NULL)
+		flag_expand_all_pending = FALSE;
+	treebrowser_reveal_pending();
+	return FALSE;
+}
+
+static void
+browse_job_done(BrowseJob *job)
+{
+	g_ptr_array_sort(job->infos, browse_compare_infos);
+	job->idle_id = g_idle_add(browse_insert_idle, job);
+}
+
+static void
+on_browse_next_files(GObject *object, GAsyncResult *result, gpointer data)
+{
+	GFileEnumerator *enumerator = G_FILE_ENUMERATOR(object);
+	BrowseJob 		*job = data;
+	GList 			*infos, *node;
+	GError 			*error = NULL;
+
+	infos = g_file_enumerator_next_files_finish(enumerator, result, &error);
+	if (g_cancellable_is_cancelled(job->cancellable))
+	{
+		g_list_free_full(infos, g_object_unref);
+		g_clear_error(&error);
+		g_object_unref(enumerator);
+		browse_job_free(job);
+		return;
+	}
+
+	for (node = infos; node != NULL; node = node->next)
+	{
+		GFileInfo *info = node->data;
+		gboolean shown = FALSE;
+
+		if (!check_hidden(info))
+		{
+			if (g_file_info_get_file_type(info) == G_FILE_TYPE_DIRECTORY)
+				shown = TRUE;
+			else
+			{
+				gchar *utf8_name = utils_get_utf8_from_locale(g_file_info_get_name(info));
+
+				shown = check_filtered(utf8_name);
+				g_free(utf8_name);
 			}
-			g_free(utf8_name);
-			g_free(uri);
-			g_free(fname);
 		}
+
+		if (shown)
+			g_ptr_array_add(job->infos, info);
+		else
+			g_object_unref(info);
 	}
-	else
+
+	if (infos != NULL)
 	{
-		gtk_tree_store_prepend(treestore, &iter_empty, parent);
-		gtk_tree_store_set(treestore, &iter_empty,
-						TREEBROWSER_COLUMN_ICON, 	NULL,
-						TREEBROWSER_COLUMN_NAME, 	_("(Empty)"),
-						TREEBROWSER_COLUMN_URI, 	NULL,
-						-1);
+		g_list_free(infos);
+		g_file_enumerator_next_files_async(enumerator, BROWSE_BATCH_SIZE, G_PRIORITY_DEFAULT,
+			job->cancellable, on_browse_next_files, job);
+		return;
 	}
 
+	g_clear_error(&error);
+	g_file_enumerator_close_async(enumerator, G_PRIORITY_DEFAULT, NULL, NULL, NULL);
+	g_object_unref(enumerator);
+	browse_job_done(job);
+}
+
+static void
+on_browse_enumerate(GObject *object, GAsyncResult *result, gpointer data)
+{
+	GFileEnumerator *enumerator;
+	BrowseJob 		*job = data;
+
+	enumerator = g_file_enumerate_children_finish(G_FILE(object), result, NULL);
+	if (g_cancellable_is_cancelled(job->cancellable))
+	{
+		if (enumerator)
+			g_object_unref(enumerator);
+		browse_job_free(job);
+	}
+	else if (enumerator == NULL)
+		/* unreadable, show it as empty */
+		browse_job_done(job);
+	else
+		g_file_enumerator_next_files_async(enumerator, BROWSE_BATCH_SIZE, G_PRIORITY_DEFAULT,
+			job->cancellable, on_browse_next_files, job);
+}
+
+static void
+treebrowser_browse(gchar *directory, gpointer parent)
+{
+	BrowseJob 		*job;
+	GFile 			*file;
+	gboolean 		has_parent;
+
+	has_parent = parent ? gtk_tree_store_iter_is_valid(treestore, parent) : FALSE;
 	if (has_parent)
 	{
-		if (expanded)
-			gtk_tree_view_expand_row(GTK_TREE_VIEW(treeview), gtk_tree_model_get_path(GTK_TREE_MODEL(treestore), parent), FALSE);
+		if (parent == &bookmarks_iter)
+			treebrowser_load_bookmarks();
+	}
+	else
+		parent = NULL;
+
+	job 				= g_new0(BrowseJob, 1);
+	job->cancellable 	= g_cancellable_new();
+	job->directory 		= g_strconcat(directory, G_DIR_SEPARATOR_S, NULL);
+	job->infos 			= g_ptr_array_new();
+
+	if (parent)
+	{
+		GtkTreePath *path = gtk_tree_model_get_path(GTK_TREE_MODEL(treestore), parent);
+
+		/* a newer listing of the same directory replaces the running one */
+		browse_cancel_jobs(path);
+		job->parent = gtk_tree_row_reference_new(GTK_TREE_MODEL(treestore), path);
+		gtk_tree_path_free(path);
 	}
 	else
-		treebrowser_load_bookmarks();
+	{
+		browse_cancel_jobs(NULL);
+		gtk_tree_store_clear(treestore);
+		flag_expand_all_pending = FALSE;
+	}
 
-	g_free(directory);
+	browse_jobs = g_slist_prepend(browse_jobs, job);
 
+	file = g_file_new_for_path(job->directory);
+	g_file_enumerate_children_async(file, BROWSE_ATTRIBUTES, G_FILE_QUERY_INFO_NONE,
+		G_PRIORITY_DEFAULT, job->cancellable, on_browse_enumerate, job);
+	g_object_unref(file);
 }
 
 static void
@@ -915,7 +1237,7 @@ treebrowser_track_current(void)
 			if (utils_str_equal(froot, addressbar_last_address) != TRUE)
 				treebrowser_chroot(froot);
 
-			treebrowser_expand_to_path(froot, path_current);
+			treebrowser_reveal(path_current, FALSE);
 		}
 
 		g_strfreev(path_segments);
@@ -1113,8 +1435,7 @@ on_menu_create_new_object(GtkMenuItem *menuitem, const gchar *type)
 			if (creation_success)
 			{
 				treebrowser_browse(uri, refresh_root ? NULL : &iter);
-				if (treebrowser_search(uri_new, NULL))
-					treebrowser_rename_current();
+				treebrowser_reveal(uri_new, TRUE);
 				if (utils_str_equal(type, "file") && CONFIG_OPEN_NEW_FILES == TRUE)
 					document_open_file(uri_new,FALSE, NULL,NULL);
 			}
@@ -1203,12 +1524,18 @@ on_menu_refresh(GtkMenuItem *menuitem, gpointer *user_data)
 static void
 on_menu_expand_all(GtkMenuItem *menuitem, gpointer *user_data)
 {
+	/* directories are listed asynchronously, so this only expands the rows loaded
+	 * already, the others are expanded once their listing is done */
+	flag_expand_all_pending = TRUE;
 	gtk_tree_view_expand_all(GTK_TREE_VIEW(treeview));
+	if (browse_jobs == NULL)
+		flag_expand_all_pending = FALSE;
 }
 
 static void
 on_menu_collapse_all(GtkMenuItem *menuitem, gpointer *user_data)
 {
+	flag_expand_all_pending = FALSE;
 	gtk_tree_view_collapse_all(GTK_TREE_VIEW(treeview));
 }
 
@@ -1499,6 +1826,7 @@ on_addressbar_activate(GtkEntry *entry, gpointer user_data)
 static void
 on_filter_activate(GtkEntry *entry, gpointer user_data)
 {
+	filter_compile(gtk_entry_get_text(entry));
 	treebrowser_chroot(addressbar_last_address);
 }
 
@@ -1506,6 +1834,7 @@ static void
 on_filter_clear(GtkEntry *entry, gint icon_pos, GdkEvent *event, gpointer data)
 {
 	gtk_entry_set_text(entry, "");
+	filter_compile(NULL);
 	treebrowser_chroot(addressbar_last_address);
 }
 
@@ -2389,12 +2718,25 @@ plugin_init(GeanyData *data)
 
 	plugin_signal_connect(geany_plugin, NULL, "document-activate", TRUE,
 		(GCallback)&treebrowser_track_current_cb, NULL);
+	plugin_signal_connect(geany_plugin, G_OBJECT(gtk_icon_theme_get_default()), "changed", FALSE,
+		(GCallback)&on_icon_theme_changed, NULL);
+
+	/* directory listings may still call back after unloading */
+	plugin_module_make_resident(geany_plugin);
 }
 
 void
 plugin_cleanup(void)
 {
-	g_free(addressbar_last_address);
+	browse_cancel_jobs(NULL);
+	if (icon_cache != NULL)
+	{
+		g_hash_table_destroy(icon_cache);
+		icon_cache = NULL;
+	}
+	SETPTR(reveal_uri, NULL);
+	filter_clear();
+	SETPTR(addressbar_last_address, NULL);
 	g_free(CONFIG_FILE);
 	g_free(CONFIG_OPEN_EXTERNAL_CMD);
 	g_free(CONFIG_OPEN_TERMINAL);